@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Ray.h"
+#include "Vec.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace aurora {
+
+	inline float GetAxisValue(const numa::Vec3& v, int axis) {
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	struct Aabb {
+		numa::Vec3 min{std::numeric_limits<float>::infinity()};
+		numa::Vec3 max{-std::numeric_limits<float>::infinity()};
+
+		void Grow(const numa::Vec3& p) {
+			min = numa::Vec3{std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z)};
+			max = numa::Vec3{std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z)};
+		}
+		// Growing by an empty box is a no-op, its min/max are +/- infinity.
+		void Grow(const Aabb& aabb) {
+			min = numa::Vec3{std::min(min.x, aabb.min.x), std::min(min.y, aabb.min.y), std::min(min.z, aabb.min.z)};
+			max = numa::Vec3{std::max(max.x, aabb.max.x), std::max(max.y, aabb.max.y), std::max(max.z, aabb.max.z)};
+		}
+		// Inflates the box by 'padding' along every axis.
+		// Useful for flat primitives (finite planes) that would otherwise produce a box with zero thickness.
+		void Pad(float padding) {
+			min = min - numa::Vec3{padding};
+			max = max + numa::Vec3{padding};
+		}
+
+		bool Valid() const {
+			return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+		}
+
+		numa::Vec3 Centroid() const {
+			return 0.5f * (min + max);
+		}
+		numa::Vec3 Extent() const {
+			return max - min;
+		}
+		float SurfaceArea() const {
+			if (!Valid())
+				return 0.0f;
+			numa::Vec3 e = Extent();
+			return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+		}
+		int LongestAxis() const {
+			numa::Vec3 e = Extent();
+			if (e.x >= e.y && e.x >= e.z)
+				return 0;
+			return e.y >= e.z ? 1 : 2;
+		}
+	};
+
+	// Ray data precomputed once per traversal, so that the slab test doesn't have to divide.
+	struct AabbRay {
+		AabbRay(const numa::Ray& ray)
+			: origin(ray.GetOrigin()),
+			invDirection(
+				1.0f / ray.GetDirection().x,
+				1.0f / ray.GetDirection().y,
+				1.0f / ray.GetDirection().z) {
+		}
+
+		numa::Vec3 origin{0.0f};
+		numa::Vec3 invDirection{0.0f};
+	};
+
+	// Slab test. Returns the entry distance or 'infinity' if the box is missed within [tMin, tMax].
+	inline float IntersectAabb(const Aabb& aabb, const AabbRay& ray, float tMin, float tMax) {
+		float tx1 = (aabb.min.x - ray.origin.x) * ray.invDirection.x;
+		float tx2 = (aabb.max.x - ray.origin.x) * ray.invDirection.x;
+		float tNear = std::min(tx1, tx2);
+		float tFar = std::max(tx1, tx2);
+		float ty1 = (aabb.min.y - ray.origin.y) * ray.invDirection.y;
+		float ty2 = (aabb.max.y - ray.origin.y) * ray.invDirection.y;
+		tNear = std::max(tNear, std::min(ty1, ty2));
+		tFar = std::min(tFar, std::max(ty1, ty2));
+		float tz1 = (aabb.min.z - ray.origin.z) * ray.invDirection.z;
+		float tz2 = (aabb.max.z - ray.origin.z) * ray.invDirection.z;
+		tNear = std::max(tNear, std::min(tz1, tz2));
+		tFar = std::min(tFar, std::max(tz1, tz2));
+		tNear = std::max(tNear, tMin);
+		tFar = std::min(tFar, tMax);
+		if (tNear > tFar)
+			return std::numeric_limits<float>::infinity();
+		return tNear;
+	}
+
+}
\ No newline at end of file
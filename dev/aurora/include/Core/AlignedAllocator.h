@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace aurora {
+
+	static constexpr size_t cacheLineSize{64};
+
+	// Standard allocator returning memory aligned to 'Alignment' bytes.
+	// Used for the flat arrays the renderer streams through, so that they start on a cache line
+	// (and on a SIMD register boundary).
+	template <typename T, size_t Alignment = cacheLineSize>
+	class AlignedAllocator {
+	public:
+		static_assert(Alignment >= alignof(T), "The alignment can't be weaker than the type's own alignment!");
+
+		using value_type = T;
+
+		template <typename U>
+		struct rebind {
+			using other = AlignedAllocator<U, Alignment>;
+		};
+
+		AlignedAllocator() = default;
+		template <typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>& other) {
+		}
+
+		T* allocate(size_t count) {
+			return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{Alignment}));
+		}
+		void deallocate(T* ptr, size_t count) {
+			::operator delete(ptr, std::align_val_t{Alignment});
+		}
+
+		template <typename U>
+		bool operator==(const AlignedAllocator<U, Alignment>& other) const {
+			return true;
+		}
+		template <typename U>
+		bool operator!=(const AlignedAllocator<U, Alignment>& other) const {
+			return false;
+		}
+	};
+
+	template <typename T>
+	using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+}
\ No newline at end of file
@@ -7,6 +7,8 @@
 
 #include <filesystem>
 #include <memory>
+#include <string_view>
+#include <vector>
 
 namespace aurora {
 
@@ -30,19 +32,18 @@ namespace aurora {
 		void Run();
 
 	private:
-		void CreateImageWriter();
+		std::shared_ptr<PpmImageWriter> CreateImageWriter(std::string_view fileName) const;
 		void CreateTaskManager();
 
 		void CreateDemoScene();
 		void CreateQuadLightDemoScene();
 
-		void RenderActiveScene(std::shared_ptr<Scene> scene);
+		void RenderScenes(const std::vector<std::shared_ptr<Scene>>& scenes);
 		void CreateSceneRenderingJob(std::shared_ptr<Scene> scene);
 
 		std::filesystem::path exePath{};
 
 		std::unique_ptr<PathTracer> pathTracer;
-		std::unique_ptr<PpmImageWriter> imageWriter;
 		std::unique_ptr<SceneManager> sceneManager;
 		std::unique_ptr<TaskManager> taskManager;
 	};
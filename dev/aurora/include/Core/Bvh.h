@@ -0,0 +1,265 @@
+#pragma once
+
+#include "Core/Aabb.h"
+#include "Core/RayPacket.h"
+
+#include "Ray.h"
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace aurora {
+
+	struct BvhNode {
+		bool IsLeaf() const {
+			return primCount > 0;
+		}
+
+		Aabb bounds{};
+		// Interior nodes: index of the left child (the right child is always 'leftFirst + 1').
+		// Leaf nodes: index of the first primitive reference in 'Bvh::primIndices'.
+		uint32_t leftFirst{0};
+		uint32_t primCount{0};
+	};
+
+	// Quality/speed knob. All the builders produce the same node layout.
+	enum class BvhBuildQuality {
+		// Linear BVH. Primitives are sorted along a Morton curve and nodes are split at the highest differing bit.
+		FAST,
+		// Binned SAH. Close to the full sweep in traversal speed for a fraction of the build time.
+		MEDIUM,
+		// Full SAH sweep over every primitive boundary.
+		HIGH
+	};
+
+	struct BvhBuildSettings {
+		BvhBuildQuality quality{BvhBuildQuality::MEDIUM};
+		uint32_t maxLeafSize{4};
+		// Number of bins per axis used by the binned SAH (at most 32).
+		uint32_t binCount{16};
+		// Subtrees smaller than this are finished by the thread that split them off,
+		// bigger ones are handed back to the task manager's workers.
+		uint32_t parallelThreshold{4096};
+		// SAH cost constants. Only the ratio between the two matters.
+		float traversalCost{1.0f};
+		float intersectionCost{1.0f};
+	};
+
+	class TaskManager;
+
+	// Binary bounding volume hierarchy built with the surface area heuristic (SAH).
+	// The hierarchy doesn't know anything about the primitives it's built over.
+	// It only sees their bounds and hands primitive indices back to the caller during traversal.
+	class Bvh {
+	public:
+		// The builders never put a leaf deeper than 'maxDepth' (the root is at depth 0). A traversal pushes
+		// at most one entry per level, plus one for the sibling of the deepest node, so the stack never overflows.
+		static constexpr uint32_t traversalStackSize{64};
+		static constexpr uint32_t maxDepth{traversalStackSize - 1};
+
+		// The build runs on the task manager's workers when one is given and the primitive count is big enough.
+		void Build(const std::vector<Aabb>& primBounds, const BvhBuildSettings& settings = BvhBuildSettings{}, TaskManager* taskManager = nullptr);
+		// Recomputes the node bounds for primitives that have moved, keeping the tree topology.
+		// Much cheaper than 'Build', but the tree quality degrades the further primitives move.
+		// 'primBounds' must have the same size and order as the one the tree was built with.
+		void Refit(const std::vector<Aabb>& primBounds);
+		void Clear();
+
+		// 'intersectPrimitive' has the signature 'bool(uint32_t primIdx, float& tMax)'.
+		// It must return 'true' and shrink 'tMax' when it finds a closer hit.
+		template <typename IntersectPrimitive>
+		bool IntersectClosest(const numa::Ray& ray, float tMin, float& tMax, IntersectPrimitive&& intersectPrimitive) const {
+			return IntersectClosestLeaves(ray, tMin, tMax, [this, &intersectPrimitive](uint32_t first, uint32_t count, float& leafTMax) {
+				bool anyHit{false};
+				for (uint32_t i = 0; i < count; i++) {
+					if (intersectPrimitive(primIndices[first + i], leafTMax))
+						anyHit = true;
+				}
+				return anyHit;
+				});
+		}
+		// Same as 'IntersectClosest', but whole leaves are handed to the caller, e.g. to test them with SIMD.
+		// 'intersectLeaf' has the signature 'bool(uint32_t first, uint32_t count, float& tMax)',
+		// where [first, first + count) is a range of primitive references (see 'GetPrimIndices').
+		template <typename IntersectLeaf>
+		bool IntersectClosestLeaves(const numa::Ray& ray, float tMin, float& tMax, IntersectLeaf&& intersectLeaf) const {
+			if (nodes.empty())
+				return false;
+
+			AabbRay aabbRay{ray};
+			if (IntersectAabb(nodes[0].bounds, aabbRay, tMin, tMax) == std::numeric_limits<float>::infinity())
+				return false;
+
+			bool anyHit{false};
+			uint32_t stack[traversalStackSize];
+			uint32_t stackSize{0};
+			uint32_t nodeIdx{0};
+			while (true) {
+				const BvhNode& node = nodes[nodeIdx];
+				if (node.IsLeaf()) {
+					if (intersectLeaf(node.leftFirst, node.primCount, tMax))
+						anyHit = true;
+				} else {
+					// Visit the closer child first, the other one is postponed.
+					uint32_t nearIdx = node.leftFirst;
+					uint32_t farIdx = node.leftFirst + 1;
+					float tNear = IntersectAabb(nodes[nearIdx].bounds, aabbRay, tMin, tMax);
+					float tFar = IntersectAabb(nodes[farIdx].bounds, aabbRay, tMin, tMax);
+					if (tFar < tNear) {
+						std::swap(nearIdx, farIdx);
+						std::swap(tNear, tFar);
+					}
+					if (tNear != std::numeric_limits<float>::infinity()) {
+						if (tFar != std::numeric_limits<float>::infinity())
+							stack[stackSize++] = farIdx;
+						nodeIdx = nearIdx;
+						continue;
+					}
+				}
+				// Pop the next node that is still closer than the closest hit found so far.
+				bool nodeFound{false};
+				while (stackSize > 0) {
+					nodeIdx = stack[--stackSize];
+					if (IntersectAabb(nodes[nodeIdx].bounds, aabbRay, tMin, tMax) != std::numeric_limits<float>::infinity()) {
+						nodeFound = true;
+						break;
+					}
+				}
+				if (!nodeFound)
+					break;
+			}
+			return anyHit;
+		}
+
+		// 'occludedPrimitive' has the signature 'bool(uint32_t primIdx)'.
+		// Traversal stops as soon as it returns 'true', the order in which nodes are visited doesn't matter.
+		template <typename OccludedPrimitive>
+		bool Occluded(const numa::Ray& ray, float tMin, float tMax, OccludedPrimitive&& occludedPrimitive) const {
+			return OccludedLeaves(ray, tMin, tMax, [this, &occludedPrimitive](uint32_t first, uint32_t count) {
+				for (uint32_t i = 0; i < count; i++) {
+					if (occludedPrimitive(primIndices[first + i]))
+						return true;
+				}
+				return false;
+				});
+		}
+		// Leaf granularity version of 'Occluded', 'occludedLeaf' has the signature 'bool(uint32_t first, uint32_t count)'.
+		template <typename OccludedLeaf>
+		bool OccludedLeaves(const numa::Ray& ray, float tMin, float tMax, OccludedLeaf&& occludedLeaf) const {
+			if (nodes.empty())
+				return false;
+
+			AabbRay aabbRay{ray};
+			uint32_t stack[traversalStackSize];
+			uint32_t stackSize{0};
+			stack[stackSize++] = 0;
+			while (stackSize > 0) {
+				const BvhNode& node = nodes[stack[--stackSize]];
+				if (IntersectAabb(node.bounds, aabbRay, tMin, tMax) == std::numeric_limits<float>::infinity())
+					continue;
+				if (node.IsLeaf()) {
+					if (occludedLeaf(node.leftFirst, node.primCount))
+						return true;
+				} else {
+					stack[stackSize++] = node.leftFirst + 1;
+					stack[stackSize++] = node.leftFirst;
+				}
+			}
+			return false;
+		}
+
+		// Packet version of 'IntersectClosest', every ray has its own 'tMax' (an array of 'RayPacket8::size').
+		// 'intersectPrimitive' has the signature 'bool(uint32_t primIdx, uint32_t lane, float& tMax)' and is
+		// called for each ray of the packet that reached the primitive's leaf. Returns the mask of the lanes that hit.
+		template <typename IntersectPrimitive>
+		uint32_t IntersectClosest8(const RayPacket8& packet, float tMin, float* tMax, IntersectPrimitive&& intersectPrimitive) const {
+			return IntersectClosestLeaves8(packet, tMin, tMax, [this, &intersectPrimitive](uint32_t first, uint32_t count, uint32_t laneMask, float* leafTMax) {
+				uint32_t hitMask{0};
+				for (uint32_t i = 0; i < count; i++) {
+					for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+						if ((laneMask & (1u << lane)) && intersectPrimitive(primIndices[first + i], lane, leafTMax[lane]))
+							hitMask |= 1u << lane;
+					}
+				}
+				return hitMask;
+				});
+		}
+		// Leaf granularity version of 'IntersectClosest8'. 'intersectLeaf' has the signature
+		// 'uint32_t(uint32_t first, uint32_t count, uint32_t laneMask, float* tMax)' and returns the mask of the lanes that hit.
+		// Nodes are culled for the whole packet with interval arithmetic before the rays are tested one by one.
+		template <typename IntersectLeaf>
+		uint32_t IntersectClosestLeaves8(const RayPacket8& packet, float tMin, float* tMax, IntersectLeaf&& intersectLeaf) const {
+			if (nodes.empty())
+				return 0;
+
+			uint32_t hitMask{0};
+			uint32_t stack[traversalStackSize];
+			uint32_t stackSize{0};
+			stack[stackSize++] = 0;
+			while (stackSize > 0) {
+				const BvhNode& node = nodes[stack[--stackSize]];
+				uint32_t laneMask = IntersectAabbPacketCulled(node.bounds, packet, tMin, tMax);
+				if (laneMask == 0)
+					continue;
+				if (node.IsLeaf()) {
+					hitMask |= intersectLeaf(node.leftFirst, node.primCount, laneMask, tMax);
+					continue;
+				}
+				// There's no single closest child for a packet, the one ahead along the average direction goes first.
+				uint32_t nearIdx = node.leftFirst;
+				uint32_t farIdx = node.leftFirst + 1;
+				if (numa::Dot(nodes[farIdx].bounds.Centroid() - nodes[nearIdx].bounds.Centroid(), packet.averageDirection) < 0.0f)
+					std::swap(nearIdx, farIdx);
+				stack[stackSize++] = farIdx;
+				stack[stackSize++] = nearIdx;
+			}
+			return hitMask;
+		}
+
+		// Packet version of 'OccludedLeaves'. 'occludedLeaf' has the signature
+		// 'uint32_t(uint32_t first, uint32_t count, uint32_t laneMask)' and returns the mask of the lanes it found blocked.
+		// Returns the mask of the occluded lanes, traversal stops once every active lane is blocked.
+		template <typename OccludedLeaf>
+		uint32_t OccludedLeaves8(const RayPacket8& packet, float tMin, const float* tMax, OccludedLeaf&& occludedLeaf) const {
+			if (nodes.empty())
+				return 0;
+
+			uint32_t occludedMask{0};
+			uint32_t stack[traversalStackSize];
+			uint32_t stackSize{0};
+			stack[stackSize++] = 0;
+			while (stackSize > 0) {
+				const BvhNode& node = nodes[stack[--stackSize]];
+				uint32_t laneMask = IntersectAabbPacketCulled(node.bounds, packet, tMin, tMax) & ~occludedMask;
+				if (laneMask == 0)
+					continue;
+				if (node.IsLeaf()) {
+					occludedMask |= occludedLeaf(node.leftFirst, node.primCount, laneMask);
+					if (occludedMask == packet.activeMask)
+						break;
+				} else {
+					stack[stackSize++] = node.leftFirst + 1;
+					stack[stackSize++] = node.leftFirst;
+				}
+			}
+			return occludedMask;
+		}
+
+		bool Empty() const;
+
+		const Aabb& GetBounds() const;
+		const std::vector<BvhNode>& GetNodes() const;
+		const std::vector<uint32_t>& GetPrimIndices() const;
+
+	private:
+		friend class BvhBuildJob;
+
+		std::vector<BvhNode> nodes;
+		std::vector<uint32_t> primIndices;
+
+		BvhBuildSettings settings{};
+	};
+
+}
\ No newline at end of file
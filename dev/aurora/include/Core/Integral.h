@@ -3,6 +3,7 @@
 #include "Core/TaskManager.h"
 
 #include <functional>
+#include <vector>
 
 namespace aurora
 {
@@ -52,9 +53,13 @@ namespace aurora
 	{
 	public:
 
-		bool DoWork() override;
+		void CreateTasks(std::vector<Task*>& tasks) override;
+		void ExecuteTask(Task& task) override;
 
 		void OnStart() override;
 		void OnEnd() override;
+
+	private:
+		Task sumTask{};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "Core/Aabb.h"
+
+#include "Ray.h"
+#include "Vec.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace aurora {
+
+	// Up to 8 coherent rays (e.g. neighbouring camera rays) traversed together.
+	// Ray data is stored in SoA layout, so that a single AVX (or two SSE) slab tests cover the whole packet.
+	struct alignas(32) RayPacket8 {
+		static constexpr uint32_t size{8};
+
+		void SetRay(uint32_t lane, const numa::Ray& ray) {
+			const numa::Vec3& o = ray.GetOrigin();
+			const numa::Vec3& d = ray.GetDirection();
+			originX[lane] = o.x;
+			originY[lane] = o.y;
+			originZ[lane] = o.z;
+			directionX[lane] = d.x;
+			directionY[lane] = d.y;
+			directionZ[lane] = d.z;
+			invDirectionX[lane] = 1.0f / d.x;
+			invDirectionY[lane] = 1.0f / d.y;
+			invDirectionZ[lane] = 1.0f / d.z;
+			activeMask |= 1u << lane;
+		}
+		numa::Ray GetRay(uint32_t lane) const {
+			return numa::Ray{
+				numa::Vec3{originX[lane], originY[lane], originZ[lane]},
+				numa::Vec3{directionX[lane], directionY[lane], directionZ[lane]}
+			};
+		}
+		bool IsActive(uint32_t lane) const {
+			return (activeMask & (1u << lane)) != 0;
+		}
+
+		// Must be called once every ray has been set. Computes the interval bounds used to cull
+		// whole nodes for the packet, and fills the inactive lanes with copies of an active one.
+		void Finalize() {
+			if (activeMask == 0)
+				return;
+			uint32_t firstLane{0};
+			while (!IsActive(firstLane)) {
+				firstLane++;
+			}
+			originMin = numa::Vec3{std::numeric_limits<float>::infinity()};
+			originMax = numa::Vec3{-std::numeric_limits<float>::infinity()};
+			invDirectionMin = originMin;
+			invDirectionMax = originMax;
+			// Interval arithmetic is only conservative if no direction component changes sign (or is zero) within the packet.
+			coherent = true;
+			for (uint32_t lane = 0; lane < size; lane++) {
+				if (!IsActive(lane)) {
+					SetInactiveLane(lane, firstLane);
+					continue;
+				}
+				originMin = numa::Vec3{std::min(originMin.x, originX[lane]), std::min(originMin.y, originY[lane]), std::min(originMin.z, originZ[lane])};
+				originMax = numa::Vec3{std::max(originMax.x, originX[lane]), std::max(originMax.y, originY[lane]), std::max(originMax.z, originZ[lane])};
+				invDirectionMin = numa::Vec3{std::min(invDirectionMin.x, invDirectionX[lane]), std::min(invDirectionMin.y, invDirectionY[lane]), std::min(invDirectionMin.z, invDirectionZ[lane])};
+				invDirectionMax = numa::Vec3{std::max(invDirectionMax.x, invDirectionX[lane]), std::max(invDirectionMax.y, invDirectionY[lane]), std::max(invDirectionMax.z, invDirectionZ[lane])};
+				coherent = coherent &&
+					SameSign(directionX[lane], directionX[firstLane]) &&
+					SameSign(directionY[lane], directionY[firstLane]) &&
+					SameSign(directionZ[lane], directionZ[firstLane]);
+			}
+			averageDirection = numa::Vec3{0.0f};
+			for (uint32_t lane = 0; lane < size; lane++) {
+				averageDirection = averageDirection + numa::Vec3{directionX[lane], directionY[lane], directionZ[lane]};
+			}
+		}
+
+		float originX[size]{};
+		float originY[size]{};
+		float originZ[size]{};
+		float directionX[size]{};
+		float directionY[size]{};
+		float directionZ[size]{};
+		float invDirectionX[size]{};
+		float invDirectionY[size]{};
+		float invDirectionZ[size]{};
+		// Lanes that hold a ray, the others are ignored by the queries.
+		uint32_t activeMask{0};
+
+		// Set by 'Finalize'.
+		numa::Vec3 originMin{0.0f};
+		numa::Vec3 originMax{0.0f};
+		numa::Vec3 invDirectionMin{0.0f};
+		numa::Vec3 invDirectionMax{0.0f};
+		// Not normalized, only used to decide in which order children are visited.
+		numa::Vec3 averageDirection{0.0f};
+		bool coherent{false};
+
+	private:
+		static bool SameSign(float a, float b) {
+			return (a > 0.0f && b > 0.0f) || (a < 0.0f && b < 0.0f);
+		}
+		void SetInactiveLane(uint32_t lane, uint32_t sourceLane) {
+			originX[lane] = originX[sourceLane];
+			originY[lane] = originY[sourceLane];
+			originZ[lane] = originZ[sourceLane];
+			directionX[lane] = directionX[sourceLane];
+			directionY[lane] = directionY[sourceLane];
+			directionZ[lane] = directionZ[sourceLane];
+			invDirectionX[lane] = invDirectionX[sourceLane];
+			invDirectionY[lane] = invDirectionY[sourceLane];
+			invDirectionZ[lane] = invDirectionZ[sourceLane];
+		}
+	};
+
+	// Interval test for a whole packet. Returns 'true' only if no ray of the packet can hit the box
+	// within [tMin, tMax], without looking at the individual rays. Incoherent packets never cull.
+	inline bool CullAabbPacket(const Aabb& aabb, const RayPacket8& packet, float tMin, float tMax) {
+		if (!packet.coherent)
+			return false;
+		// Bounds of '(slab - origin) * invDirection' over every origin and direction of the packet.
+		auto slabInterval = [](float slab, float originMin, float originMax, float invDirMin, float invDirMax, float& lo, float& hi) {
+			float d0 = slab - originMax;
+			float d1 = slab - originMin;
+			float p0 = d0 * invDirMin;
+			float p1 = d0 * invDirMax;
+			float p2 = d1 * invDirMin;
+			float p3 = d1 * invDirMax;
+			lo = std::min(std::min(p0, p1), std::min(p2, p3));
+			hi = std::max(std::max(p0, p1), std::max(p2, p3));
+		};
+		float entryLo{tMin};
+		float exitHi{tMax};
+		auto clipAxis = [&](float boxMin, float boxMax, float originMin, float originMax, float invDirMin, float invDirMax) {
+			// All the directions share a sign, so every ray enters through the same slab.
+			bool positive = invDirMin > 0.0f;
+			float lo, hi;
+			slabInterval(positive ? boxMin : boxMax, originMin, originMax, invDirMin, invDirMax, lo, hi);
+			entryLo = std::max(entryLo, lo);
+			slabInterval(positive ? boxMax : boxMin, originMin, originMax, invDirMin, invDirMax, lo, hi);
+			exitHi = std::min(exitHi, hi);
+		};
+		clipAxis(aabb.min.x, aabb.max.x, packet.originMin.x, packet.originMax.x, packet.invDirectionMin.x, packet.invDirectionMax.x);
+		clipAxis(aabb.min.y, aabb.max.y, packet.originMin.y, packet.originMax.y, packet.invDirectionMin.y, packet.invDirectionMax.y);
+		clipAxis(aabb.min.z, aabb.max.z, packet.originMin.z, packet.originMax.z, packet.invDirectionMin.z, packet.invDirectionMax.z);
+		return entryLo > exitHi;
+	}
+
+	// Slab test of every ray of the packet against one box, each lane with its own (tMin, tMax[lane]).
+	// Returns the mask of the active lanes that hit the box.
+	inline uint32_t IntersectAabbPacket(const Aabb& aabb, const RayPacket8& packet, float tMin, const float* tMax) {
+		uint32_t hitMask{0};
+#if defined(__AVX__)
+		{
+			auto slab = [](float boxMin, float boxMax, const float* origin, const float* invDirection, __m256& tEntry, __m256& tExit) {
+				__m256 o = _mm256_load_ps(origin);
+				__m256 id = _mm256_load_ps(invDirection);
+				__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boxMin), o), id);
+				__m256 t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boxMax), o), id);
+				tEntry = _mm256_max_ps(tEntry, _mm256_min_ps(t1, t2));
+				tExit = _mm256_min_ps(tExit, _mm256_max_ps(t1, t2));
+			};
+			__m256 tEntry = _mm256_set1_ps(tMin);
+			__m256 tExit = _mm256_loadu_ps(tMax);
+			slab(aabb.min.x, aabb.max.x, packet.originX, packet.invDirectionX, tEntry, tExit);
+			slab(aabb.min.y, aabb.max.y, packet.originY, packet.invDirectionY, tEntry, tExit);
+			slab(aabb.min.z, aabb.max.z, packet.originZ, packet.invDirectionZ, tEntry, tExit);
+			hitMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tEntry, tExit, _CMP_LE_OQ)));
+		}
+#elif defined(__SSE__) || defined(_M_X64)
+		for (uint32_t half = 0; half < RayPacket8::size; half += 4) {
+			auto slab = [half](float boxMin, float boxMax, const float* origin, const float* invDirection, __m128& tEntry, __m128& tExit) {
+				__m128 o = _mm_load_ps(origin + half);
+				__m128 id = _mm_load_ps(invDirection + half);
+				__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boxMin), o), id);
+				__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boxMax), o), id);
+				tEntry = _mm_max_ps(tEntry, _mm_min_ps(t1, t2));
+				tExit = _mm_min_ps(tExit, _mm_max_ps(t1, t2));
+			};
+			__m128 tEntry = _mm_set1_ps(tMin);
+			__m128 tExit = _mm_loadu_ps(tMax + half);
+			slab(aabb.min.x, aabb.max.x, packet.originX, packet.invDirectionX, tEntry, tExit);
+			slab(aabb.min.y, aabb.max.y, packet.originY, packet.invDirectionY, tEntry, tExit);
+			slab(aabb.min.z, aabb.max.z, packet.originZ, packet.invDirectionZ, tEntry, tExit);
+			hitMask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tEntry, tExit))) << half;
+		}
+#else
+		// Scalar fallback, used when no suitable instruction set is available.
+		for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+			AabbRay aabbRay{packet.GetRay(lane)};
+			if (IntersectAabb(aabb, aabbRay, tMin, tMax[lane]) != std::numeric_limits<float>::infinity())
+				hitMask |= 1u << lane;
+		}
+#endif
+		return hitMask & packet.activeMask;
+	}
+
+	// Culls the box for the whole packet first, falls back to the per ray test if that fails.
+	inline uint32_t IntersectAabbPacketCulled(const Aabb& aabb, const RayPacket8& packet, float tMin, const float* tMax) {
+		float packetTMax = *std::max_element(tMax, tMax + RayPacket8::size);
+		if (CullAabbPacket(aabb, packet, tMin, packetTMax))
+			return 0;
+		return IntersectAabbPacket(aabb, packet, tMin, tMax);
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,265 @@
+#pragma once
+
+#include "Vec.hpp"
+
+#include <cstdint>
+
+namespace aurora {
+
+	// PCG output permutation of a 32 bit state (Jarzynski and Olano, "Hash Functions for GPU Rendering").
+	constexpr uint32_t HashPcg(uint32_t v) {
+		uint32_t state = v * 747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	// Maps 32 random bits to [0, 1). Only the upper 24 bits are kept, they fit a float's mantissa exactly,
+	// so 1.0f can't be returned.
+	constexpr float ToUnitFloat(uint32_t bits) {
+		return static_cast<float>(bits >> 8) * 0x1p-24f;
+	}
+
+	// The sampler's numbers are these hashes, checked against known values so that a change which would make
+	// renders differ from the ones made before doesn't go unnoticed.
+	static_assert(HashPcg(0u) == 0x07BB2FE2u && HashPcg(1u) == 0xA8BEEA3Cu && HashPcg(2u) == 0x7A7ECC88u &&
+		HashPcg(0xFFFFFFFFu) == 0xE62A4902u, "PCG hash doesn't match its reference values!");
+	static_assert(ToUnitFloat(0u) == 0.0f && ToUnitFloat(0xFFFFFFFFu) < 1.0f, "Unit floats must be in [0, 1)!");
+
+	constexpr uint32_t ReverseBits(uint32_t v) {
+		v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+		v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+		v = ((v >> 4) & 0x0F0F0F0Fu) | ((v & 0x0F0F0F0Fu) << 4);
+		v = ((v >> 8) & 0x00FF00FFu) | ((v & 0x00FF00FFu) << 8);
+		return (v >> 16) | (v << 16);
+	}
+
+	// Owen scrambling of the bits of 'v', as a fraction (Burley, "Practical Hash-based Owen Scrambling").
+	// Every bit is flipped depending on the bits above it, so the stratification of a (0, m, 2) net is kept.
+	constexpr uint32_t NestedUniformScramble(uint32_t v, uint32_t seed) {
+		v = ReverseBits(v);
+		// Laine-Karras style permutation, each bit only depends on the lower ones.
+		v += seed;
+		v ^= v * 0x6C50B47Cu;
+		v ^= v * 0xB82F1E52u;
+		v ^= v * 0xC7AFE638u;
+		v ^= v * 0x8D22F6E6u;
+		return ReverseBits(v);
+	}
+
+	// First two dimensions of the Sobol sequence, as 32 bit fractions. Together they're a (0, 2) sequence,
+	// so every power of two prefix of the points is stratified in all the elementary intervals of the square.
+	constexpr uint32_t SobolDimension0(uint32_t idx) {
+		return ReverseBits(idx);
+	}
+	constexpr uint32_t SobolDimension1(uint32_t idx) {
+		uint32_t result{0};
+		for (uint32_t v = 1u << 31; idx; idx >>= 1, v ^= v >> 1) {
+			if (idx & 1)
+				result ^= v;
+		}
+		return result;
+	}
+
+	// Radical inverse of 'idx' in 'base', the Halton sequence's dimension for that base.
+	constexpr float RadicalInverse(uint32_t base, uint32_t idx) {
+		float invBase = 1.0f / base;
+		float invBaseN{1.0f};
+		uint64_t reversedDigits{0};
+		while (idx) {
+			uint32_t next = idx / base;
+			uint32_t digit = idx - next * base;
+			reversedDigits = reversedDigits * base + digit;
+			invBaseN *= invBase;
+			idx = next;
+		}
+		float value = static_cast<float>(reversedDigits) * invBaseN;
+		return value < 1.0f ? value : 0x1.fffffep-1f;
+	}
+
+	// True when the first 2^log2Count (up to 64) Sobol pairs, scrambled with 'key' the way 'Sampler::Get2D' does it,
+	// have one point in every elementary interval of area 2^-log2Count.
+	constexpr bool IsSobolNetStratified(uint32_t log2Count, uint32_t key) {
+		uint32_t count = 1u << log2Count;
+		for (uint32_t log2CellsX = 0; log2CellsX <= log2Count; log2CellsX++) {
+			uint32_t log2CellsY = log2Count - log2CellsX;
+			bool occupied[64]{};
+			for (uint32_t i = 0; i < count; i++) {
+				uint32_t idx = NestedUniformScramble(i, key);
+				uint32_t x = NestedUniformScramble(SobolDimension0(idx), HashPcg(key));
+				uint32_t y = NestedUniformScramble(SobolDimension1(idx), HashPcg(key ^ 0x68E31DA4u));
+				uint64_t cellX = (uint64_t{x} << log2CellsX) >> 32;
+				uint64_t cellY = (uint64_t{y} << log2CellsY) >> 32;
+				uint64_t cell = (cellX << log2CellsY) | cellY;
+				if (occupied[cell])
+					return false;
+				occupied[cell] = true;
+			}
+		}
+		return true;
+	}
+	// True when the first base^exponent (up to 256) radical inverses in 'base' each sit at the start of an interval
+	// of length base^-exponent of their own.
+	constexpr bool IsRadicalInverseStratified(uint32_t base, uint32_t exponent) {
+		uint32_t count{1};
+		for (uint32_t i = 0; i < exponent; i++) {
+			count *= base;
+		}
+		bool occupied[256]{};
+		for (uint32_t i = 0; i < count; i++) {
+			float scaled = RadicalInverse(base, i) * count;
+			uint32_t cell = static_cast<uint32_t>(scaled + 0.5f);
+			float offset = scaled - cell;
+			if (cell >= count || occupied[cell] || offset > 0.001f || offset < -0.001f)
+				return false;
+			occupied[cell] = true;
+		}
+		return true;
+	}
+
+	static_assert(IsSobolNetStratified(6, 0u) && IsSobolNetStratified(6, HashPcg(1u)) && IsSobolNetStratified(5, HashPcg(2u)),
+		"Scrambled Sobol points must stay stratified!");
+	static_assert(IsRadicalInverseStratified(2, 8) && IsRadicalInverseStratified(3, 5) && IsRadicalInverseStratified(5, 3) &&
+		IsRadicalInverseStratified(131, 1), "Radical inverses must be stratified!");
+
+	enum class SamplerType {
+		// Every number independent of the others.
+		INDEPENDENT,
+		// Pairs of the first two Sobol dimensions, Owen-scrambled. Each pixel and pair of dimensions shuffles the
+		// sample indices with its own scramble, so the pairs aren't correlated with each other ("padding").
+		// Works best with power of two sample counts.
+		SOBOL,
+		// One prime base per dimension. Each pixel shifts the points with its own random offset (Cranley-Patterson rotation).
+		// Dimensions past the prime table fall back to independent numbers.
+		HALTON,
+		// Rank-1 lattice (golden ratio in 1D, R2 in 2D). The per pixel offset is an R2 dither mask over the image,
+		// so neighbouring pixels get well spread offsets, and the error looks like blue noise instead of white noise.
+		BLUE_NOISE_RANK1
+	};
+
+	// Source of the random numbers of one path.
+	// Counter-based: every number is a function of (seed, pixel, sample index, dimension), there's no state shared
+	// between threads and nothing depends on the order pixels are rendered in. A render is the same, bit for bit,
+	// whatever the number of workers or the way the image was split into tasks.
+	// The integrators start one pixel sample per camera ray, then every decision along the path draws the
+	// next dimension(s), always in the same order. With the low-discrepancy types, a 'Get2D' call is a well
+	// distributed 2D point (e.g. for the pixel position or a hemisphere direction), so 2D decisions should use it
+	// instead of two 'Get1D' calls.
+	class Sampler {
+	public:
+		Sampler() = default;
+		explicit Sampler(SamplerType samplerType, uint32_t seed = 0)
+			: samplerType(samplerType), seed(seed) {
+		}
+
+		// Restarts the sequence for sample 'sampleIdx' of pixel (x, y), at 'dimension'.
+		void StartPixelSample(uint32_t x, uint32_t y, uint32_t sampleIdx, uint32_t dimension = 0) {
+			pixel_x = x;
+			pixel_y = y;
+			pixelKey = HashPcg(seed ^ HashPcg(x ^ HashPcg(y)));
+			this->sampleIdx = sampleIdx;
+			this->dimension = dimension;
+		}
+
+		// In [0, 1). Uses up one dimension.
+		float Get1D() {
+			uint32_t dim = dimension++;
+			switch (samplerType) {
+				case SamplerType::SOBOL: {
+					uint32_t dimensionKey = HashPcg(pixelKey ^ HashPcg(dim));
+					uint32_t idx = NestedUniformScramble(sampleIdx, dimensionKey);
+					return ToUnitFloat(NestedUniformScramble(SobolDimension0(idx), HashPcg(dimensionKey)));
+				}
+				case SamplerType::HALTON: {
+					if (dim >= haltonDimensionCount)
+						break;
+					return Rotate(RadicalInverse(haltonPrimes[dim], sampleIdx), dim);
+				}
+				case SamplerType::BLUE_NOISE_RANK1: {
+					// Golden ratio, as a 32 bit fraction.
+					static constexpr uint32_t alpha{0x9E3779B9u};
+					uint32_t offset = DitherR2() + HashPcg(seed ^ HashPcg(dim));
+					return ToUnitFloat(offset + sampleIdx * alpha);
+				}
+				default: {
+				} break;
+			}
+			return ToUnitFloat(HashPcg(pixelKey ^ HashPcg(sampleIdx ^ HashPcg(dim))));
+		}
+		// In [0, 1)^2. Uses up two dimensions.
+		numa::Vec2 Get2D() {
+			uint32_t dim = dimension;
+			switch (samplerType) {
+				case SamplerType::SOBOL: {
+					dimension += 2;
+					uint32_t dimensionKey = HashPcg(pixelKey ^ HashPcg(dim));
+					uint32_t idx = NestedUniformScramble(sampleIdx, dimensionKey);
+					uint32_t x = NestedUniformScramble(SobolDimension0(idx), HashPcg(dimensionKey));
+					uint32_t y = NestedUniformScramble(SobolDimension1(idx), HashPcg(dimensionKey ^ 0x68E31DA4u));
+					return numa::Vec2{ToUnitFloat(x), ToUnitFloat(y)};
+				}
+				case SamplerType::BLUE_NOISE_RANK1: {
+					dimension += 2;
+					// R2 generator (powers of the inverse of the plastic number), as 32 bit fractions.
+					static constexpr uint32_t alpha_x{0xC13FA9A9u};
+					static constexpr uint32_t alpha_y{0x91E10DA5u};
+					uint32_t x = DitherR2() + HashPcg(seed ^ HashPcg(dim)) + sampleIdx * alpha_x;
+					uint32_t y = DitherR2Transposed() + HashPcg(seed ^ HashPcg(dim + 1)) + sampleIdx * alpha_y;
+					return numa::Vec2{ToUnitFloat(x), ToUnitFloat(y)};
+				}
+				default: {
+				} break;
+			}
+			float u = Get1D();
+			float v = Get1D();
+			return numa::Vec2{u, v};
+		}
+
+		// Sampler with a sequence of its own, for work that's done later on (e.g. the sky seen by a shadow ray
+		// traced by another stage of the wavefront integrator). Uses up one of this sampler's dimensions.
+		Sampler Fork() {
+			Sampler forked = *this;
+			// Both the per pixel and the per image scrambles change, the rank-1 offsets only depend on the seed.
+			forked.seed = HashPcg(pixelKey ^ HashPcg(dimension++) ^ 0x9E3779B9u);
+			forked.pixelKey = forked.seed;
+			forked.dimension = 0;
+			return forked;
+		}
+
+		SamplerType GetSamplerType() const {
+			return samplerType;
+		}
+		uint32_t GetDimension() const {
+			return dimension;
+		}
+
+	private:
+		static constexpr uint32_t haltonDimensionCount{32};
+		static constexpr uint32_t haltonPrimes[haltonDimensionCount]{
+			2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+			59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131
+		};
+
+		// Cranley-Patterson rotation of 'value', by an offset of its own for every pixel and dimension.
+		float Rotate(float value, uint32_t dim) const {
+			float rotated = value + ToUnitFloat(HashPcg(pixelKey ^ HashPcg(dim)));
+			return rotated < 1.0f ? rotated : rotated - 1.0f;
+		}
+		// R2 sequence indexed by the pixel, as a 32 bit fraction (Roberts' dither mask).
+		uint32_t DitherR2() const {
+			return pixel_x * 0xC13FA9A9u + pixel_y * 0x91E10DA5u;
+		}
+		// Second mask for the other coordinate of 2D points, so that the offsets of neighbouring pixels aren't on a line.
+		uint32_t DitherR2Transposed() const {
+			return pixel_x * 0x91E10DA5u + pixel_y * 0xC13FA9A9u;
+		}
+
+		SamplerType samplerType{SamplerType::INDEPENDENT};
+		uint32_t seed{0};
+		uint32_t pixel_x{0};
+		uint32_t pixel_y{0};
+		uint32_t pixelKey{0};
+		uint32_t sampleIdx{0};
+		uint32_t dimension{0};
+	};
+
+}
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "Core/WorkStealingDeque.h"
+
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
-#include <stack>
+#include <deque>
 #include <thread>
 #include <vector>
 #include <memory>
@@ -10,10 +14,18 @@
 
 namespace aurora {
 
+	class Job;
+	class TaskManager;
+
+	// Unit of work scheduled on the workers. Jobs derive their own tasks from it and own them,
+	// the task manager only moves pointers around.
 	struct Task {
-		// TODO
+		// Set by the task manager when the task is scheduled.
+		Job* job{nullptr};
 	};
 
+	// A job is a set of tasks, it finishes when the last of them (including the ones spawned while running) is done.
+	// Jobs can depend on other jobs, the task manager then only submits them once all of their dependencies have finished.
 	class Job {
 	public:
 		void Start();
@@ -28,54 +40,141 @@ namespace aurora {
 
 		virtual void Reset();
 
-		virtual bool DoWork() = 0;
+		// Called once when the job is submitted, fills 'tasks' with the job's initial tasks.
+		virtual void CreateTasks(std::vector<Task*>& tasks) = 0;
+		// Runs one of the job's tasks, on whichever thread got it.
+		virtual void ExecuteTask(Task& task) = 0;
+
+		// Runs the whole job on the calling thread, without any task manager.
+		void ExecuteInline();
+
+		// Blocks the calling thread until the job has finished.
+		void Wait();
+
+		// The job won't be submitted before 'dependency' has finished. Must be called before the job is added to the
+		// task manager. A dependency that has already finished is ignored.
+		void AddDependency(Job& dependency);
 
 	protected:
 		Job() = default;
 		virtual ~Job() = default;
 
+		// Schedules another task of this job while it's running, e.g. a subtree discovered by a build task.
+		// On a worker, the task goes to that worker's own deque.
+		void Spawn(Task* task);
+		// Whether some of the task manager's workers are parked for lack of work, e.g. to hand them part of a long task.
+		// Only a hint, and always 'false' outside of a task manager.
+		bool HasIdleWorkers() const;
+
 	private:
-		bool executed{false};
-		bool finished{false};
+		friend class TaskManager;
+
+		std::atomic<bool> executed{false};
+		std::atomic<bool> finished{false};
+
+		TaskManager* taskManager{nullptr};
+		// Tasks scheduled but not done yet.
+		std::atomic<uint32_t> pendingTasks{0};
+		// Tasks spawned by 'ExecuteInline' runs.
+		std::vector<Task*> inlineTasks;
+
+		std::mutex finishMutex{};
+		std::condition_variable finishCondition{};
+
+		// Jobs waiting on this one (guarded by 'finishMutex'), released once it's done.
+		std::vector<Job*> dependents;
+		bool dependentsReleased{false};
+		std::atomic<uint32_t> unfinishedDependencies{0};
 	};
 
+	// Persistent thread owning a work-stealing deque.
+	// Looks for work in its own deque first, then in the task manager's submission queue, then steals from the
+	// other workers. With nothing to do it parks on the task manager's condition variable, instead of spinning.
 	class Worker {
 	public:
+		Worker(TaskManager& taskManager, uint32_t workerIdx);
+
 		void Start();
 		void Stop();
 		void Wait();
-		void Detach();
 
-		void SetJob(Job* job);
-		void RemoveJob();
+		void Push(Task* task);
+		bool Pop(Task*& task);
+		bool Steal(Task*& task);
 
 		bool Running() const;
-		bool Executing() const;
 
 	private:
+		friend class TaskManager;
+
 		void StartImpl();
 
-		std::mutex jobMutex{};
+		TaskManager& taskManager;
+		uint32_t workerIdx{0};
 		std::thread execThread;
+		WorkStealingDeque<Task*> tasks;
 
-		Job* job{ nullptr };
-
-		bool running{ false };
-		bool executing{ false };
+		std::atomic<bool> running{false};
 	};
 
 	class TaskManager {
 	public:
+		TaskManager() = default;
+		TaskManager(const TaskManager&) = delete;
+		TaskManager& operator=(const TaskManager&) = delete;
+		~TaskManager();
+
+		// Starts the worker threads, they stay parked until there's work.
 		void InitializeWorkers(uint32_t threadCount);
+		void TerminateWorkers();
 
 		void AddJob(std::shared_ptr<Job> job);
 
-		void ExecuteTopJob();
+		// Runs every added job, in dependency order. Independent jobs run concurrently, and a job is submitted
+		// as soon as its last dependency finishes, so the workers never wait for a whole phase to be over.
 		void ExecuteAllJobs();
+		// Runs a single job to completion outside of the job stack.
+		// The calling thread works on the job alongside the workers instead of waiting for it.
+		void ExecuteJob(std::shared_ptr<Job> job);
+
+		// Schedules the job's tasks and returns, 'Job::Wait' blocks until it's done.
+		// The job must outlive its execution.
+		void Submit(Job& job);
+
+		uint32_t GetWorkerCount() const;
 
 	private:
+		friend class Job;
+		friend class Worker;
+
+		// Worker of this task manager running on the calling thread, if any.
+		Worker* GetCurrentWorker() const;
+		// Thread safe, called for every task spawned by a running job.
+		void Schedule(Task* task);
+		// Finds a task for 'worker' (nullptr when called from another thread).
+		Task* FindTask(Worker* worker);
+		void ExecuteTask(Task* task);
+		void FinishJob(Job& job);
+
+		void WakeWorkers(bool all);
+		// Blocks a worker until new tasks are scheduled or the workers are stopped.
+		void Park(uint64_t seenEpoch);
+
 		std::vector<std::unique_ptr<Worker>> workers;
-		std::stack<std::shared_ptr<Job>> jobs;
+		std::vector<std::shared_ptr<Job>> jobs;
+
+		// Tasks scheduled from outside of the workers (e.g. a job's initial tasks).
+		std::mutex submissionMutex{};
+		std::deque<Task*> submittedTasks;
+		std::atomic<uint32_t> submittedTaskCount{0};
+
+		// Bumped every time tasks are scheduled. A worker that saw no work only parks if nothing was scheduled since
+		// it started looking, so that wakeups can't be lost.
+		std::atomic<uint64_t> workEpoch{0};
+		std::atomic<uint32_t> parkedWorkers{0};
+		std::mutex parkMutex{};
+		std::condition_variable parkCondition{};
+		std::atomic<bool> stopping{false};
 	};
 
 }
\ No newline at end of file
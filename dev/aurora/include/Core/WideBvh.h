@@ -0,0 +1,466 @@
+#pragma once
+
+#include "Core/Aabb.h"
+#include "Core/Bvh.h"
+#include "Core/RayPacket.h"
+
+#include "Ray.h"
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// Branching factor of the BVHs used for traversal (2, 4 or 8). Set by premake's '--bvh-width' option.
+#ifndef AURORA_BVH_WIDTH
+#define AURORA_BVH_WIDTH 2
+#endif
+
+namespace aurora {
+
+	template <uint32_t Width>
+	struct alignas(32) WideBvhNode {
+		bool IsLeafChild(uint32_t childIdx) const {
+			return primCount[childIdx] > 0;
+		}
+
+		// Child bounds in SoA layout, so that a single SSE/AVX slab test covers every child.
+		float minX[Width];
+		float minY[Width];
+		float minZ[Width];
+		float maxX[Width];
+		float maxY[Width];
+		float maxZ[Width];
+		// Interior children: index of the child node.
+		// Leaf children: index of the first primitive reference in 'WideBvh::primIndices'.
+		uint32_t child[Width];
+		// Number of primitives of leaf children, 0 for interior children.
+		uint32_t primCount[Width];
+		// Slots past 'childCount' are empty and are masked out during traversal.
+		uint32_t childCount{0};
+	};
+
+	// Tests the ray against all the children of 'node' at once.
+	// Returns a bit mask of the children hit within [tMin, tMax], their entry distances are written to 'tNear'.
+	template <uint32_t Width>
+	inline uint32_t IntersectChildren(const WideBvhNode<Width>& node, const AabbRay& ray, float tMin, float tMax, float* tNear) {
+		uint32_t hitMask{0};
+#if defined(__AVX__)
+		if constexpr (Width == 8) {
+			const __m256 ox = _mm256_set1_ps(ray.origin.x);
+			const __m256 oy = _mm256_set1_ps(ray.origin.y);
+			const __m256 oz = _mm256_set1_ps(ray.origin.z);
+			const __m256 idx = _mm256_set1_ps(ray.invDirection.x);
+			const __m256 idy = _mm256_set1_ps(ray.invDirection.y);
+			const __m256 idz = _mm256_set1_ps(ray.invDirection.z);
+			__m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.minX), ox), idx);
+			__m256 tx2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.maxX), ox), idx);
+			__m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.minY), oy), idy);
+			__m256 ty2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.maxY), oy), idy);
+			__m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.minZ), oz), idz);
+			__m256 tz2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.maxZ), oz), idz);
+			__m256 tEntry = _mm256_max_ps(
+				_mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2)),
+				_mm256_max_ps(_mm256_min_ps(tz1, tz2), _mm256_set1_ps(tMin)));
+			__m256 tExit = _mm256_min_ps(
+				_mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2)),
+				_mm256_min_ps(_mm256_max_ps(tz1, tz2), _mm256_set1_ps(tMax)));
+			_mm256_storeu_ps(tNear, tEntry);
+			hitMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tEntry, tExit, _CMP_LE_OQ)));
+			return hitMask & ((1u << node.childCount) - 1u);
+		}
+#endif
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+		if constexpr (Width == 4) {
+			const __m128 ox = _mm_set1_ps(ray.origin.x);
+			const __m128 oy = _mm_set1_ps(ray.origin.y);
+			const __m128 oz = _mm_set1_ps(ray.origin.z);
+			const __m128 idx = _mm_set1_ps(ray.invDirection.x);
+			const __m128 idy = _mm_set1_ps(ray.invDirection.y);
+			const __m128 idz = _mm_set1_ps(ray.invDirection.z);
+			__m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ox), idx);
+			__m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ox), idx);
+			__m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), oy), idy);
+			__m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), oy), idy);
+			__m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), oz), idz);
+			__m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), oz), idz);
+			__m128 tEntry = _mm_max_ps(
+				_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)),
+				_mm_max_ps(_mm_min_ps(tz1, tz2), _mm_set1_ps(tMin)));
+			__m128 tExit = _mm_min_ps(
+				_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)),
+				_mm_min_ps(_mm_max_ps(tz1, tz2), _mm_set1_ps(tMax)));
+			_mm_storeu_ps(tNear, tEntry);
+			hitMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tEntry, tExit)));
+			return hitMask & ((1u << node.childCount) - 1u);
+		}
+#endif
+		// Scalar fallback, used when no suitable instruction set is available.
+		for (uint32_t i = 0; i < node.childCount; i++) {
+			Aabb childBounds{};
+			childBounds.min = numa::Vec3{node.minX[i], node.minY[i], node.minZ[i]};
+			childBounds.max = numa::Vec3{node.maxX[i], node.maxY[i], node.maxZ[i]};
+			tNear[i] = IntersectAabb(childBounds, ray, tMin, tMax);
+			if (tNear[i] != std::numeric_limits<float>::infinity())
+				hitMask |= 1u << i;
+		}
+		return hitMask;
+	}
+
+	// BVH with up to 'Width' children per node, made by collapsing a binary SAH BVH.
+	// Has the same build and traversal interface as 'Bvh', so the two are interchangeable.
+	template <uint32_t Width>
+	class WideBvh {
+	public:
+		static_assert(Width >= 2 && Width <= 8, "Unsupported BVH width!");
+
+		// Every visited node replaces its own entry with at most 'Width' entries. Each wide level spans at least one
+		// binary level, so a path goes through at most 'Bvh::maxDepth' interior nodes and the stack never overflows.
+		static constexpr uint32_t traversalStackSize{1 + Bvh::maxDepth * (Width - 1)};
+
+		void Build(const std::vector<Aabb>& primBounds, const BvhBuildSettings& settings = BvhBuildSettings{}, TaskManager* taskManager = nullptr) {
+			Bvh binaryBvh{};
+			binaryBvh.Build(primBounds, settings, taskManager);
+			Collapse(binaryBvh);
+		}
+		void Collapse(const Bvh& binaryBvh) {
+			Clear();
+			if (binaryBvh.Empty())
+				return;
+			primIndices = binaryBvh.GetPrimIndices();
+			bounds = binaryBvh.GetBounds();
+			nodes.reserve(binaryBvh.GetNodes().size() / (Width - 1) + 1);
+			nodes.emplace_back();
+			CollapseNode(binaryBvh.GetNodes(), 0, 0, 0);
+		}
+		// Same as 'Bvh::Refit'.
+		void Refit(const std::vector<Aabb>& primBounds) {
+			// Children are always stored after their parent, so a reverse sweep visits them first.
+			for (size_t i = nodes.size(); i > 0; i--) {
+				WideBvhNode<Width>& node = nodes[i - 1];
+				for (uint32_t c = 0; c < node.childCount; c++) {
+					Aabb childBounds{};
+					if (node.IsLeafChild(c)) {
+						for (uint32_t p = 0; p < node.primCount[c]; p++) {
+							childBounds.Grow(primBounds[primIndices[node.child[c] + p]]);
+						}
+					} else {
+						childBounds = ComputeNodeBounds(nodes[node.child[c]]);
+					}
+					SetChildBounds(node, c, childBounds);
+				}
+			}
+			bounds = nodes.empty() ? Aabb{} : ComputeNodeBounds(nodes[0]);
+		}
+		void Clear() {
+			nodes.clear();
+			primIndices.clear();
+			bounds = Aabb{};
+		}
+
+		// Same contract as 'Bvh::IntersectClosest'.
+		template <typename IntersectPrimitive>
+		bool IntersectClosest(const numa::Ray& ray, float tMin, float& tMax, IntersectPrimitive&& intersectPrimitive) const {
+			return IntersectClosestLeaves(ray, tMin, tMax, [this, &intersectPrimitive](uint32_t first, uint32_t count, float& leafTMax) {
+				bool anyHit{false};
+				for (uint32_t i = 0; i < count; i++) {
+					if (intersectPrimitive(primIndices[first + i], leafTMax))
+						anyHit = true;
+				}
+				return anyHit;
+				});
+		}
+		// Same contract as 'Bvh::IntersectClosestLeaves'.
+		template <typename IntersectLeaf>
+		bool IntersectClosestLeaves(const numa::Ray& ray, float tMin, float& tMax, IntersectLeaf&& intersectLeaf) const {
+			if (nodes.empty())
+				return false;
+
+			AabbRay aabbRay{ray};
+			bool anyHit{false};
+			StackEntry stack[traversalStackSize];
+			uint32_t stackSize{0};
+			stack[stackSize++] = StackEntry{0, 0, tMin};
+			while (stackSize > 0) {
+				const StackEntry entry = stack[--stackSize];
+				// Skip subtrees that start behind the closest hit found so far.
+				if (entry.tNear > tMax)
+					continue;
+				if (entry.primCount > 0) {
+					if (intersectLeaf(entry.index, entry.primCount, tMax))
+						anyHit = true;
+					continue;
+				}
+
+				const WideBvhNode<Width>& node = nodes[entry.index];
+				float tNear[Width];
+				uint32_t hitMask = IntersectChildren(node, aabbRay, tMin, tMax, tNear);
+				// Sort the hit children far to near, so that the nearest one ends up on the top of the stack.
+				StackEntry hitChildren[Width];
+				uint32_t hitCount{0};
+				for (uint32_t c = 0; c < Width; c++) {
+					if (!(hitMask & (1u << c)))
+						continue;
+					StackEntry childEntry{node.child[c], node.primCount[c], tNear[c]};
+					uint32_t insertIdx = hitCount++;
+					while (insertIdx > 0 && hitChildren[insertIdx - 1].tNear < childEntry.tNear) {
+						hitChildren[insertIdx] = hitChildren[insertIdx - 1];
+						insertIdx--;
+					}
+					hitChildren[insertIdx] = childEntry;
+				}
+				for (uint32_t i = 0; i < hitCount; i++) {
+					stack[stackSize++] = hitChildren[i];
+				}
+			}
+			return anyHit;
+		}
+
+		// Same contract as 'Bvh::Occluded'.
+		template <typename OccludedPrimitive>
+		bool Occluded(const numa::Ray& ray, float tMin, float tMax, OccludedPrimitive&& occludedPrimitive) const {
+			return OccludedLeaves(ray, tMin, tMax, [this, &occludedPrimitive](uint32_t first, uint32_t count) {
+				for (uint32_t i = 0; i < count; i++) {
+					if (occludedPrimitive(primIndices[first + i]))
+						return true;
+				}
+				return false;
+				});
+		}
+		// Same contract as 'Bvh::OccludedLeaves'.
+		template <typename OccludedLeaf>
+		bool OccludedLeaves(const numa::Ray& ray, float tMin, float tMax, OccludedLeaf&& occludedLeaf) const {
+			if (nodes.empty())
+				return false;
+
+			AabbRay aabbRay{ray};
+			uint32_t stack[traversalStackSize];
+			uint32_t stackSize{0};
+			stack[stackSize++] = 0;
+			while (stackSize > 0) {
+				const WideBvhNode<Width>& node = nodes[stack[--stackSize]];
+				float tNear[Width];
+				uint32_t hitMask = IntersectChildren(node, aabbRay, tMin, tMax, tNear);
+				for (uint32_t c = 0; c < Width; c++) {
+					if (!(hitMask & (1u << c)))
+						continue;
+					if (node.IsLeafChild(c)) {
+						if (occludedLeaf(node.child[c], node.primCount[c]))
+							return true;
+					} else {
+						stack[stackSize++] = node.child[c];
+					}
+				}
+			}
+			return false;
+		}
+
+		// Same contract as 'Bvh::IntersectClosest8'.
+		template <typename IntersectPrimitive>
+		uint32_t IntersectClosest8(const RayPacket8& packet, float tMin, float* tMax, IntersectPrimitive&& intersectPrimitive) const {
+			return IntersectClosestLeaves8(packet, tMin, tMax, [this, &intersectPrimitive](uint32_t first, uint32_t count, uint32_t laneMask, float* leafTMax) {
+				uint32_t hitMask{0};
+				for (uint32_t i = 0; i < count; i++) {
+					for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+						if ((laneMask & (1u << lane)) && intersectPrimitive(primIndices[first + i], lane, leafTMax[lane]))
+							hitMask |= 1u << lane;
+					}
+				}
+				return hitMask;
+				});
+		}
+		// Same contract as 'Bvh::IntersectClosestLeaves8'.
+		template <typename IntersectLeaf>
+		uint32_t IntersectClosestLeaves8(const RayPacket8& packet, float tMin, float* tMax, IntersectLeaf&& intersectLeaf) const {
+			if (nodes.empty())
+				return 0;
+
+			uint32_t hitMask{0};
+			PacketStackEntry stack[traversalStackSize];
+			uint32_t stackSize{0};
+			stack[stackSize++] = PacketStackEntry{0, 0, 0.0f};
+			while (stackSize > 0) {
+				const PacketStackEntry entry = stack[--stackSize];
+				if (entry.primCount > 0) {
+					// The child was tested when its parent was visited, but the rays may have found closer hits since.
+					uint32_t laneMask = IntersectAabbPacket(entry.bounds, packet, tMin, tMax);
+					if (laneMask != 0)
+						hitMask |= intersectLeaf(entry.index, entry.primCount, laneMask, tMax);
+					continue;
+				}
+
+				const WideBvhNode<Width>& node = nodes[entry.index];
+				// Order the hit children far to near along the packet's average direction.
+				PacketStackEntry hitChildren[Width];
+				uint32_t hitCount{0};
+				for (uint32_t c = 0; c < node.childCount; c++) {
+					Aabb childBounds = GetChildBounds(node, c);
+					if (IntersectAabbPacketCulled(childBounds, packet, tMin, tMax) == 0)
+						continue;
+					PacketStackEntry childEntry{node.child[c], node.primCount[c], numa::Dot(childBounds.Centroid(), packet.averageDirection), childBounds};
+					uint32_t insertIdx = hitCount++;
+					while (insertIdx > 0 && hitChildren[insertIdx - 1].order < childEntry.order) {
+						hitChildren[insertIdx] = hitChildren[insertIdx - 1];
+						insertIdx--;
+					}
+					hitChildren[insertIdx] = childEntry;
+				}
+				for (uint32_t i = 0; i < hitCount; i++) {
+					stack[stackSize++] = hitChildren[i];
+				}
+			}
+			return hitMask;
+		}
+
+		// Same contract as 'Bvh::OccludedLeaves8'.
+		template <typename OccludedLeaf>
+		uint32_t OccludedLeaves8(const RayPacket8& packet, float tMin, const float* tMax, OccludedLeaf&& occludedLeaf) const {
+			if (nodes.empty())
+				return 0;
+
+			uint32_t occludedMask{0};
+			uint32_t stack[traversalStackSize];
+			uint32_t stackSize{0};
+			stack[stackSize++] = 0;
+			while (stackSize > 0) {
+				const WideBvhNode<Width>& node = nodes[stack[--stackSize]];
+				for (uint32_t c = 0; c < node.childCount; c++) {
+					uint32_t laneMask = IntersectAabbPacketCulled(GetChildBounds(node, c), packet, tMin, tMax) & ~occludedMask;
+					if (laneMask == 0)
+						continue;
+					if (node.IsLeafChild(c)) {
+						occludedMask |= occludedLeaf(node.child[c], node.primCount[c], laneMask);
+						if (occludedMask == packet.activeMask)
+							return occludedMask;
+					} else {
+						stack[stackSize++] = node.child[c];
+					}
+				}
+			}
+			return occludedMask;
+		}
+
+		bool Empty() const {
+			return nodes.empty();
+		}
+
+		const Aabb& GetBounds() const {
+			return bounds;
+		}
+		const std::vector<WideBvhNode<Width>>& GetNodes() const {
+			return nodes;
+		}
+		const std::vector<uint32_t>& GetPrimIndices() const {
+			return primIndices;
+		}
+
+	private:
+		struct StackEntry {
+			// Node index for interior nodes, first primitive reference for leaves.
+			uint32_t index{0};
+			uint32_t primCount{0};
+			float tNear{0.0f};
+		};
+
+		struct PacketStackEntry {
+			uint32_t index{0};
+			uint32_t primCount{0};
+			// Position along the packet's average direction, used to sort the children.
+			float order{0.0f};
+			// Only needed by leaves, which are re-tested when popped.
+			Aabb bounds{};
+		};
+
+		void CollapseNode(const std::vector<BvhNode>& binaryNodes, uint32_t binaryIdx, uint32_t wideIdx, uint32_t depth) {
+			assert(depth < Bvh::maxDepth && "BVH is deeper than the traversal stack allows!");
+			// Pull up to 'Width' binary descendants into this node by repeatedly opening
+			// the interior one with the largest surface area (the one most likely to be hit).
+			uint32_t children[Width];
+			uint32_t childCount{0};
+			const BvhNode& binaryNode = binaryNodes[binaryIdx];
+			if (binaryNode.IsLeaf()) {
+				children[childCount++] = binaryIdx;
+			} else {
+				children[childCount++] = binaryNode.leftFirst;
+				children[childCount++] = binaryNode.leftFirst + 1;
+				while (childCount < Width) {
+					int openIdx{-1};
+					float openArea{-1.0f};
+					for (uint32_t c = 0; c < childCount; c++) {
+						const BvhNode& child = binaryNodes[children[c]];
+						if (!child.IsLeaf() && child.bounds.SurfaceArea() > openArea) {
+							openIdx = static_cast<int>(c);
+							openArea = child.bounds.SurfaceArea();
+						}
+					}
+					if (openIdx < 0)
+						break;
+					uint32_t openedLeftIdx = binaryNodes[children[openIdx]].leftFirst;
+					children[openIdx] = openedLeftIdx;
+					children[childCount++] = openedLeftIdx + 1;
+				}
+			}
+
+			{
+				WideBvhNode<Width>& node = nodes[wideIdx];
+				node.childCount = childCount;
+				for (uint32_t c = 0; c < Width; c++) {
+					SetChildBounds(node, c, c < childCount ? binaryNodes[children[c]].bounds : Aabb{});
+					node.child[c] = 0;
+					node.primCount[c] = 0;
+				}
+			}
+			for (uint32_t c = 0; c < childCount; c++) {
+				const BvhNode& child = binaryNodes[children[c]];
+				if (child.IsLeaf()) {
+					nodes[wideIdx].child[c] = child.leftFirst;
+					nodes[wideIdx].primCount[c] = child.primCount;
+				} else {
+					// Children are appended after their parent, 'Refit' relies on that.
+					uint32_t childWideIdx = static_cast<uint32_t>(nodes.size());
+					nodes.emplace_back();
+					nodes[wideIdx].child[c] = childWideIdx;
+					CollapseNode(binaryNodes, children[c], childWideIdx, depth + 1);
+				}
+			}
+		}
+
+		static void SetChildBounds(WideBvhNode<Width>& node, uint32_t childIdx, const Aabb& childBounds) {
+			node.minX[childIdx] = childBounds.min.x;
+			node.minY[childIdx] = childBounds.min.y;
+			node.minZ[childIdx] = childBounds.min.z;
+			node.maxX[childIdx] = childBounds.max.x;
+			node.maxY[childIdx] = childBounds.max.y;
+			node.maxZ[childIdx] = childBounds.max.z;
+		}
+		static Aabb GetChildBounds(const WideBvhNode<Width>& node, uint32_t childIdx) {
+			Aabb childBounds{};
+			childBounds.min = numa::Vec3{node.minX[childIdx], node.minY[childIdx], node.minZ[childIdx]};
+			childBounds.max = numa::Vec3{node.maxX[childIdx], node.maxY[childIdx], node.maxZ[childIdx]};
+			return childBounds;
+		}
+		static Aabb ComputeNodeBounds(const WideBvhNode<Width>& node) {
+			Aabb nodeBounds{};
+			for (uint32_t c = 0; c < node.childCount; c++) {
+				nodeBounds.Grow(GetChildBounds(node, c));
+			}
+			return nodeBounds;
+		}
+
+		std::vector<WideBvhNode<Width>> nodes;
+		std::vector<uint32_t> primIndices;
+		Aabb bounds{};
+	};
+
+	// The BVH type used by the scene and the meshes for traversal, selected at build time.
+#if AURORA_BVH_WIDTH == 4 || AURORA_BVH_WIDTH == 8
+	using TraversalBvh = WideBvh<AURORA_BVH_WIDTH>;
+#else
+	using TraversalBvh = Bvh;
+#endif
+
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace aurora {
+
+	// Chase-Lev work-stealing deque (with the memory orderings of Le et al., "Correct and Efficient
+	// Work-Stealing for Weak Memory Models").
+	// Only the owner thread pushes and pops, at the bottom, so its own work is taken back LIFO while it is still
+	// cache hot. Any other thread can steal from the top, which holds the oldest (usually biggest) work.
+	// The owner never takes a lock, and thieves only contend on 'top'.
+	template <typename T>
+	class WorkStealingDeque {
+		static_assert(std::is_trivially_copyable_v<T>, "Work-stealing deque items must be trivially copyable!");
+
+	public:
+		explicit WorkStealingDeque(int64_t capacity = 256) {
+			assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "Work-stealing deque capacity must be a power of two!");
+			buffers.push_back(std::make_unique<Buffer>(capacity));
+			buffer.store(buffers.back().get(), std::memory_order_relaxed);
+		}
+		WorkStealingDeque(const WorkStealingDeque&) = delete;
+		WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+		// Owner only.
+		void Push(T item) {
+			int64_t b = bottom.load(std::memory_order_relaxed);
+			int64_t t = top.load(std::memory_order_acquire);
+			Buffer* a = buffer.load(std::memory_order_relaxed);
+			if (b - t > a->capacity - 1) {
+				a = Grow(a, b, t);
+			}
+			a->Put(b, item);
+			// Publishes the item (and whatever the task points to) to the thieves, which read 'bottom' with acquire.
+			bottom.store(b + 1, std::memory_order_release);
+		}
+		// Owner only. Returns 'false' if the deque is empty.
+		bool Pop(T& item) {
+			int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			Buffer* a = buffer.load(std::memory_order_relaxed);
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t > b) {
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return false;
+			}
+			item = a->Get(b);
+			if (t == b) {
+				// Last item, race the thieves for it.
+				bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return won;
+			}
+			return true;
+		}
+		// Any thread. Returns 'false' if the deque is empty or another thread got the item first.
+		bool Steal(T& item) {
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t b = bottom.load(std::memory_order_acquire);
+			if (t >= b)
+				return false;
+			Buffer* a = buffer.load(std::memory_order_acquire);
+			item = a->Get(t);
+			return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+		// Only a hint when called concurrently with the owner.
+		bool Empty() const {
+			int64_t b = bottom.load(std::memory_order_relaxed);
+			int64_t t = top.load(std::memory_order_relaxed);
+			return b <= t;
+		}
+
+	private:
+		struct Buffer {
+			explicit Buffer(int64_t capacity)
+				: capacity(capacity), mask(capacity - 1), items(std::make_unique<std::atomic<T>[]>(capacity)) {
+			}
+			T Get(int64_t idx) const {
+				return items[idx & mask].load(std::memory_order_relaxed);
+			}
+			void Put(int64_t idx, T item) {
+				items[idx & mask].store(item, std::memory_order_relaxed);
+			}
+
+			int64_t capacity{0};
+			int64_t mask{0};
+			std::unique_ptr<std::atomic<T>[]> items;
+		};
+
+		Buffer* Grow(Buffer* a, int64_t b, int64_t t) {
+			buffers.push_back(std::make_unique<Buffer>(a->capacity * 2));
+			Buffer* grown = buffers.back().get();
+			for (int64_t i = t; i < b; i++) {
+				grown->Put(i, a->Get(i));
+			}
+			buffer.store(grown, std::memory_order_release);
+			return grown;
+		}
+
+		// Kept on their own cache lines, 'bottom' is written by the owner on every push and pop.
+		alignas(64) std::atomic<int64_t> top{0};
+		alignas(64) std::atomic<int64_t> bottom{0};
+		alignas(64) std::atomic<Buffer*> buffer{nullptr};
+		// Thieves may still be reading from an old buffer after a grow, so they're only freed with the deque.
+		std::vector<std::unique_ptr<Buffer>> buffers;
+	};
+
+}
\ No newline at end of file
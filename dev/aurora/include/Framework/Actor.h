@@ -2,9 +2,12 @@
 
 #include "Framework/Components/Component.h"
 #include "Framework/Components/Geometry.h"
+#include "Framework/Components/Transform.h"
 
 #include "Ray.h"
 
+#include <cstdint>
+#include <limits>
 #include <string_view>
 #include <string>
 #include <memory>
@@ -14,8 +17,14 @@ namespace aurora {
 
 	class Actor;
 
+	// Marks a missing material or light in 'ActorRayHit'.
+	static constexpr uint32_t invalidSceneIdx{std::numeric_limits<uint32_t>::max()};
+
 	struct ActorRayHit : public GeometryRayHit {
 		Actor* hitActor{nullptr};
+		// Indices into the arrays frozen by 'Scene::Commit', filled by the scene queries.
+		uint32_t hitMaterialIdx{invalidSceneIdx};
+		uint32_t hitLightIdx{invalidSceneIdx};
 	};
 
 	class Actor : public std::enable_shared_from_this<Actor> {
@@ -23,6 +32,10 @@ namespace aurora {
 		Actor(std::string_view actorName);
 
 		virtual bool Intersect(const numa::Ray& ray, ActorRayHit& actorRayHit);
+		virtual bool Occluded(const numa::Ray& ray, float tMin, float tMax);
+
+		// Object-to-world frame of the actor's transform (identity if it has none).
+		Frame GetFrame() const;
 
 		template <typename T>
 		void AttachComponent(std::shared_ptr<T> component) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Core/Sampler.h"
+
 #include "Framework/Actor.h"
 #include "Framework/Light.h"
 #include "Framework/Components/Geometry.h"
@@ -40,7 +42,8 @@ namespace aurora {
 		bool IntersectAtmosphere(const numa::Ray& ray, ActorRayHit& rayHit) const;
 
 		numa::Vec3 GetSunlight(const numa::Vec3& p, DirectionalLight* sun);
-		numa::Vec3 ComputeSkyColor(const numa::Ray& ray, DirectionalLight* dirLight) const;
+		// The view ray's segments are jittered with 'sampler'.
+		numa::Vec3 ComputeSkyColor(const numa::Ray& ray, DirectionalLight* dirLight, Sampler& sampler) const;
 
 		float RayleighPhaseFunction(float cosTheta) const;
 		float MiePhaseFunction(float cosTheta) const;
@@ -40,8 +40,13 @@ namespace aurora {
 	public:
 		Camera(uint32_t resolution_x, uint32_t resolution_y, FovType fovType, float fovDeg);
 
+		// Freezes the camera's transform, rays are generated from that copy.
+		// Must be called again whenever the camera moves, 'Scene::Commit' does that for the scene's camera.
+		void Commit();
+
 		numa::Ray GenerateCameraRay(uint32_t x_coord, uint32_t y_coord) const;
-		numa::Ray GenerateCameraRayJittered(uint32_t x_coord, uint32_t y_coord) const;
+		// 'u' (in [0, 1)^2) is where the ray goes through the pixel, e.g. 'Sampler::Get2D'.
+		numa::Ray GenerateCameraRayJittered(uint32_t x_coord, uint32_t y_coord, const numa::Vec2& u) const;
 
 		void ResizeCamera(uint32_t resolution_x, uint32_t resolution_y);
 		void ChangeCameraFOV_Y(float fov_y);
@@ -73,6 +78,8 @@ namespace aurora {
 		float fov_x_deg{0.0f}; // horizontal fov
 
 		FovType fovType{FovType::VERTICAL};
+
+		Frame cameraFrame{};
 	};
 
 }
\ No newline at end of file
@@ -1,12 +1,18 @@
 #pragma once
 
+#include "Core/Aabb.h"
+#include "Core/Bvh.h"
+
 #include "Framework/Components/Component.h"
+#include "Framework/Components/Transform.h"
 
 #include "Intersect.h"
 #include "Ray.h"
 #include "Vec.hpp"
 
+#include <cstdint>
 #include <limits>
+#include <memory>
 
 namespace aurora {
 
@@ -21,6 +27,21 @@ namespace aurora {
 
 	class Geometry;
 
+	// What traversal carries around while looking for the closest hit.
+	// Everything else is reconstructed for the final hit only, see 'ComputeSurfaceInteraction'.
+	struct HitRecord {
+		float t{std::numeric_limits<float>::infinity()};
+		// Local hit coordinates, their meaning depends on the geometry
+		// (barycentrics of the second and the third triangle vertex, object space XY on a plane).
+		float u{0.0f};
+		float v{0.0f};
+		// Triangle of a mesh, sphere of the scene's sphere list.
+		uint32_t primIdx{0};
+		// Set by the scene queries.
+		uint32_t instanceIdx{std::numeric_limits<uint32_t>::max()};
+	};
+
+	// Full surface interaction, built once from a 'HitRecord'.
 	struct GeometryRayHit {
 		numa::Ray   hitRay{numa::Vec3{0.0f}, numa::Vec3{0.0f}};
 
@@ -36,16 +57,67 @@ namespace aurora {
 		bool hitFrontFace{false};
 	};
 
+	// Geometries are defined in object space and don't depend on their owner's transform.
+	// A single geometry may therefore be attached to any number of actors (instances),
+	// each of them placing it in the world with its own transform.
 	class Geometry : public Component {
 	public:
 		static constexpr ComponentType COMPONENT_TYPE = ComponentType::GEOMETRY;
 
 		Geometry(GeometryType geometryType);
-		virtual bool Intersect(const numa::Ray& ray, GeometryRayHit& geometryHit) = 0;
+
+		void OnOwnerAttach(std::shared_ptr<Actor> ownerActor) override;
+		void OnOwnerDetach() override;
+
+		// World space queries. The ray is moved into the object space defined by 'frame',
+		// hit points and normals are moved back into world space.
+		// Closest hit within (0, tMax), only the compact record is filled.
+		bool Intersect(const numa::Ray& ray, const Frame& frame, float tMax, HitRecord& hit) const;
+		// Evaluates the hit attributes of a record returned by 'Intersect' with the same ray and frame.
+		void ComputeSurfaceInteraction(const numa::Ray& ray, const Frame& frame, const HitRecord& hit, GeometryRayHit& geometryHit) const;
+		// Both of the above at once, for callers that don't care about the intermediate record.
+		bool Intersect(const numa::Ray& ray, const Frame& frame, GeometryRayHit& geometryHit) const;
+		// Any-hit query within (tMin, tMax). No hit attributes are computed.
+		bool Occluded(const numa::Ray& ray, const Frame& frame, float tMin, float tMax) const;
+		virtual Aabb ComputeWorldBounds(const Frame& frame) const;
+
+		// Object space queries.
+		virtual bool IntersectLocal(const numa::Ray& ray, float tMax, HitRecord& hit) const = 0;
+		virtual void ComputeSurfaceInteractionLocal(const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const = 0;
+		virtual bool OccludedLocal(const numa::Ray& ray, float tMin, float tMax) const = 0;
+
+		// Builds the geometry's own (bottom level) acceleration structure, if it has one.
+		// Called by the scene once per unique geometry, however many actors share it.
+		virtual void BuildAccelerationStructure(const BvhBuildSettings& settings, TaskManager* taskManager);
+
+		// Unbounded geometries (e.g. infinite planes) can't be put into a BVH.
+		virtual bool IsBounded() const;
+		virtual Aabb ComputeLocalBounds() const = 0;
+
 		GeometryType GetGeometryType() const;
+		uint32_t GetOwnerCount() const;
 
 	private:
 		GeometryType geometryType{};
+		uint32_t ownerCount{0};
+	};
+
+	class Circle : public Geometry {
+	public:
+		Circle();
+		Circle(float radius);
+
+		// The disk lies in the object space XY plane, centered at the origin and facing +Z.
+		bool IntersectLocal(const numa::Ray& ray, float tMax, HitRecord& hit) const override;
+		void ComputeSurfaceInteractionLocal(const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const override;
+		bool OccludedLocal(const numa::Ray& ray, float tMin, float tMax) const override;
+
+		Aabb ComputeLocalBounds() const override;
+
+		float GetRadius() const;
+
+	private:
+		float radius{1.0f};
 	};
 
 	class Plane : public Geometry {
@@ -53,7 +125,13 @@ namespace aurora {
 		Plane();
 		Plane(const numa::Vec2& dimensions);
 
-		bool Intersect(const numa::Ray& ray, GeometryRayHit& geometryHit) override;
+		// The plane lies in the object space XY plane, facing +Z.
+		bool IntersectLocal(const numa::Ray& ray, float tMax, HitRecord& hit) const override;
+		void ComputeSurfaceInteractionLocal(const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const override;
+		bool OccludedLocal(const numa::Ray& ray, float tMin, float tMax) const override;
+
+		bool IsBounded() const override;
+		Aabb ComputeLocalBounds() const override;
 
 		const numa::Vec2& GetDimensions() const;
 
@@ -67,9 +145,18 @@ namespace aurora {
 		Sphere();
 		Sphere(float radius);
 
-		bool Intersect(const numa::Ray& ray, GeometryRayHit& geometryHit) override;
+		// The sphere is centered at the object space origin.
+		bool IntersectLocal(const numa::Ray& ray, float tMax, HitRecord& hit) const override;
+		void ComputeSurfaceInteractionLocal(const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const override;
+		bool OccludedLocal(const numa::Ray& ray, float tMin, float tMax) const override;
+
+		// Rotation doesn't change the bounds of a sphere, so the 8 box corners aren't needed.
+		Aabb ComputeWorldBounds(const Frame& frame) const override;
+		Aabb ComputeLocalBounds() const override;
 
+		// 'point' is expected in object space.
 		float DistanceFromEdge(const numa::Vec3& point) const;
+		// 'point' is expected in object space.
 		// Result is a value in the range [0, 1]
 		// 0 - the point is in the center of the sphere
 		// 1 - the point is right on the edge of the sphere
@@ -78,6 +165,7 @@ namespace aurora {
 		float GetRadius() const;
 
 	private:
+		// 'pointOnSphere' is expected in object space.
 		numa::Vec3 ComputeNormal(const numa::Vec3& pointOnSphere) const;
 
 		float radius{ 1.0 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Core/Sampler.h"
+
 #include "Framework/Components/Component.h"
 
 #include "Vec.hpp"
@@ -19,8 +21,16 @@ namespace aurora {
 
 		MaterialType GetMaterialType() const;
 
-		virtual numa::Vec3 Scatter(const numa::Vec3& wo, const numa::Vec3& N,
+		// Samples the incident direction with the next dimensions of 'sampler'.
+		virtual numa::Vec3 Scatter(const numa::Vec3& wo, const numa::Vec3& N, Sampler& sampler,
 			                       numa::Vec3& brdf, float& pdf) const = 0;
+		// Density, per unit solid angle like the one returned by 'Scatter', of 'Scatter' picking 'wi'. Used to weight
+		// light samples against scattered rays that hit the light (multiple importance sampling).
+		// 0 for directions 'Scatter' never picks, light samples then get all of the weight.
+		virtual float Pdf(const numa::Vec3& wo, const numa::Vec3& wi, const numa::Vec3& N) const = 0;
+		// Specular materials scatter into single directions, with a 'brdf' that already holds the 1 / |cos| of the
+		// direction picked. They can't be lit by light samples, only by the scattered rays that hit the lights.
+		virtual bool IsSpecular() const;
 
 	protected:
 		Material(MaterialType materialType);
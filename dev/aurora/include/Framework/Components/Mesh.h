@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Core/Aabb.h"
+#include "Core/Bvh.h"
+#include "Core/WideBvh.h"
+
+#include "Framework/Components/Geometry.h"
+
+#include "Ray.h"
+#include "Vec.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace aurora {
+
+	// Ray data shared by all the triangle tests of a single traversal.
+	// See "Watertight Ray/Triangle Intersection" by Woop, Benthin and Wald (JCGT 2013).
+	struct WatertightRay {
+		WatertightRay(const numa::Ray& ray);
+
+		numa::Vec3 origin{0.0f};
+		// Shear constants.
+		float Sx{0.0f};
+		float Sy{0.0f};
+		float Sz{0.0f};
+		// Permuted axes, 'kz' is the dimension where the ray direction is maximal.
+		int kx{0};
+		int ky{1};
+		int kz{2};
+	};
+
+	struct TriangleHit {
+		float t{0.0f};
+		// Barycentric coordinates of the second and the third vertex.
+		// The first one is '1 - b1 - b2'.
+		float b1{0.0f};
+		float b2{0.0f};
+	};
+
+	// Indexed triangle mesh. Vertex attributes and the BVH are stored in object space,
+	// so actors sharing the same mesh only pay for it once.
+	class Mesh : public Geometry {
+	public:
+		// 'indices' holds three vertex indices per triangle.
+		// The BVH isn't built until 'BuildAccelerationStructure' is called (the scene does that).
+		// 'normals' and 'uvs' are optional, but if present must have the same size as 'positions'.
+		Mesh(std::vector<numa::Vec3> positions, std::vector<uint32_t> indices);
+		Mesh(std::vector<numa::Vec3> positions,
+		     std::vector<numa::Vec3> normals,
+		     std::vector<numa::Vec2> uvs,
+		     std::vector<uint32_t> indices);
+
+		// 'hit.u' and 'hit.v' are the barycentrics of the hit triangle, 'hit.primIdx' its index.
+		bool IntersectLocal(const numa::Ray& ray, float tMax, HitRecord& hit) const override;
+		void ComputeSurfaceInteractionLocal(const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const override;
+		bool OccludedLocal(const numa::Ray& ray, float tMin, float tMax) const override;
+
+		void BuildAccelerationStructure(const BvhBuildSettings& settings, TaskManager* taskManager) override;
+
+		Aabb ComputeLocalBounds() const override;
+		const Aabb& GetLocalBounds() const;
+
+		uint32_t GetTriangleCount() const;
+		uint32_t GetVertexCount() const;
+
+		bool HasNormals() const;
+		bool HasUvs() const;
+
+	private:
+		void ComputeBounds();
+
+		bool IntersectTriangle(uint32_t triangleIdx, const WatertightRay& ray, float tMin, float tMax, TriangleHit& hit) const;
+		numa::Vec3 ComputeGeometricNormal(uint32_t triangleIdx) const;
+
+		std::vector<numa::Vec3> positions;
+		std::vector<numa::Vec3> normals;
+		std::vector<numa::Vec2> uvs;
+		std::vector<uint32_t> indices;
+
+		Aabb localBounds{};
+		TraversalBvh bvh;
+	};
+
+}
\ No newline at end of file
@@ -2,11 +2,35 @@
 
 #include "Framework/Components/Component.h"
 
+#include "Numa.h"
 #include "Vec.hpp"
 #include "Mat.hpp"
 
 namespace aurora {
 
+	// Rigid (rotation and translation only) object-to-world transform stored as an orthonormal basis.
+	// The world-to-object direction is the transposed basis, so no matrix inverse is ever needed.
+	// Distances along a ray are the same in both spaces.
+	struct Frame {
+		numa::Vec3 ToLocalPoint(const numa::Vec3& p) const {
+			return ToLocalDirection(p - position);
+		}
+		numa::Vec3 ToLocalDirection(const numa::Vec3& d) const {
+			return numa::Vec3{numa::Dot(d, right), numa::Dot(d, up), numa::Dot(d, forward)};
+		}
+		numa::Vec3 ToWorldPoint(const numa::Vec3& p) const {
+			return position + ToWorldDirection(p);
+		}
+		numa::Vec3 ToWorldDirection(const numa::Vec3& d) const {
+			return d.x * right + d.y * up + d.z * forward;
+		}
+
+		numa::Vec3 right{1.0f, 0.0f, 0.0f};
+		numa::Vec3 up{0.0f, 1.0f, 0.0f};
+		numa::Vec3 forward{0.0f, 0.0f, 1.0f};
+		numa::Vec3 position{0.0f, 0.0f, 0.0f};
+	};
+
 	class Transform : public Component {
 	public:
 		static constexpr ComponentType COMPONENT_TYPE = ComponentType::TRANSFORM;
@@ -29,6 +53,8 @@ namespace aurora {
 		numa::Vec3 GetUpAxis() const;
 		numa::Vec3 GetForwardAxis() const;
 
+		Frame GetFrame() const;
+
 	private:
 		void UpdateWorldMatrix();
 
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "Framework/Components/Component.h"
+#include "Framework/Components/Geometry.h"
+#include "Framework/Components/Transform.h"
 
 #include "Vec.hpp"
 
+#include <cstdint>
+#include <limits>
 #include <vector>
 
 namespace aurora {
@@ -22,22 +26,71 @@ namespace aurora {
 		numa::Vec3 Li{};
 		float pdf{1.0f};
 		Light* lightPtr{nullptr};
+		// Index of the sampled light record, see 'Scene::SampleLights'.
+		uint32_t lightIdx{std::numeric_limits<uint32_t>::max()};
 	};
 
+	// Length of the shadow ray from 'p' to the light sample.
+	// Directional lights are infinitely far away.
+	float ComputeShadowRayLength(const numa::Vec3& p, const LightSampleData& lightSample);
+
 	struct LightSampleBundle {
 		void AddLightSample(const LightSampleData& lightSample);
 		std::vector<LightSampleData> bundle;
 	};
 
+	// Render-ready copy of a light, frozen by 'Light::Commit'.
+	// Sampling a record doesn't go through the owner actor, so it's safe and cheap to do per ray.
+	struct LightRecord {
+		// 'u' (in [0, 1)^2) picks the point on area lights, delta lights ignore it. Area lights are sampled by solid angle
+		// where they can be: quads as spherical rectangles and spheres within the cone they subtend. Circles are sampled
+		// uniformly by area.
+		void Sample(const numa::Vec3& p, const numa::Vec3& N, const numa::Vec2& u, LightSampleData& data) const;
+		// Density, per unit solid angle at 'p' like the one of 'Sample', of 'Sample' picking 'lightPoint' (a point of
+		// the light, e.g. where a scattered ray hit it). 0 for delta lights and from behind quads and circles.
+		float Pdf(const numa::Vec3& p, const numa::Vec3& lightPoint) const;
+		// Light arriving at 'p' from 'lightPoint' (a point picked by 'Sample') per unit area of the light: the radiance
+		// times the cosine at the light over the squared distance, 0 from behind. Point lights give their intensity over
+		// the squared distance. Unlike the densities of 'Sample', this measure doesn't depend on 'p', so the same light
+		// point can be weighted at several shaded points.
+		numa::Vec3 EvaluatePerArea(const numa::Vec3& p, const numa::Vec3& lightPoint) const;
+
+		// Directional lights shine along '-frame.forward', area lights face '+frame.forward'.
+		Frame frame{};
+		// Emitted radiance (directional and area lights) or intensity (point lights).
+		numa::Vec3 radiance{0.0f};
+		// Area lights only, the shape of the light's geometry.
+		numa::Vec2 dimensions{0.0f};
+		float radius{0.0f};
+		// Derived from the shape and the frame by 'Commit', so that sampling is only arithmetic.
+		// Quads span 'edgeX' and 'edgeY' from 'corner', quads and circles face 'frame.forward'.
+		numa::Vec3 corner{0.0f};
+		numa::Vec3 edgeX{0.0f};
+		numa::Vec3 edgeY{0.0f};
+		float area{0.0f};
+		GeometryType shape{GeometryType::COUNT};
+		LightType lightType{};
+		Light* light{nullptr};
+	};
+
 	class Light : public Component {
 	public:
 		static constexpr ComponentType COMPONENT_TYPE = ComponentType::LIGHT;
 
 		Light(LightType type);
 
-		virtual void Sample(const numa::Vec3& p, const numa::Vec3& N, LightSampleData& data) = 0;
+		// Freezes the owner's transform (and geometry) into the light record.
+		// Must be called again whenever the owner moves, 'Scene::Commit' does that for the scene's lights.
+		virtual void Commit();
+
+		// Samples the state frozen by the last 'Commit'.
+		void Sample(const numa::Vec3& p, const numa::Vec3& N, const numa::Vec2& u, LightSampleData& data) const;
 
 		LightType GetLightType() const;
+		const LightRecord& GetLightRecord() const;
+
+	protected:
+		LightRecord lightRecord{};
 
 	private:
 		LightType type{};
@@ -47,15 +100,11 @@ namespace aurora {
 	public:
 		DirectionalLight(const numa::Vec3& lightColor, float lightStrength);
 
-		void Sample(const numa::Vec3& p, const numa::Vec3& N, LightSampleData& data) override;
-
-		numa::Vec3 P() const;
+		void Commit() override;
 
 		numa::Vec3 Wi() const;
 		numa::Vec3 Li() const;
 
-		float pdf() const;
-
 	private:
 		numa::Vec3 color{1.0f, 1.0f, 1.0f};
 		float strength{1.0f};
@@ -65,14 +114,7 @@ namespace aurora {
 	public:
 		PointLight(const numa::Vec3& lightColor, float lightIntensity);
 
-		void Sample(const numa::Vec3& p, const numa::Vec3& N, LightSampleData& data) override;
-
-		numa::Vec3 P() const;
-
-		numa::Vec3 Wi(const numa::Vec3& p) const;
-		numa::Vec3 Li(float d) const;
-
-		float pdf() const;
+		void Commit() override;
 
 	private:
 		numa::Vec3 color{1.0f, 1.0f, 1.0f};
@@ -83,14 +125,10 @@ namespace aurora {
 	public:
 		AreaLight(const numa::Vec3& lightColor, float lightIntensity);
 
-		void Sample(const numa::Vec3& p, const numa::Vec3& N, LightSampleData& data) override;
-
-		numa::Vec3 P() const;
+		void Commit() override;
 
 		numa::Vec3 Li() const;
 
-		float pdf(const numa::Vec3& wi, const numa::Vec3& N, float r) const;
-
 	private:
 		numa::Vec3 color{1.0f, 1.0f, 1.0f};
 		float intensity{1.0f};
@@ -22,8 +22,10 @@ namespace aurora
 
 		Dielectric(const numa::Vec3& attenuation, float ior);
 
-		numa::Vec3 Scatter(const numa::Vec3& wo, const numa::Vec3& N,
+		numa::Vec3 Scatter(const numa::Vec3& wo, const numa::Vec3& N, Sampler& sampler,
 			               numa::Vec3& brdf, float& pdf) const override;
+		float Pdf(const numa::Vec3& wo, const numa::Vec3& wi, const numa::Vec3& N) const override;
+		bool IsSpecular() const override;
 
 		FresnelData Fresnel(const numa::Vec3& incident, const numa::Vec3& normal, float ior) const;
 
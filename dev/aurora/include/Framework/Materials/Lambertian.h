@@ -11,8 +11,9 @@ namespace aurora {
 		Lambertian();
 		Lambertian(const numa::Vec3& albedo);
 
-		numa::Vec3 Scatter(const numa::Vec3& wo, const numa::Vec3& N,
+		numa::Vec3 Scatter(const numa::Vec3& wo, const numa::Vec3& N, Sampler& sampler,
 			               numa::Vec3& brdf, float& pdf) const override;
+		float Pdf(const numa::Vec3& wo, const numa::Vec3& wi, const numa::Vec3& N) const override;
 
 		numa::Vec3 Brdf() const;
 		float Pdf(float cosTheta) const;
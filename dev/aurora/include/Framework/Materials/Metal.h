@@ -12,11 +12,12 @@ namespace aurora {
 		Metal();
 		Metal(const numa::Vec3& attenuation, float fuzziness = 0.0f);
 
-		numa::Vec3 Scatter(const numa::Vec3& wo, const numa::Vec3& N,
+		numa::Vec3 Scatter(const numa::Vec3& wo, const numa::Vec3& N, Sampler& sampler,
 			               numa::Vec3& brdf, float& pdf) const override;
+		float Pdf(const numa::Vec3& wo, const numa::Vec3& wi, const numa::Vec3& N) const override;
 
 		// Incident direction should point at the surface
-		numa::Vec3 Reflect(const numa::Vec3& incidentDirection, const numa::Vec3& normal) const;
+		numa::Vec3 Reflect(const numa::Vec3& incidentDirection, const numa::Vec3& normal, Sampler& sampler) const;
 
 		void SetAttenuation(const numa::Vec3& attenuation);
 		const numa::Vec3& GetAttenuation() const;
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Framework/Components/Mesh.h"
+
+#include <filesystem>
+#include <memory>
+
+namespace aurora {
+
+	// Loads a Wavefront OBJ file into a single triangle mesh.
+	// Polygons are triangulated as fans, groups and materials are ignored.
+	// Throws 'std::runtime_error' if the file can't be opened or is malformed.
+	std::shared_ptr<Mesh> LoadObjMesh(const std::filesystem::path& filePath);
+
+}
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "Renderer/PixelBuffer.h"
+#include "Renderer/PpmImageWriter.h"
 
+#include "Core/Sampler.h"
 #include "Core/TaskManager.h"
 
 #include "Framework/Actor.h"
@@ -15,8 +17,15 @@
 #include "Ray.h"
 #include "Vec.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace aurora {
 
@@ -27,14 +36,113 @@ namespace aurora {
 		uint32_t raster_y_end{0};
 	};
 
+	// Probability for a path to go on past the Russian roulette depth: the largest component of its throughput, so dim
+	// paths are cut early. Survivors divide their throughput by it, which keeps the estimator unbiased.
+	inline float RussianRouletteSurvival(const numa::Vec3& throughput) {
+		return std::min(std::max({throughput.x, throughput.y, throughput.z}), 1.0f);
+	}
+
+	// How light samples and scattered rays that hit an area light are weighted against each other (multiple
+	// importance sampling). Each strategy gets the most weight where it's the better one: light samples for small
+	// or far away lights, scattered rays for big lights and glossy surfaces.
+	enum class MisHeuristic {
+		BALANCE,
+		// Balance of the squared pdfs, better when one of the strategies is much better than the other.
+		POWER
+	};
+
+	// Weight of a sample taken with density 'pdf' (> 0), against the other strategy's 'otherPdf' for the same direction.
+	inline float MisWeight(MisHeuristic heuristic, float pdf, float otherPdf) {
+		// Written with the ratio, so that the squares of big pdfs (grazing angles) don't overflow.
+		float ratio = otherPdf / pdf;
+		if (heuristic == MisHeuristic::POWER)
+			ratio *= ratio;
+		return 1.0f / (1.0f + ratio);
+	}
+
+	// Instead of the same number of samples everywhere, every pixel gets 'minSampleCount' samples, then rounds of
+	// 'batchSampleCount' more go to the pixels whose estimate is still noisy, until they have converged, reached
+	// 'maxSampleCount', or the budget is spent. Flat, directly lit pixels stop early, and the samples they didn't
+	// take go to the caustics and media.
+	struct AdaptiveSamplingSettings {
+		bool enabled{false};
+		int minSampleCount{16};
+		int maxSampleCount{1024};
+		// Keep the counts multiples of a power of two for the Sobol sampler.
+		int batchSampleCount{16};
+		// A pixel has converged once the standard error of its mean luminance is below this fraction of the mean.
+		float errorThreshold{0.01f};
+		// Average number of samples per pixel. It's shared by the pixels of each block of 'blockSize' x 'blockSize'
+		// pixels on the image, when it can't cover all of the noisy ones the noisiest go first. 0 for no budget.
+		float sampleBudget{0.0f};
+		// The blocks are fixed on the image, so the samples go to the same pixels however the image is split between
+		// the workers. Bigger blocks move samples further, from converged areas to noisy ones, but are less parallel.
+		uint32_t blockSize{32};
+		// Seconds a rendering job may spend, after that the pixels left only get 'minSampleCount' samples. 0 for no limit.
+		// Unlike the sample budget it depends on the machine, so renders with a time budget aren't reproducible.
+		double timeBudget{0.0};
+	};
+
+	// Direct lighting by resampled importance sampling (RIS), for scenes with many small lights. At every vertex,
+	// 'candidateCount' light samples are drawn without shadow rays, and one of them is kept in proportion to its
+	// unshadowed contribution for the only shadow ray. With a fixed sample count, the camera vertices also resample the
+	// picks of 'spatialNeighborCount' similar pixels within 'spatialRadius' in the same tile before tracing it
+	// (Bitterli et al., "Spatiotemporal reservoir resampling for real-time ray tracing with dynamic direct lighting").
+	// Candidates come from the light BVH. Loop integrator only.
+	struct ReservoirSamplingSettings {
+		bool enabled{false};
+		uint32_t candidateCount{16};
+		uint32_t spatialNeighborCount{4};
+		uint32_t spatialRadius{4};
+		// Side of the square tiles, fixed on the image, the loop integrator renders together.
+		// Neighbours are only taken from the same tile.
+		uint32_t tileSize{32};
+	};
+
+	// Weighted reservoir over light samples. Candidates stream through it, and the kept one is replaced by each
+	// candidate with a probability of the candidate's weight over the sum of the weights so far.
+	struct LightReservoir {
+		// 'u' is in [0, 1). Candidate counts are left to the caller, merged reservoirs bring several at once.
+		void Update(const LightSampleData& candidate, float candidateTargetPdf, float weight, float u) {
+			weightSum += weight;
+			if (weight > 0.0f && u * weightSum < weight) {
+				lightSample = candidate;
+				targetPdf = candidateTargetPdf;
+			}
+		}
+
+		LightSampleData lightSample{};
+		// Unshadowed contribution (luminance) of the kept sample per unit area of its light, at the reservoir's point.
+		float targetPdf{0.0f};
+		float weightSum{0.0f};
+		uint32_t candidateCount{0};
+	};
+
 	class PathTracer {
 	public:
 		void InitializePixelBuffer(uint32_t width, uint32_t height);
 		void ClearPixelBuffer(const numa::Vec3& clearColor);
 
 		void RenderSceneLoop(std::shared_ptr<Scene> scene);
+		// Same estimator as 'RenderSceneLoop', computed by the wavefront integrator (see 'WavefrontPathTracer').
+		void RenderSceneWavefront(std::shared_ptr<Scene> scene);
+		// Rows are traced in packets of 'RayPacket8::size' camera rays.
 		void RenderPixels(const ImageRegion& renderRegion, const Scene& scene);
+		void RenderPixelPacket(uint32_t raster_coord_x, uint32_t raster_coord_y, uint32_t pixelCount, const Scene& scene);
 		void RenderPixel(uint32_t raster_coord_x, uint32_t raster_coord_y, const Scene& scene);
+		// Next event estimation integrator ('RenderPixelLoop') over a region, this is what the rendering job's workers run.
+		// Regions don't overlap, so workers never write to the same pixel.
+		void RenderPixelsLoop(const ImageRegion& renderRegion, const Scene& scene);
+		// Same, into another buffer than the path tracer's (e.g. the one of a rendering job).
+		void RenderPixelsLoop(const ImageRegion& renderRegion, const Scene& scene, f32PixelBuffer& targetBuffer) const;
+		// Adaptive version of the above (see 'AdaptiveSamplingSettings'), which 'RenderPixelsLoop' switches to when it's enabled.
+		// Each block of the region (see 'GetLoopBlockSize') shares a sample budget, no round is started past 'deadline'.
+		void RenderPixelsAdaptive(const ImageRegion& renderRegion, const Scene& scene, f32PixelBuffer& targetBuffer,
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) const;
+		// Version of 'RenderPixelsLoop' with spatial reuse of the direct lighting samples (see 'ReservoirSamplingSettings'),
+		// which 'RenderPixelsLoop' switches to when it's enabled. For each block of the region (see 'GetLoopBlockSize'), every
+		// sample pass first finds the camera vertices of the whole block, then resamples them and traces the rest of the paths.
+		void RenderPixelsReservoir(const ImageRegion& renderRegion, const Scene& scene, f32PixelBuffer& targetBuffer) const;
 		void RenderPixelLoop(uint32_t raster_coord_x, uint32_t raster_coord_y, const Scene& scene);
 
 		// Tone Mapping Opperators
@@ -47,22 +155,86 @@ namespace aurora {
 
 		void GammaCorrectPower12();
 
+		// Region versions of the above, for post processing tiles as soon as they're rendered.
+
+		static void ToneMapReinhardtLuminance(f32PixelBuffer& pixels, const ImageRegion& region);
+		static void GammaCorrectPower12(f32PixelBuffer& pixels, const ImageRegion& region);
+		// Converts to 8 bits per channel, the same way the image writers convert float pixels.
+		static void Quantize(const f32PixelBuffer& pixels, const ImageRegion& region, u8PixelBuffer& output);
+
 		const f32PixelBuffer* GetPixelBuffer() const;
 
+		// Sequence the integrators draw their camera, BSDF and light samples from.
+		void SetSamplerType(SamplerType samplerType);
+		SamplerType GetSamplerType() const;
+
+		// Longest path, in bounces. With Russian roulette it can be raised (e.g. for glass) without paying for every bounce
+		// of every path.
+		void SetRayDepthLimit(int rayDepthLimit);
+		int GetRayDepthLimit() const;
+		// Depth from which paths are terminated at random, depending on their throughput (see 'RussianRouletteSurvival').
+		// Setting it to 'rayDepthLimit' or more turns the roulette off.
+		void SetRussianRouletteDepth(int russianRouletteDepth);
+		int GetRussianRouletteDepth() const;
+
+		void SetMisHeuristic(MisHeuristic misHeuristic);
+		MisHeuristic GetMisHeuristic() const;
+
+		void SetAdaptiveSampling(const AdaptiveSamplingSettings& adaptiveSampling);
+		const AdaptiveSamplingSettings& GetAdaptiveSampling() const;
+
+		void SetReservoirSampling(const ReservoirSamplingSettings& reservoirSampling);
+		const ReservoirSamplingSettings& GetReservoirSampling() const;
+		// Side of the blocks of the image (starting at its top left corner) the loop integrator renders together,
+		// 1 when pixels are independent. Regions given to it should be made of whole blocks, the adaptive sample
+		// budget and the spatial reuse then don't depend on how the image was split.
+		uint32_t GetLoopBlockSize() const;
+
 	private:
 		numa::Vec3 BackgroundColor(const numa::Ray& ray);
 
-		numa::Vec3 ComputeColor(const numa::Ray& ray, const Scene& scene, int rayDepth);
-
-		numa::Vec3 ShadeMaterial(const ActorRayHit& rayHit, const Scene& scene, int rayDepth);
-		numa::Vec3 ShadeLambertian(const ActorRayHit& rayHit, const Scene& scene, const Lambertian* lambertian, int rayDepth);
-		numa::Vec3 ShadeMetal(const ActorRayHit& rayHit, const Scene& scene, const Metal* metal, int rayDepth);
-		numa::Vec3 ShadeDielectric(const ActorRayHit& rayHit, const Scene& scene, const Dielectric* dielectric, int rayDepth);
-		numa::Vec3 ShadeParticipatingMedium(const ActorRayHit& rayHit, const Scene& scene, const ParticipatingMedium* medium, int rayDepth);
+		// Calls 'renderBlock' for the part of every block of 'renderRegion' (see 'GetLoopBlockSize') within the region.
+		void ForEachLoopBlock(const ImageRegion& renderRegion, const std::function<void(const ImageRegion&)>& renderBlock) const;
+		// Single block versions of 'RenderPixelsAdaptive' and 'RenderPixelsReservoir'.
+		void RenderBlockAdaptive(const ImageRegion& blockRegion, const Scene& scene, f32PixelBuffer& targetBuffer,
+			std::chrono::steady_clock::time_point deadline) const;
+		void RenderBlockReservoir(const ImageRegion& blockRegion, const Scene& scene, f32PixelBuffer& targetBuffer) const;
+
+		// Body of 'RenderPixelLoop'.
+		numa::Vec3 ComputePixelRadianceLoop(uint32_t raster_coord_x, uint32_t raster_coord_y, const Scene& scene) const;
+		// One path of the above, for sample 'sampleIdx' of the pixel.
+		numa::Vec3 ComputeSampleRadianceLoop(uint32_t raster_coord_x, uint32_t raster_coord_y, uint32_t sampleIdx, const Scene& scene,
+			Sampler& sampler, LightSampleBundle& lightBundle) const;
+		// Rest of a path from 'ray', which is its bounce 'firstRayDepth'. 'scatterPdf' and 'scatterNormal' describe how
+		// 'ray' was scattered, 0 when the light it hits was already accounted for by the previous vertex.
+		numa::Vec3 TracePathLoop(numa::Ray ray, int firstRayDepth, numa::Vec3 throughput, float scatterPdf, numa::Vec3 scatterNormal,
+			const Scene& scene, Sampler& sampler, LightSampleBundle& lightBundle) const;
+		// Next event estimation at 'p', without the path's throughput.
+		numa::Vec3 EstimateDirectLighting(const numa::Vec3& p, const numa::Vec3& n, const numa::Vec3& wo, const numa::Vec3& brdf,
+			const Material& material, const Scene& scene, Sampler& sampler, LightSampleBundle& lightBundle) const;
+		// Resampled direct lighting, see 'ReservoirSamplingSettings'. 'candidateCount' light samples streamed through a reservoir.
+		LightReservoir SampleLightReservoir(const numa::Vec3& p, const numa::Vec3& n, const numa::Vec3& brdf, const Scene& scene, Sampler& sampler) const;
+		// Traces the shadow ray of the reservoir's sample. 'normalization' is the number of candidates that could have
+		// produced it, the sample is weighted by the reservoir's weight sum over it and the sample's target pdf.
+		numa::Vec3 ShadeLightReservoir(const LightReservoir& reservoir, float normalization, const numa::Vec3& p, const numa::Vec3& n,
+			const numa::Vec3& brdf, const Scene& scene) const;
+
+		// Recursive integrator. 'throughput' is the weight the caller will give to the returned radiance, for the
+		// Russian roulette.
+		numa::Vec3 ComputeColor(const numa::Ray& ray, const Scene& scene, const numa::Vec3& throughput, int rayDepth, Sampler& sampler);
+		// Rest of 'ComputeColor' once the closest hit is known, a missed ray has 'rayHit.hit' cleared.
+		numa::Vec3 ShadeRayHit(const numa::Ray& ray, const ActorRayHit& rayHit, const Scene& scene, const numa::Vec3& throughput, int rayDepth, Sampler& sampler);
+
+		numa::Vec3 ShadeMaterial(const ActorRayHit& rayHit, const Scene& scene, const numa::Vec3& throughput, int rayDepth, Sampler& sampler);
+		numa::Vec3 ShadeLambertian(const ActorRayHit& rayHit, const Scene& scene, const Lambertian* lambertian, const numa::Vec3& throughput, int rayDepth, Sampler& sampler);
+		numa::Vec3 ShadeMetal(const ActorRayHit& rayHit, const Scene& scene, const Metal* metal, const numa::Vec3& throughput, int rayDepth, Sampler& sampler);
+		numa::Vec3 ShadeDielectric(const ActorRayHit& rayHit, const Scene& scene, const Dielectric* dielectric, const numa::Vec3& throughput, int rayDepth, Sampler& sampler);
+		numa::Vec3 ShadeParticipatingMedium(const ActorRayHit& rayHit, const Scene& scene, const ParticipatingMedium* medium, const numa::Vec3& throughput, int rayDepth, Sampler& sampler);
 
 		std::shared_ptr<f32PixelBuffer> pixelBuffer;
 
 		int rayDepthLimit{5};
+		int russianRouletteDepth{3};
 		int sampleCount{150};
 		// int sampleCount{25};
 		// int sampleCount{15};
@@ -71,33 +243,93 @@ namespace aurora {
 		// int sampleCount{1};
 
 		bool multisampling{false};
+
+		SamplerType samplerType{SamplerType::SOBOL};
+		MisHeuristic misHeuristic{MisHeuristic::POWER};
+		AdaptiveSamplingSettings adaptiveSampling{};
+		ReservoirSamplingSettings reservoirSampling{};
 	};
 
 	struct RenderingTask : Task {
 		// TODO
 	};
 
+	// Stages every tile goes through. Each one is spawned as a continuation of the previous one, so it usually
+	// runs right after it on the same worker, while the tile's pixels are still in its cache.
+	enum class TileStage {
+		RENDER,
+		TONE_MAP,
+		QUANTIZE,
+		WRITE
+	};
+
 	struct SceneRenderingTask : RenderingTask {
 		uint32_t raster_x_start{0};
 		uint32_t raster_x_end{0};
 		uint32_t raster_y_start{0};
 		uint32_t raster_y_end{0};
+		TileStage stage{TileStage::RENDER};
+	};
+
+	// Time spent rendering each pixel of an image. Measured by a rendering job during one pass, and used on the next
+	// one to split the expensive parts of the image (e.g. media and glass) into smaller tasks up front.
+	class RenderCostMap {
+	public:
+		RenderCostMap(uint32_t width, uint32_t height);
+
+		// Spreads 'seconds' evenly over the region's pixels. Regions recorded at the same time must not overlap.
+		void Record(const ImageRegion& region, double seconds);
+		double Estimate(const ImageRegion& region) const;
+		double GetTotalCost() const;
+		// Whether anything has been recorded yet.
+		bool HasCosts() const;
+
+		uint32_t GetWidth() const;
+		uint32_t GetHeight() const;
+
+	private:
+		uint32_t width{0};
+		uint32_t height{0};
+		std::vector<float> pixelCosts;
+		std::atomic<bool> hasCosts{false};
+	};
+
+	// Order in which square tiles are handed out. Both keep consecutive tiles close on screen, so the tiles being
+	// rendered at the same time share most of the BVH nodes and scene data they touch.
+	// A Hilbert curve never jumps, a Morton curve jumps at the edges of its quadrants but is cheaper to compute.
+	enum class TileOrder {
+		MORTON,
+		HILBERT
 	};
 
 	class SceneRenderingJob : public Job {
 	public:
-		SceneRenderingJob(PathTracer* pathTracer, Scene* scene);
+		static constexpr uint32_t defaultTileSize{32};
+
+		SceneRenderingJob(PathTracer* pathTracer, Scene* scene,
+			uint32_t tileSize = defaultTileSize, TileOrder tileOrder = TileOrder::HILBERT);
 		virtual ~SceneRenderingJob() = default;
 
 		void OnStart() override;
 		void OnEnd() override;
 
-		bool DoWork() override;
-
-		bool AcquireRenderingTask(SceneRenderingTask& renderingTask);
+		void CreateTasks(std::vector<Task*>& tasks) override;
+		void ExecuteTask(Task& task) override;
 
 		void NotifyRenderingTaskFinished(const SceneRenderingTask& renderingTask);
 
+		// With a writer, tiles are tone mapped, gamma corrected, quantized and written to the image as they're done.
+		// Without one, the job only renders, see 'GetPixelBuffer'.
+		void SetImageWriter(std::shared_ptr<PpmImageWriter> imageWriter);
+
+		// The job renders into its own buffer, so that the jobs of different scenes can run at the same time.
+		const f32PixelBuffer* GetPixelBuffer() const;
+
+		// Costs measured by the last pass. Passing them on to the job of the next pass (or submitting this one again)
+		// splits the tiles that were expensive before they're handed out.
+		std::shared_ptr<RenderCostMap> GetCostMap() const;
+		void SetCostMap(std::shared_ptr<RenderCostMap> costMap);
+
 		PathTracer* pathTracer{nullptr};
 		Scene* scene{nullptr};
 
@@ -109,17 +341,39 @@ namespace aurora {
 
 		void CreateSquareRenderingTasks(uint32_t width, uint32_t height, uint32_t squareSideSize);
 
-		std::mutex renderingTaskMutex{};
+		// Splits 'tile' into halves until each of them is expected to cost at most 'maxCost'.
+		void SplitCostlyRenderingTask(const SceneRenderingTask& tile, double maxCost);
+		// Renders the task row by row, timing every row. While workers are idle, the second half of the rows
+		// left is split off into a new task for them.
+		void RenderTile(SceneRenderingTask& renderingTask);
+
+		// Only serializes the progress output, tasks are handed out by the task manager.
 		std::mutex notificationMutex{};
 
-		std::stack<SceneRenderingTask> renderingTasks;
+		std::shared_ptr<f32PixelBuffer> pixelBuffer;
+		std::shared_ptr<u8PixelBuffer> outputBuffer;
+		std::shared_ptr<PpmImageWriter> imageWriter;
+
+		// The image split as configured, the tasks of every pass are derived from it.
+		std::vector<SceneRenderingTask> tiles;
+		// Never resized once the job is submitted, the task manager holds pointers to them.
+		std::vector<SceneRenderingTask> renderingTasks;
+		// Tasks split off while rendering. Elements of a deque don't move when it grows.
+		std::mutex splitTaskMutex{};
+		std::deque<SceneRenderingTask> splitTasks;
+		std::shared_ptr<RenderCostMap> costMap;
+
+		// Set from the adaptive sampling time budget when the job starts.
+		std::chrono::steady_clock::time_point renderDeadline{std::chrono::steady_clock::time_point::max()};
 
-		uint32_t tasksToDo{};
-		uint32_t tasksDone{};
+		std::atomic<uint32_t> tasksToDo{};
+		std::atomic<uint32_t> tasksDone{};
 
 		double donePercentage{};
 
 		uint32_t lineCount{};
+		uint32_t tileSize{defaultTileSize};
+		TileOrder tileOrder{TileOrder::HILBERT};
 		uint32_t imageWidth{};
 		uint32_t imageHeight{};
 	};
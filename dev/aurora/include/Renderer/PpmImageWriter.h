@@ -5,9 +5,11 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <vector>
 
 namespace aurora {
 
@@ -57,6 +59,14 @@ namespace aurora {
 
 		void ChangeFileName(std::string_view fileName);
 
+		// Incremental output, for images that are produced a region at a time (e.g. by rendering tiles).
+		// Rows are written out in order, as soon as all of their pixels have been provided, so the file is
+		// complete as soon as the last region is, without a separate pass over the whole image.
+		void BeginImage(uint32_t imageWidth, uint32_t imageHeight);
+		// Thread safe. The pixels of 'pixelBuffer' in [x_start, x_end) x [y_start, y_end) are final.
+		void WriteRegion(const u8PixelBuffer& pixelBuffer, uint32_t x_start, uint32_t x_end, uint32_t y_start, uint32_t y_end);
+		void EndImage();
+
 	protected:
 		virtual std::ofstream CreateOpenImageFile() = 0;
 
@@ -68,6 +78,15 @@ namespace aurora {
 
 		std::string fileName;
 		PpmImageProps ppmProps{};
+
+	private:
+		// Incremental output state.
+		std::mutex imageMutex{};
+		std::ofstream imageFile;
+		// How many pixels of each row have been provided.
+		std::vector<uint32_t> rowPixelCounts;
+		uint32_t nextRow{0};
+		uint32_t imageWidth{0};
 	};
 
 	class PpmAsciiImageWriter : public PpmImageWriter {
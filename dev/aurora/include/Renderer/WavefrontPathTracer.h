@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Renderer/PathTracer.h"
+#include "Renderer/PixelBuffer.h"
+
+#include "Core/AlignedAllocator.h"
+#include "Core/Sampler.h"
+
+#include "Framework/Components/Geometry.h"
+
+#include "Scene/Scene.h"
+
+#include "Ray.h"
+#include "Vec.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace aurora {
+
+	// States of the paths in flight, in SoA layout so that every stage only streams through the fields it needs.
+	struct PathQueue {
+		void Resize(uint32_t capacity);
+		void SetRay(uint32_t pathIdx, const numa::Ray& ray);
+		numa::Ray GetRay(uint32_t pathIdx) const;
+		// Moves path 'srcIdx' into slot 'dstIdx' (used by the compaction).
+		void Move(uint32_t dstIdx, uint32_t srcIdx);
+
+		AlignedVector<float> originX;
+		AlignedVector<float> originY;
+		AlignedVector<float> originZ;
+		AlignedVector<float> directionX;
+		AlignedVector<float> directionY;
+		AlignedVector<float> directionZ;
+		AlignedVector<float> throughputR;
+		AlignedVector<float> throughputG;
+		AlignedVector<float> throughputB;
+		// Density of the path's last scattered direction, see 'Material::Pdf'.
+		AlignedVector<float> scatterPdf;
+		// Normal where it was scattered, the lights picked there depend on it.
+		AlignedVector<numa::Vec3> scatterNormal;
+		// Set when the path was last scattered by a specular material, see 'Material::IsSpecular'.
+		AlignedVector<uint8_t> specularBounce;
+		// Index of the path's pixel within the rendered region.
+		AlignedVector<uint32_t> pixelIndices;
+		// Where each path is in its pixel sample's random sequence, see 'Sampler'.
+		AlignedVector<Sampler> samplers;
+		uint32_t size{0};
+	};
+
+	// Next event estimation rays. 'contribution' (throughput * BRDF * cosine / pdf) times the light's radiance
+	// is only added to the pixel if the ray reaches the light.
+	struct ShadowRayQueue {
+		void Resize(uint32_t capacity);
+
+		AlignedVector<float> originX;
+		AlignedVector<float> originY;
+		AlignedVector<float> originZ;
+		AlignedVector<float> directionX;
+		AlignedVector<float> directionY;
+		AlignedVector<float> directionZ;
+		AlignedVector<float> tMax;
+		AlignedVector<numa::Vec3> contribution;
+		AlignedVector<numa::Vec3> Li;
+		AlignedVector<uint32_t> pixelIndices;
+		AlignedVector<uint32_t> lightIndices;
+		// Forked from the path's sampler, for the sky seen by rays toward distant lights.
+		AlignedVector<Sampler> samplers;
+		uint32_t size{0};
+	};
+
+	// Breadth-first version of 'PathTracer::RenderPixelLoop', computing the same estimator.
+	// Instead of following one path through all of its bounces, every bounce of all the paths of a region
+	// is run as a sequence of stages over the queues:
+	// - generate: one camera ray per pixel and sample pass,
+	// - extend: closest hits, traced 8 rays at a time with the scene's packet query,
+	// - shade: light hits and misses end their paths, the rest are grouped by material and scattered,
+	// - connect: shadow rays toward the lights picked by the scene, also traced 8 at a time,
+	// - accumulate: unoccluded light contributions are added to the region's radiance.
+	// Terminated paths are compacted away after each bounce, so later bounces only touch live paths.
+	class WavefrontPathTracer {
+	public:
+		// 'russianRouletteDepth' as in 'PathTracer::SetRussianRouletteDepth', the default turns it off.
+		WavefrontPathTracer(int sampleCount, int rayDepthLimit, SamplerType samplerType = SamplerType::INDEPENDENT,
+			int russianRouletteDepth = std::numeric_limits<int>::max(), MisHeuristic misHeuristic = MisHeuristic::POWER);
+
+		// Renders the region into 'pixelBuffer', averaging 'sampleCount' passes.
+		void Render(const ImageRegion& region, const Scene& scene, f32PixelBuffer& pixelBuffer);
+
+	private:
+		void Generate(const ImageRegion& region, const Scene& scene, int sample);
+		void Extend(const Scene& scene);
+		// Also plays the Russian roulette of the paths that go on to the next bounce.
+		void Shade(const Scene& scene, int rayDepth);
+		void Connect(const Scene& scene);
+		void Compact();
+
+		void AddRadiance(uint32_t pixelIdx, const numa::Vec3& radiance);
+
+		int sampleCount{1};
+		int rayDepthLimit{5};
+		int russianRouletteDepth{std::numeric_limits<int>::max()};
+		SamplerType samplerType{SamplerType::INDEPENDENT};
+		MisHeuristic misHeuristic{MisHeuristic::POWER};
+
+		PathQueue paths;
+		ShadowRayQueue shadowRays;
+
+		// Per path scratch filled by the extend and shade stages.
+		std::vector<HitRecord> hits;
+		AlignedVector<numa::Vec3> hitPoints;
+		AlignedVector<numa::Vec3> hitNormals;
+		AlignedVector<uint32_t> hitMaterials;
+		AlignedVector<uint8_t> alive;
+		// Path indices sorted by material, so that each material's scattering code runs over a contiguous batch.
+		std::vector<uint32_t> shadeOrder;
+		std::vector<uint32_t> materialOffsets;
+		LightSampleBundle lightBundle;
+
+		// Accumulated radiance of the region's pixels.
+		AlignedVector<float> radianceR;
+		AlignedVector<float> radianceG;
+		AlignedVector<float> radianceB;
+	};
+
+}
\ No newline at end of file
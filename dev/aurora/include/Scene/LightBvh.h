@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Core/Aabb.h"
+#include "Core/AlignedAllocator.h"
+
+#include "Framework/Light.h"
+
+#include "Vec.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace aurora {
+
+	// Conservative description of what a group of lights emits, from which the contribution they can
+	// make to a point is bounded (Conty Estevez and Kulla, "Importance Sampling of Many Lights with
+	// Adaptive Tree Splitting", as refined in pbrt-v4).
+	struct LightBounds {
+		// Estimated contribution to a point 'p' with normal 'N'. 0 only when none of the lights can reach 'p'.
+		float Importance(const numa::Vec3& p, const numa::Vec3& N) const;
+
+		Aabb bounds{};
+		// Emitting directions: every light emits around 'w' within 'cosThetaO', and each point of
+		// a light emits up to 'cosThetaE' away from its own normal.
+		numa::Vec3 w{0.0f, 0.0f, 1.0f};
+		float cosThetaO{1.0f};
+		float cosThetaE{0.0f};
+		// Total emitted power. Groups without any have no bounds either.
+		float phi{0.0f};
+		bool twoSided{false};
+	};
+
+	struct LightBvhNode {
+		LightBounds lightBounds{};
+		// Interior nodes: index of the second child (the first one is always right after its parent).
+		// Leaf nodes: index of the light record.
+		uint32_t childOrLightIdx{0};
+		bool leaf{false};
+	};
+
+	// Binary tree over the bounded lights of a scene, walked down stochastically so that a light is picked
+	// with a probability roughly proportional to its contribution to the shaded point, in O(log L).
+	// Lights without bounds (directional lights) aren't part of the tree, they are handled by the caller.
+	class LightBvh {
+	public:
+		void Build(const AlignedVector<LightRecord>& lightRecords);
+		void Clear();
+
+		// Picks a light for 'p' and 'N' with 'u' (in [0, 1)). Returns 'false' when no light can contribute.
+		bool Sample(const numa::Vec3& p, const numa::Vec3& N, float u, uint32_t& lightIdx, float& pmf) const;
+		// Probability of 'Sample' picking 'lightIdx' at 'p' and 'N'. 0 for the lights that aren't in the tree.
+		float Pmf(const numa::Vec3& p, const numa::Vec3& N, uint32_t lightIdx) const;
+
+		bool Empty() const;
+
+	private:
+		struct BuildLight {
+			uint32_t lightIdx{0};
+			LightBounds lightBounds{};
+		};
+		LightBounds BuildNode(std::vector<BuildLight>& buildLights, uint32_t begin, uint32_t end, uint64_t bitTrail, int depth);
+
+		std::vector<LightBvhNode> nodes;
+		// Path from the root to every light's leaf, one bit per level (set when the second child is taken).
+		std::vector<uint64_t> bitTrails;
+	};
+
+}
\ No newline at end of file
@@ -1,10 +1,22 @@
 #pragma once
 
+#include "Core/AlignedAllocator.h"
+#include "Core/Bvh.h"
+#include "Core/RayPacket.h"
+#include "Core/Sampler.h"
+#include "Core/TaskManager.h"
+#include "Core/WideBvh.h"
+
 #include "Framework/Actor.h"
 #include "Framework/Atmosphere.h"
 #include "Framework/Camera.h"
 #include "Framework/Light.h"
 
+#include "Framework/Components/Material.h"
+
+#include "Scene/LightBvh.h"
+#include "Scene/SphereList.h"
+
 #include "Ray.h"
 #include "Vec.hpp"
 
@@ -19,22 +31,110 @@ namespace aurora {
 		// TODO
 	};
 
+	// Placement of a (possibly shared) geometry in the world.
+	// Instances only reference their geometry, so the memory used by the bottom level
+	// (e.g. mesh triangles and their BVHs) scales with the number of unique geometries.
+	struct GeometryInstance {
+		// Object-to-world frame, rays are moved into object space with its transpose.
+		Frame frame{};
+		Aabb worldBounds{};
+		const Geometry* geometry{nullptr};
+		Actor* actor{nullptr};
+		GeometryType geometryType{};
+		// Spheres and planes: index into the scene's 'SphereList' or 'PlaneArrays'.
+		uint32_t shapeIdx{invalidSceneIdx};
+		uint32_t materialIdx{invalidSceneIdx};
+		uint32_t lightIdx{invalidSceneIdx};
+	};
+
+	// World space planes, frozen by 'Scene::Commit'.
+	// Planes lie in the XY plane of their frame and face 'frame.forward'.
+	struct PlaneArrays {
+		void Clear();
+		uint32_t Add(const Frame& frame, const numa::Vec2& dimensions, uint32_t materialIdx);
+
+		AlignedVector<Frame> frames;
+		// Infinite for unbounded planes.
+		AlignedVector<numa::Vec2> halfExtents;
+		AlignedVector<uint32_t> materialIndices;
+	};
+
+	// How the lights are picked for next event estimation at every path vertex.
+	enum class LightSelection {
+		// Every light, the cost grows with the light count.
+		ALL,
+		// Lights are picked through the light BVH in proportion to their estimated contribution.
+		// Directional lights aren't part of it, they are always sampled.
+		BVH
+	};
+
+	struct LightSamplingSettings {
+		LightSelection selection{LightSelection::BVH};
+		// Lights picked (BVH) or samples per light (ALL) at every vertex.
+		uint32_t sampleCount{1};
+	};
+
 	class Scene {
 	public:
 		Scene(std::string_view sceneName);
 
+		// Must be called after actors have been added, and before rendering.
+		// Freezes the camera, the lights, the materials and the geometry instances into flat arrays and
+		// builds the acceleration structure over them. The rendering queries only read those arrays,
+		// so they never go through the actors' components.
+		// Big builds run on the task manager's workers when one is given. Build timings are written to the log.
+		void Commit(TaskManager* taskManager = nullptr);
+		// Cheaper alternative to 'Commit' when actors have only moved.
+		// Frames are re-read and the top level BVH is refitted.
+		void CommitTransforms();
+
+		// Closest hit query. Traversal only keeps the compact record, 'hit.instanceIdx' tells which instance was hit.
+		bool IntersectClosest(const numa::Ray& ray, HitRecord& hit) const;
+		// Evaluates point, normal, UV and face of a record returned by 'IntersectClosest' with the same ray.
+		void ComputeSurfaceInteraction(const numa::Ray& ray, const HitRecord& hit, ActorRayHit& rayHit) const;
+		// Both of the above at once.
 		bool IntersectClosest(const numa::Ray& ray, ActorRayHit& rayHit) const;
-		bool IntersectLights(const numa::Vec3& p, const numa::Vec3& N, LightSampleBundle& lightBundle) const;
+		// Shadow ray query. Returns as soon as any blocker within (tMin, tMax) is found.
+		bool Occluded(const numa::Ray& ray, float tMin, float tMax) const;
+		// Packet versions of the queries above, for coherent rays (e.g. a row of camera rays, or shadow rays toward one light).
+		// Nodes are culled for the whole packet before the rays are tested one by one.
+		// Returns the mask of the lanes that hit, inactive lanes are left untouched.
+		uint32_t IntersectClosest8(const RayPacket8& packet, HitRecord* hits) const;
+		// 'tMax' holds one entry per lane. Returns the mask of the occluded lanes.
+		uint32_t Occluded8(const RayPacket8& packet, float tMin, const float* tMax) const;
+		// Picks and samples lights for the point 'p' with normal 'N' with the next dimensions of 'sampler'.
+		// The sample pdfs include the probability of picking the light and the sample count, so that the
+		// samples are simply summed. No shadow ray is traced.
+		void SampleLights(const numa::Vec3& p, const numa::Vec3& N, Sampler& sampler, LightSampleBundle& lightBundle) const;
+		// Same as 'SampleLights', but only keeps the unoccluded samples.
+		bool IntersectLights(const numa::Vec3& p, const numa::Vec3& N, Sampler& sampler, LightSampleBundle& lightBundle) const;
+		// The two halves of 'SampleLights' with the BVH selection. Picks one of the lights held by the light BVH and samples
+		// it, the pdf includes the probability of the pick. Returns 'false' when none of them can light 'p'.
+		bool SampleBoundedLight(const numa::Vec3& p, const numa::Vec3& N, Sampler& sampler, LightSampleData& lightSample) const;
+		// Samples the lights the BVH doesn't hold (directional lights), and only keeps the unoccluded samples.
+		bool IntersectUnboundedLights(const numa::Vec3& p, const numa::Vec3& N, Sampler& sampler, LightSampleBundle& lightBundle) const;
+		// Density, in the same measure as the pdfs of 'SampleLights' at 'p' and 'N', of sampling 'lightPoint' on light 'lightIdx'.
+		float LightPdf(const numa::Vec3& p, const numa::Vec3& N, uint32_t lightIdx, const numa::Vec3& lightPoint) const;
 
 		void AddActor(std::shared_ptr<Actor> actor);
 		void AddLight(std::shared_ptr<DirectionalLight> light);
 		void AddLight(std::shared_ptr<AreaLight> light);
 
 		void SetAtmosphere(std::shared_ptr<Atmosphere> atmosphere);
+		void SetBvhBuildSettings(const BvhBuildSettings& buildSettings);
 		void SetCamera(std::shared_ptr<Camera> camera);
+		void SetLightSamplingSettings(const LightSamplingSettings& samplingSettings);
 
 		const std::vector<std::shared_ptr<Actor>>& GetActors() const;
 		const std::vector<std::shared_ptr<Light>>& GetLights() const;
+		const LightSamplingSettings& GetLightSamplingSettings() const;
+
+		// Committed data, see 'Commit'.
+		const AlignedVector<LightRecord>& GetLightRecords() const;
+		const LightRecord& GetLightRecord(uint32_t lightIdx) const;
+		// Returns 'nullptr' for 'invalidSceneIdx'.
+		const Material* GetMaterial(uint32_t materialIdx) const;
+		uint32_t GetMaterialCount() const;
 
 		Atmosphere* GetAtmosphere() const;
 		Camera* GetCamera() const;
@@ -43,15 +143,67 @@ namespace aurora {
 		const std::string& GetSceneName() const;
 
 	private:
+		// Every unique geometry builds its own (bottom level) structure, then the top level is built over the instances.
+		void BuildAccelerationStructure(TaskManager* taskManager);
+		// Cheap enough for the light counts of a scene to be rebuilt instead of refitted.
+		void BuildLightBvh();
+		// Traces the shadow rays of the samples of 'lightBundle' from 'firstSample' on, and removes the occluded ones.
+		bool RemoveOccludedLightSamples(const numa::Vec3& p, Sampler& sampler, LightSampleBundle& lightBundle, size_t firstSample) const;
+
+		bool IntersectInstance(const GeometryInstance& instance, const numa::Ray& ray, float tMax, HitRecord& hit) const;
+		bool OccludedInstance(const GeometryInstance& instance, const numa::Ray& ray, float tMin, float tMax) const;
+		bool IntersectPlane(uint32_t planeIdx, const numa::Ray& ray, float tMax, HitRecord& hit) const;
+		bool OccludedPlane(uint32_t planeIdx, const numa::Ray& ray, float tMin, float tMax) const;
+		// 'hit.primIdx' is the index into the sphere list.
+		void ComputeSphereHit(const GeometryInstance& instance, const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const;
+		void ComputePlaneHit(const GeometryInstance& instance, const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const;
+
 		std::string sceneName;
 
 		std::vector<std::shared_ptr<Actor>> actors;
 		std::vector<std::shared_ptr<Light>> lights;
+
+		// Two level acceleration structure. The instances are ordered by how they are traversed:
+		// - [0, boundedInstanceCount) live in the top level BVH, which indexes them directly,
+		// - the next 'unboundedInstanceCount' (infinite planes) are tested one by one,
+		// - the spheres come last, they are kept apart in their own list and tested in SIMD batches.
+		std::vector<GeometryInstance> instances;
+		uint32_t boundedInstanceCount{0};
+		uint32_t unboundedInstanceCount{0};
+		std::vector<Aabb> instanceBounds;
+		TraversalBvh instanceBvh;
+		BvhBuildSettings bvhBuildSettings{};
+
+		// Committed data.
+		SphereList spheres;
+		PlaneArrays planes;
+		AlignedVector<LightRecord> lightRecords;
+		std::vector<Light*> committedLights;
+		// Rebuilt with the light records, the lights it can't hold are sampled one by one.
+		LightBvh lightBvh;
+		std::vector<uint32_t> unboundedLightIndices;
+		LightSamplingSettings lightSamplingSettings{};
+		std::vector<const Material*> materials;
+		bool dirty{true};
 		
 		std::shared_ptr<Atmosphere> atmosphere;
 		std::shared_ptr<Camera> camera;
 		DirectionalLight* dirLight{nullptr};
-		AreaLight* quadLight{nullptr};
+	};
+
+	// 'Scene::Commit' as a job, so that the jobs rendering the scene can depend on it.
+	// Its acceleration structure builds run on the same task manager.
+	class SceneCommitJob : public Job {
+	public:
+		SceneCommitJob(Scene* scene, TaskManager* taskManager);
+
+		void CreateTasks(std::vector<Task*>& tasks) override;
+		void ExecuteTask(Task& task) override;
+
+	private:
+		Scene* scene{nullptr};
+		TaskManager* taskManager{nullptr};
+		Task commitTask{};
 	};
 
 }	
\ No newline at end of file
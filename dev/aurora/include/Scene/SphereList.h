@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Core/AlignedAllocator.h"
+#include "Core/Bvh.h"
+#include "Core/RayPacket.h"
+#include "Core/WideBvh.h"
+
+#include "Ray.h"
+#include "Vec.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace aurora {
+
+	// World space spheres in a structure of arrays layout, tested 'batchWidth' at a time with SIMD.
+	// 'Build' puts the spheres into a BVH with leaves of at most 'batchWidth' spheres and reorders
+	// the arrays, so that every leaf is a contiguous range the kernel can load straight into registers.
+	// Queries only return the hit distance and the sphere index, hit attributes are left to the caller.
+	class SphereList {
+	public:
+#if defined(__AVX__)
+		static constexpr uint32_t batchWidth{8};
+#elif defined(__SSE__) || defined(_M_X64)
+		static constexpr uint32_t batchWidth{4};
+#else
+		static constexpr uint32_t batchWidth{1};
+#endif
+
+		void Clear();
+		// 'userIdx' is handed back by 'GetUserIdx', since 'Build' changes the order of the spheres.
+		void Add(const numa::Vec3& center, float radius, uint32_t userIdx);
+		void SetCenter(uint32_t sphereIdx, const numa::Vec3& center);
+
+		// Must be called after spheres have been added, and before any query.
+		void Build(const BvhBuildSettings& settings, TaskManager* taskManager);
+		// Updates the BVH after the spheres have moved.
+		void Refit();
+
+		// Same contract as 'Bvh::IntersectClosest', 'tMax' is shrunk to the closest hit.
+		bool IntersectClosest(const numa::Ray& ray, float tMin, float& tMax, uint32_t& sphereIdx) const;
+		bool Occluded(const numa::Ray& ray, float tMin, float tMax) const;
+		// Packet versions, see 'Bvh::IntersectClosest8'. 'tMax' and 'sphereIndices' hold one entry per lane.
+		uint32_t IntersectClosest8(const RayPacket8& packet, float tMin, float* tMax, uint32_t* sphereIndices) const;
+		uint32_t Occluded8(const RayPacket8& packet, float tMin, const float* tMax) const;
+
+		// Tests the ray against the spheres [first, first + count) at once, 'count' is at most 'batchWidth'.
+		bool IntersectBatch(const numa::Ray& ray, uint32_t first, uint32_t count, float tMin, float& tMax, uint32_t& sphereIdx) const;
+		bool OccludedBatch(const numa::Ray& ray, uint32_t first, uint32_t count, float tMin, float tMax) const;
+
+		numa::Vec3 GetCenter(uint32_t sphereIdx) const;
+		float GetRadius(uint32_t sphereIdx) const;
+		uint32_t GetUserIdx(uint32_t sphereIdx) const;
+		uint32_t GetSphereCount() const;
+
+	private:
+		Aabb ComputeSphereBounds(uint32_t sphereIdx) const;
+
+		// After 'Build' the arrays hold 'batchWidth' extra (zero radius) spheres,
+		// so a batch can always load full registers. They are masked out by 'count'.
+		AlignedVector<float> centerX;
+		AlignedVector<float> centerY;
+		AlignedVector<float> centerZ;
+		AlignedVector<float> radius;
+		std::vector<uint32_t> userIndices;
+		uint32_t sphereCount{0};
+
+		TraversalBvh bvh;
+	};
+
+}
\ No newline at end of file
@@ -23,7 +23,6 @@ namespace aurora {
 	}
 
 	void Application::Initialize() {
-		CreateImageWriter();
 		pathTracer = std::make_unique<PathTracer>();
 		sceneManager = std::make_unique<SceneManager>();
 		CreateTaskManager();
@@ -31,47 +30,38 @@ namespace aurora {
 	void Application::Terminate() {
 		sceneManager.reset();
 		pathTracer.reset();
-		imageWriter.reset();
 	}
 
 	void Application::Run() {
 		// CreateDemoScene();
 		CreateQuadLightDemoScene();
 		// 1. Multiple threads
-		// RenderActiveScene(sceneManager->GetActiveScene());
-		// TEST
-		std::shared_ptr<Scene> activeScene = sceneManager->GetActiveScene();
-		pathTracer->RenderSceneLoop(activeScene);
-		pathTracer->ToneMapReinhardtLuminance();
-		pathTracer->GammaCorrectPower12();
-
-		std::string fileName{activeScene->GetSceneName()};
-		fileName.append(".ppm");
-		std::filesystem::path filePath = exePath / fileName;
-		imageWriter->ChangeFileName(filePath.generic_string().c_str());
-		imageWriter->WritePixels(*pathTracer->GetPixelBuffer());
-		// TEST
+		RenderScenes(sceneManager->GetScenes());
 		// 2. Single thread
-		// RenderScene(sceneManager->GetActiveScene());
+		// std::shared_ptr<Scene> activeScene = sceneManager->GetActiveScene();
+		// activeScene->Commit(taskManager.get());
+		// pathTracer->RenderSceneLoop(activeScene);
 	}
 
-	void Application::CreateImageWriter() {
+	std::shared_ptr<PpmImageWriter> Application::CreateImageWriter(std::string_view fileName) const {
+		std::shared_ptr<PpmImageWriter> imageWriter;
 		PpmImageProps ppmImageProps{};
 		ppmImageProps.maxColorValue = 255;
 		ppmImageProps.ppmImageFormat = PpmImageFormat::BINARY;
 		// ppmImageProps.ppmImageFormat = PpmImageFormat::ASCII;
 		if (ppmImageProps.ppmImageFormat == PpmImageFormat::ASCII) {
-			imageWriter = std::make_unique<PpmAsciiImageWriter>(ppmImageProps);
+			imageWriter = std::make_shared<PpmAsciiImageWriter>(ppmImageProps, fileName);
 		} else if (ppmImageProps.ppmImageFormat == PpmImageFormat::BINARY) {
-			imageWriter = std::make_unique<PpmBinaryImageWriter>(ppmImageProps);
+			imageWriter = std::make_shared<PpmBinaryImageWriter>(ppmImageProps, fileName);
 		} else {
 			assert(false && "Unsupported PPM Image Format provided!");
 		}
+		return imageWriter;
 	}
 	void Application::CreateTaskManager() {
-		uint32_t requestedThreadCount{16};
+		// One worker per hardware thread. 'hardware_concurrency' may return 0 when it can't tell.
 		uint32_t physicalCores = std::thread::hardware_concurrency();
-		uint32_t threadCount = std::clamp(requestedThreadCount, uint32_t(1), physicalCores);
+		uint32_t threadCount = std::max(physicalCores, uint32_t(1));
 		// threadCount = 16;
 		// threadCount = 8;
 		// threadCount = 4;
@@ -369,26 +359,30 @@ namespace aurora {
 		sceneManager->SetActiveScene(demoScene);
 	}
 
-	void Application::RenderActiveScene(std::shared_ptr<Scene> scene) {
-		// 1. Create rendering jobs.
-		CreateSceneRenderingJob(scene);
+	void Application::RenderScenes(const std::vector<std::shared_ptr<Scene>>& scenes) {
+		// 1. Create the jobs of every scene, they all go to the task manager at once.
+		//    Each scene is committed, then rendered tile by tile, and every tile is tone mapped, gamma corrected,
+		//    quantized and written as soon as it's rendered. The scenes don't depend on each other, so their jobs overlap.
+		for (const std::shared_ptr<Scene>& scene : scenes) {
+			CreateSceneRenderingJob(scene);
+		}
+		// 2. Run them
 		taskManager->ExecuteAllJobs();
-		// 2. Tone mapping and gamma correction
-		// pathTracer->ToneMapReinhardtRGB();
-		// pathTracer->GammaCorrectPower12();
-		pathTracer->ToneMapReinhardtLuminance();
-		pathTracer->GammaCorrectPower12();
-		// pathTracer->ToneMap2();
-		// 3. Save the image in a file
+	}
+	void Application::CreateSceneRenderingJob(std::shared_ptr<Scene> scene) {
+		std::shared_ptr<SceneCommitJob> sceneCommitJob =
+			std::make_shared<SceneCommitJob>(scene.get(), taskManager.get());
+
 		std::string fileName{scene->GetSceneName()};
 		fileName.append(".ppm");
 		std::filesystem::path filePath = exePath / fileName;
-		imageWriter->ChangeFileName(filePath.generic_string().c_str());
-		imageWriter->WritePixels(*pathTracer->GetPixelBuffer());
-	}
-	void Application::CreateSceneRenderingJob(std::shared_ptr<Scene> scene) {
+
 		std::shared_ptr<SceneRenderingJob> sceneRenderingJob =
-			std::make_unique<SceneRenderingJob>(pathTracer.get(), scene.get());
+			std::make_shared<SceneRenderingJob>(pathTracer.get(), scene.get());
+		sceneRenderingJob->SetImageWriter(CreateImageWriter(filePath.generic_string()));
+		sceneRenderingJob->AddDependency(*sceneCommitJob);
+
+		taskManager->AddJob(sceneCommitJob);
 		taskManager->AddJob(sceneRenderingJob);
 	}
 
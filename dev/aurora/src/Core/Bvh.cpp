@@ -0,0 +1,577 @@
+#include "Core/Bvh.h"
+
+#include "Core/TaskManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace aurora {
+
+	// Primitive data the builders partition. Keeping the bounds next to the index
+	// means the build walks memory sequentially instead of gathering through indices.
+	struct BvhPrimRef {
+		Aabb bounds{};
+		uint32_t primIdx{0};
+		uint32_t mortonCode{0};
+	};
+
+	struct BvhSubtreeTask : Task {
+		uint32_t nodeIdx{0};
+		uint32_t depth{0};
+	};
+
+	struct BvhChunkTask : Task {
+		uint32_t chunkIdx{0};
+	};
+
+	// Calls 'function(chunkIdx)' for every chunk in [0, chunkCount), one task per chunk.
+	// Used for the passes over all the primitives that come before the top-down build.
+	class BvhParallelForJob : public Job {
+	public:
+		BvhParallelForJob(uint32_t chunkCount, const std::function<void(uint32_t)>& function);
+
+		void CreateTasks(std::vector<Task*>& tasks) override;
+		void ExecuteTask(Task& task) override;
+
+	private:
+		std::vector<BvhChunkTask> chunkTasks;
+		const std::function<void(uint32_t)>& function;
+	};
+
+	// Top-down build shared by all the build qualities, only the way a node is split differs.
+	// Every subtree owns a disjoint range of primitive references and allocates its children
+	// from a pre-sized node array, so subtrees can be built concurrently without any locking.
+	// Big subtrees are spawned as tasks of their own, which idle workers steal.
+	class BvhBuildJob : public Job {
+	public:
+		BvhBuildJob(Bvh& bvh, const std::vector<Aabb>& primBounds, bool parallel);
+
+		void CreateTasks(std::vector<Task*>& tasks) override;
+		void ExecuteTask(Task& task) override;
+
+		// Sorts the primitive references along a Morton curve, on the task manager's workers when one is given.
+		void ComputeMortonCodes(TaskManager* taskManager);
+
+		uint32_t GetNodeCount() const;
+		// Writes the final primitive order into 'Bvh::primIndices'.
+		void ResolvePrimIndices();
+
+	private:
+		void BuildSubtree(uint32_t nodeIdx, uint32_t depth);
+		bool SplitNode(uint32_t nodeIdx, uint32_t depth);
+
+		// Each of these reorders the node's primitive references and returns
+		// how many of them go to the left child, 0 means the node should become a leaf.
+		uint32_t PartitionMorton(const BvhNode& node);
+		uint32_t PartitionBinnedSah(const BvhNode& node);
+		uint32_t PartitionSweepSah(const BvhNode& node);
+		uint32_t PartitionMedian(const BvhNode& node);
+
+		void UpdateNodeBounds(uint32_t nodeIdx);
+
+		Bvh& bvh;
+		std::vector<BvhPrimRef> primRefs;
+		bool parallel{false};
+
+		// Only guards the allocation of new tasks, a deque never moves the ones already spawned.
+		std::mutex taskMutex{};
+		std::deque<BvhSubtreeTask> subtreeTasks;
+
+		std::atomic<uint32_t> nodesUsed{1};
+	};
+
+	// Spreads the lower 10 bits of 'v' so that there are two zero bits between each of them.
+	static uint32_t ExpandBits(uint32_t v) {
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	}
+	static uint32_t MortonCode3D(const numa::Vec3& p) {
+		// 'p' is expected in [0, 1]^3, 10 bits per axis.
+		uint32_t x = static_cast<uint32_t>(std::clamp(p.x * 1024.0f, 0.0f, 1023.0f));
+		uint32_t y = static_cast<uint32_t>(std::clamp(p.y * 1024.0f, 0.0f, 1023.0f));
+		uint32_t z = static_cast<uint32_t>(std::clamp(p.z * 1024.0f, 0.0f, 1023.0f));
+		return (ExpandBits(x) << 2) | (ExpandBits(y) << 1) | ExpandBits(z);
+	}
+	static uint32_t HighestSetBit(uint32_t v) {
+		uint32_t bit{0};
+		while (v >>= 1)
+			bit++;
+		return bit;
+	}
+
+	static void ParallelFor(TaskManager* taskManager, uint32_t chunkCount, const std::function<void(uint32_t)>& function) {
+		std::shared_ptr<BvhParallelForJob> job = std::make_shared<BvhParallelForJob>(chunkCount, function);
+		if (taskManager && chunkCount > 1) {
+			taskManager->ExecuteJob(job);
+		} else {
+			job->ExecuteInline();
+		}
+	}
+
+	// BvhParallelForJob
+
+	BvhParallelForJob::BvhParallelForJob(uint32_t chunkCount, const std::function<void(uint32_t)>& function)
+		: chunkTasks(chunkCount), function(function) {
+		for (uint32_t chunkIdx = 0; chunkIdx < chunkCount; chunkIdx++) {
+			chunkTasks[chunkIdx].chunkIdx = chunkIdx;
+		}
+	}
+
+	void BvhParallelForJob::CreateTasks(std::vector<Task*>& tasks) {
+		for (BvhChunkTask& chunkTask : chunkTasks) {
+			tasks.push_back(&chunkTask);
+		}
+	}
+	void BvhParallelForJob::ExecuteTask(Task& task) {
+		function(static_cast<BvhChunkTask&>(task).chunkIdx);
+	}
+
+	// BvhBuildJob
+
+	BvhBuildJob::BvhBuildJob(Bvh& bvh, const std::vector<Aabb>& primBounds, bool parallel)
+		: bvh(bvh), parallel(parallel) {
+		primRefs.resize(primBounds.size());
+		for (size_t i = 0; i < primBounds.size(); i++) {
+			primRefs[i].bounds = primBounds[i];
+			primRefs[i].primIdx = static_cast<uint32_t>(i);
+		}
+	}
+
+	void BvhBuildJob::CreateTasks(std::vector<Task*>& tasks) {
+		// The root is the only initial task, the rest is discovered while splitting.
+		subtreeTasks.emplace_back();
+		tasks.push_back(&subtreeTasks.back());
+	}
+	void BvhBuildJob::ExecuteTask(Task& task) {
+		const BvhSubtreeTask& subtreeTask = static_cast<BvhSubtreeTask&>(task);
+		BuildSubtree(subtreeTask.nodeIdx, subtreeTask.depth);
+	}
+
+	void BvhBuildJob::ComputeMortonCodes(TaskManager* taskManager) {
+		static constexpr uint32_t chunkSize{16384};
+		static constexpr uint32_t mortonCodeBits{30};
+		static constexpr uint32_t radixBits{8};
+		static constexpr uint32_t radixSize{1u << radixBits};
+
+		uint32_t primCount = static_cast<uint32_t>(primRefs.size());
+		uint32_t chunkCount = (primCount + chunkSize - 1) / chunkSize;
+		auto chunkBegin = [](uint32_t chunkIdx) {
+			return chunkIdx * chunkSize;
+		};
+		auto chunkEnd = [primCount](uint32_t chunkIdx) {
+			return std::min(primCount, (chunkIdx + 1) * chunkSize);
+		};
+
+		std::vector<Aabb> chunkBounds(chunkCount);
+		ParallelFor(taskManager, chunkCount, [&](uint32_t chunkIdx) {
+			for (uint32_t i = chunkBegin(chunkIdx); i < chunkEnd(chunkIdx); i++) {
+				chunkBounds[chunkIdx].Grow(primRefs[i].bounds.Centroid());
+			}
+			});
+		Aabb centroidBounds{};
+		for (const Aabb& bounds : chunkBounds) {
+			centroidBounds.Grow(bounds);
+		}
+		numa::Vec3 extent = centroidBounds.Extent();
+		numa::Vec3 invExtent{
+			extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+			extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+			extent.z > 0.0f ? 1.0f / extent.z : 0.0f
+		};
+		ParallelFor(taskManager, chunkCount, [&](uint32_t chunkIdx) {
+			for (uint32_t i = chunkBegin(chunkIdx); i < chunkEnd(chunkIdx); i++) {
+				primRefs[i].mortonCode = MortonCode3D((primRefs[i].bounds.Centroid() - centroidBounds.min) * invExtent);
+			}
+			});
+
+		// LSD radix sort, one digit per pass. Every chunk counts its digits, then scatters its references
+		// to the slots the prefix sum gave it. Each pass is stable, so references with the same code
+		// stay in 'primIdx' order (the order they start in) and the result doesn't depend on the chunking.
+		std::vector<BvhPrimRef> sortedRefs(primCount);
+		std::vector<uint32_t> offsets(static_cast<size_t>(chunkCount) * radixSize);
+		for (uint32_t shift = 0; shift < mortonCodeBits; shift += radixBits) {
+			std::fill(offsets.begin(), offsets.end(), 0);
+			ParallelFor(taskManager, chunkCount, [&](uint32_t chunkIdx) {
+				uint32_t* chunkOffsets = &offsets[static_cast<size_t>(chunkIdx) * radixSize];
+				for (uint32_t i = chunkBegin(chunkIdx); i < chunkEnd(chunkIdx); i++) {
+					chunkOffsets[(primRefs[i].mortonCode >> shift) & (radixSize - 1)]++;
+				}
+				});
+			// Digit major, so that the chunks of a digit fill its range in order.
+			uint32_t offset{0};
+			for (uint32_t digit = 0; digit < radixSize; digit++) {
+				for (uint32_t chunkIdx = 0; chunkIdx < chunkCount; chunkIdx++) {
+					uint32_t& chunkOffset = offsets[static_cast<size_t>(chunkIdx) * radixSize + digit];
+					uint32_t count = chunkOffset;
+					chunkOffset = offset;
+					offset += count;
+				}
+			}
+			ParallelFor(taskManager, chunkCount, [&](uint32_t chunkIdx) {
+				uint32_t* chunkOffsets = &offsets[static_cast<size_t>(chunkIdx) * radixSize];
+				for (uint32_t i = chunkBegin(chunkIdx); i < chunkEnd(chunkIdx); i++) {
+					sortedRefs[chunkOffsets[(primRefs[i].mortonCode >> shift) & (radixSize - 1)]++] = primRefs[i];
+				}
+				});
+			primRefs.swap(sortedRefs);
+		}
+	}
+
+	uint32_t BvhBuildJob::GetNodeCount() const {
+		return nodesUsed.load();
+	}
+	void BvhBuildJob::ResolvePrimIndices() {
+		for (size_t i = 0; i < primRefs.size(); i++) {
+			bvh.primIndices[i] = primRefs[i].primIdx;
+		}
+	}
+
+	void BvhBuildJob::BuildSubtree(uint32_t nodeIdx, uint32_t depth) {
+		std::vector<std::pair<uint32_t, uint32_t>> stack{{nodeIdx, depth}};
+		while (!stack.empty()) {
+			auto [currentIdx, currentDepth] = stack.back();
+			stack.pop_back();
+			if (!SplitNode(currentIdx, currentDepth))
+				continue;
+			uint32_t leftIdx = bvh.nodes[currentIdx].leftFirst;
+			for (uint32_t childIdx : {leftIdx + 1, leftIdx}) {
+				if (parallel && bvh.nodes[childIdx].primCount >= bvh.settings.parallelThreshold) {
+					BvhSubtreeTask* subtreeTask{nullptr};
+					{
+						std::lock_guard<std::mutex> lock{taskMutex};
+						subtreeTask = &subtreeTasks.emplace_back();
+					}
+					subtreeTask->nodeIdx = childIdx;
+					subtreeTask->depth = currentDepth + 1;
+					Spawn(subtreeTask);
+				} else {
+					stack.emplace_back(childIdx, currentDepth + 1);
+				}
+			}
+		}
+	}
+	bool BvhBuildJob::SplitNode(uint32_t nodeIdx, uint32_t depth) {
+		// Object median splits halve the primitive count, so any node gets down to single primitives
+		// within 32 of them. Deep enough nodes only use those, which keeps the tree within 'Bvh::maxDepth'
+		// levels however skewed the primitives are (the SAH alone can peel them off one at a time).
+		static_assert(Bvh::maxDepth > 32, "The traversal stack is too small for the median split fallback!");
+		static constexpr uint32_t medianDepth{Bvh::maxDepth - 32};
+
+		const BvhNode node = bvh.nodes[nodeIdx];
+		if (node.primCount <= 1)
+			return false;
+		assert(depth < Bvh::maxDepth && "BVH is deeper than the traversal stack allows!");
+
+		uint32_t leftCount{0};
+		if (depth >= medianDepth) {
+			if (node.primCount <= bvh.settings.maxLeafSize)
+				return false;
+			leftCount = PartitionMedian(node);
+		} else {
+			switch (bvh.settings.quality) {
+			case BvhBuildQuality::FAST:
+				leftCount = PartitionMorton(node);
+				break;
+			case BvhBuildQuality::MEDIUM:
+				// With no more primitives than bins, the full sweep is exact and cheaper than setting the bins up.
+				if (node.primCount <= bvh.settings.binCount)
+					leftCount = PartitionSweepSah(node);
+				else
+					leftCount = PartitionBinnedSah(node);
+				break;
+			case BvhBuildQuality::HIGH:
+				leftCount = PartitionSweepSah(node);
+				break;
+			}
+			if (leftCount == 0) {
+				if (node.primCount <= bvh.settings.maxLeafSize)
+					return false;
+				// Splitting doesn't pay off according to the SAH (e.g. all the centroids coincide),
+				// but the leaf is too big. Fall back to the object median along the longest axis.
+				leftCount = PartitionMedian(node);
+			}
+		}
+
+		uint32_t leftIdx = nodesUsed.fetch_add(2);
+		BvhNode& leftChild = bvh.nodes[leftIdx];
+		leftChild.leftFirst = node.leftFirst;
+		leftChild.primCount = leftCount;
+		BvhNode& rightChild = bvh.nodes[leftIdx + 1];
+		rightChild.leftFirst = node.leftFirst + leftCount;
+		rightChild.primCount = node.primCount - leftCount;
+		UpdateNodeBounds(leftIdx);
+		UpdateNodeBounds(leftIdx + 1);
+
+		bvh.nodes[nodeIdx].leftFirst = leftIdx;
+		bvh.nodes[nodeIdx].primCount = 0;
+		return true;
+	}
+
+	uint32_t BvhBuildJob::PartitionMorton(const BvhNode& node) {
+		if (node.primCount <= bvh.settings.maxLeafSize)
+			return 0;
+		// The references are already sorted by their Morton codes, so splitting
+		// at the highest bit that differs within the range is a binary search.
+		auto begin = primRefs.begin() + node.leftFirst;
+		auto end = begin + node.primCount;
+		uint32_t firstCode = begin->mortonCode;
+		uint32_t lastCode = (end - 1)->mortonCode;
+		if (firstCode == lastCode)
+			return node.primCount / 2;
+		uint32_t splitBit = 1u << HighestSetBit(firstCode ^ lastCode);
+		auto split = std::partition_point(begin, end, [splitBit](const BvhPrimRef& primRef) {
+			return (primRef.mortonCode & splitBit) == 0;
+			});
+		return static_cast<uint32_t>(split - begin);
+	}
+	uint32_t BvhBuildJob::PartitionBinnedSah(const BvhNode& node) {
+		static constexpr uint32_t maxBinCount{32};
+		struct Bin {
+			Aabb bounds{};
+			uint32_t primCount{0};
+		};
+
+		float parentArea = node.bounds.SurfaceArea();
+		if (parentArea <= 0.0f)
+			return 0;
+
+		auto begin = primRefs.begin() + node.leftFirst;
+		auto end = begin + node.primCount;
+		Aabb centroidBounds{};
+		for (auto it = begin; it != end; ++it) {
+			centroidBounds.Grow(it->bounds.Centroid());
+		}
+
+		const uint32_t binCount = std::clamp(bvh.settings.binCount, 2u, maxBinCount);
+		numa::Vec3 centroidExtent = centroidBounds.Extent();
+		numa::Vec3 scale{
+			centroidExtent.x > 0.0f ? binCount / centroidExtent.x : 0.0f,
+			centroidExtent.y > 0.0f ? binCount / centroidExtent.y : 0.0f,
+			centroidExtent.z > 0.0f ? binCount / centroidExtent.z : 0.0f
+		};
+		// All three axes are binned in a single pass, the primitive data is touched only once.
+		Bin bins[3][maxBinCount]{};
+		for (auto it = begin; it != end; ++it) {
+			numa::Vec3 binPosition = (it->bounds.Centroid() - centroidBounds.min) * scale;
+			const Aabb& bounds = it->bounds;
+			for (int axis = 0; axis < 3; axis++) {
+				uint32_t binIdx = std::min(binCount - 1, static_cast<uint32_t>(GetAxisValue(binPosition, axis)));
+				bins[axis][binIdx].primCount++;
+				bins[axis][binIdx].bounds.Grow(bounds);
+			}
+		}
+
+		float bestCost = bvh.settings.intersectionCost * node.primCount;
+		int bestAxis{-1};
+		uint32_t bestBin{0};
+		for (int axis = 0; axis < 3; axis++) {
+			if (GetAxisValue(scale, axis) <= 0.0f)
+				continue;
+
+			// Sweep from the right, storing the area and the count of every right-hand side partition.
+			float rightAreas[maxBinCount]{};
+			uint32_t rightCounts[maxBinCount]{};
+			Aabb rightBounds{};
+			uint32_t rightCount{0};
+			for (uint32_t i = binCount - 1; i > 0; i--) {
+				rightBounds.Grow(bins[axis][i].bounds);
+				rightCount += bins[axis][i].primCount;
+				rightAreas[i] = rightBounds.SurfaceArea();
+				rightCounts[i] = rightCount;
+			}
+			// Sweep from the left, evaluating the cost of splitting in front of every bin.
+			Aabb leftBounds{};
+			uint32_t leftCount{0};
+			for (uint32_t i = 1; i < binCount; i++) {
+				leftBounds.Grow(bins[axis][i - 1].bounds);
+				leftCount += bins[axis][i - 1].primCount;
+				if (leftCount == 0 || rightCounts[i] == 0)
+					continue;
+				float cost =
+					bvh.settings.traversalCost +
+					bvh.settings.intersectionCost *
+					(leftBounds.SurfaceArea() * leftCount + rightAreas[i] * rightCounts[i]) / parentArea;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = i;
+				}
+			}
+		}
+		if (bestAxis < 0)
+			return 0;
+
+		float axisMin = GetAxisValue(centroidBounds.min, bestAxis);
+		float axisScale = GetAxisValue(scale, bestAxis);
+		auto split = std::partition(begin, end, [&](const BvhPrimRef& primRef) {
+			uint32_t binIdx = std::min(binCount - 1, static_cast<uint32_t>((GetAxisValue(primRef.bounds.Centroid(), bestAxis) - axisMin) * axisScale));
+			return binIdx < bestBin;
+			});
+		return static_cast<uint32_t>(split - begin);
+	}
+	uint32_t BvhBuildJob::PartitionSweepSah(const BvhNode& node) {
+		// Full SAH sweep: along every axis the primitives are sorted by their centroids
+		// and every one of the 'N - 1' partitions is evaluated.
+		float parentArea = node.bounds.SurfaceArea();
+		if (parentArea <= 0.0f)
+			return 0;
+
+		// Scratch storage, one per thread.
+		thread_local std::vector<BvhPrimRef> sortedRefs;
+		thread_local std::vector<float> rightAreas;
+		sortedRefs.resize(node.primCount);
+		rightAreas.resize(node.primCount);
+
+		auto primBegin = primRefs.begin() + node.leftFirst;
+		auto primEnd = primBegin + node.primCount;
+		auto sortByAxis = [](int axis) {
+			return [axis](const BvhPrimRef& lhs, const BvhPrimRef& rhs) {
+				float lhsValue = GetAxisValue(lhs.bounds.Centroid(), axis);
+				float rhsValue = GetAxisValue(rhs.bounds.Centroid(), axis);
+				return lhsValue < rhsValue || (lhsValue == rhsValue && lhs.primIdx < rhs.primIdx);
+			};
+		};
+
+		float bestCost = bvh.settings.intersectionCost * node.primCount;
+		int bestAxis{-1};
+		uint32_t bestLeftCount{0};
+		for (int axis = 0; axis < 3; axis++) {
+			std::copy(primBegin, primEnd, sortedRefs.begin());
+			std::sort(sortedRefs.begin(), sortedRefs.end(), sortByAxis(axis));
+
+			// Sweep from the right, storing the area of every right-hand side partition.
+			Aabb rightBounds{};
+			for (uint32_t i = node.primCount - 1; i > 0; i--) {
+				rightBounds.Grow(sortedRefs[i].bounds);
+				rightAreas[i] = rightBounds.SurfaceArea();
+			}
+			// Sweep from the left, evaluating the cost of every partition.
+			Aabb leftBounds{};
+			for (uint32_t i = 0; i < node.primCount - 1; i++) {
+				leftBounds.Grow(sortedRefs[i].bounds);
+				uint32_t leftCount = i + 1;
+				uint32_t rightCount = node.primCount - leftCount;
+				float cost =
+					bvh.settings.traversalCost +
+					bvh.settings.intersectionCost *
+					(leftBounds.SurfaceArea() * leftCount + rightAreas[i + 1] * rightCount) / parentArea;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestLeftCount = leftCount;
+				}
+			}
+		}
+		if (bestAxis < 0)
+			return 0;
+		std::sort(primBegin, primEnd, sortByAxis(bestAxis));
+		return bestLeftCount;
+	}
+	uint32_t BvhBuildJob::PartitionMedian(const BvhNode& node) {
+		auto begin = primRefs.begin() + node.leftFirst;
+		auto end = begin + node.primCount;
+		Aabb centroidBounds{};
+		for (auto it = begin; it != end; ++it) {
+			centroidBounds.Grow(it->bounds.Centroid());
+		}
+		int axis = centroidBounds.LongestAxis();
+		uint32_t leftCount = node.primCount / 2;
+		std::nth_element(begin, begin + leftCount, end, [axis](const BvhPrimRef& lhs, const BvhPrimRef& rhs) {
+			float lhsValue = GetAxisValue(lhs.bounds.Centroid(), axis);
+			float rhsValue = GetAxisValue(rhs.bounds.Centroid(), axis);
+			return lhsValue < rhsValue || (lhsValue == rhsValue && lhs.primIdx < rhs.primIdx);
+			});
+		return leftCount;
+	}
+
+	void BvhBuildJob::UpdateNodeBounds(uint32_t nodeIdx) {
+		BvhNode& node = bvh.nodes[nodeIdx];
+		node.bounds = Aabb{};
+		for (uint32_t i = 0; i < node.primCount; i++) {
+			node.bounds.Grow(primRefs[node.leftFirst + i].bounds);
+		}
+	}
+
+	// Bvh
+
+	void Bvh::Build(const std::vector<Aabb>& primBounds, const BvhBuildSettings& settings, TaskManager* taskManager) {
+		Clear();
+		this->settings = settings;
+
+		uint32_t primCount = static_cast<uint32_t>(primBounds.size());
+		if (primCount == 0)
+			return;
+
+		primIndices.resize(primCount);
+
+		// A binary tree with N leaves never has more than 2N - 1 nodes.
+		// The array is sized up front, so that concurrent subtree builds never see it reallocate.
+		nodes.resize(2 * static_cast<size_t>(primCount) - 1);
+		BvhNode& root = nodes[0];
+		root.leftFirst = 0;
+		root.primCount = primCount;
+		for (const Aabb& bounds : primBounds) {
+			root.bounds.Grow(bounds);
+		}
+
+		// Going through the task manager isn't worth it for small builds.
+		bool parallel = taskManager && primCount >= settings.parallelThreshold;
+		std::shared_ptr<BvhBuildJob> buildJob = std::make_shared<BvhBuildJob>(*this, primBounds, parallel);
+		if (settings.quality == BvhBuildQuality::FAST) {
+			buildJob->ComputeMortonCodes(parallel ? taskManager : nullptr);
+		}
+		if (parallel) {
+			taskManager->ExecuteJob(buildJob);
+		} else {
+			buildJob->ExecuteInline();
+		}
+		nodes.resize(buildJob->GetNodeCount());
+		buildJob->ResolvePrimIndices();
+	}
+	void Bvh::Refit(const std::vector<Aabb>& primBounds) {
+		// Children are always stored after their parent, so a reverse sweep visits them first.
+		for (size_t i = nodes.size(); i > 0; i--) {
+			BvhNode& node = nodes[i - 1];
+			node.bounds = Aabb{};
+			if (node.IsLeaf()) {
+				for (uint32_t p = 0; p < node.primCount; p++) {
+					node.bounds.Grow(primBounds[primIndices[node.leftFirst + p]]);
+				}
+			} else {
+				node.bounds.Grow(nodes[node.leftFirst].bounds);
+				node.bounds.Grow(nodes[node.leftFirst + 1].bounds);
+			}
+		}
+	}
+	void Bvh::Clear() {
+		nodes.clear();
+		primIndices.clear();
+	}
+
+	bool Bvh::Empty() const {
+		return nodes.empty();
+	}
+
+	const Aabb& Bvh::GetBounds() const {
+		static const Aabb emptyBounds{};
+		if (nodes.empty())
+			return emptyBounds;
+		return nodes[0].bounds;
+	}
+	const std::vector<BvhNode>& Bvh::GetNodes() const {
+		return nodes;
+	}
+	const std::vector<uint32_t>& Bvh::GetPrimIndices() const {
+		return primIndices;
+	}
+
+}
\ No newline at end of file
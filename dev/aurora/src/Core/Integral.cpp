@@ -9,7 +9,12 @@
 
 namespace aurora
 {
-	bool ReimannSumJob::DoWork()
+	void ReimannSumJob::CreateTasks(std::vector<Task*>& tasks)
+	{
+		tasks.push_back(&sumTask);
+	}
+
+	void ReimannSumJob::ExecuteTask(Task&)
 	{
 		using namespace std::placeholders;
 
@@ -34,7 +39,6 @@ namespace aurora
 			return 0.5f * x + 1.5f * y + z * z;
 		};
 
-		float result{ 0.0f };
 		for (float z = z0; z < z1; z += dz)
 		{
 			for (float y = y0; y < y1; y += dy)
@@ -45,8 +49,6 @@ namespace aurora
 				}
 			}
 		}
-
-		return result;
 	}
 
 	void ReimannSumJob::OnStart()
@@ -3,11 +3,17 @@
 #include "Renderer/PathTracer.h"
 #include "Scene/Scene.h"
 
+#include <cassert>
 #include <iostream>
 
 namespace aurora {
 
-	// RenderingJob class
+	// Worker running on the calling thread, if any.
+	static thread_local Worker* currentWorker{nullptr};
+	// Where the calling thread's next steal attempt starts, so that thieves don't all go after the same victim.
+	static thread_local uint32_t stealSeed{0};
+
+	// Job class
 
 	void Job::Start() {
 		executed = true;
@@ -15,7 +21,10 @@ namespace aurora {
 	}
 	void Job::End() {
 		executed = false;
+		// Set under the lock, so that a thread in 'Wait' can't miss the notification.
+		std::lock_guard<std::mutex> lock{finishMutex};
 		finished = true;
+		finishCondition.notify_all();
 	}
 
 	bool Job::Started() {
@@ -31,171 +40,290 @@ namespace aurora {
 	void Job::Reset() {
 		executed = false;
 		finished = false;
+		pendingTasks = 0;
+		dependentsReleased = false;
 	}
 
-	// RenderingWorker class
-
-	void Worker::Start()
-	{
-		this->running = true;
+	void Job::ExecuteInline() {
+		taskManager = nullptr;
+		Start();
+		OnStart();
+		std::vector<Task*> tasks;
+		CreateTasks(tasks);
+		// Tasks are taken from the back, run the initial ones in the order they were created.
+		inlineTasks.assign(tasks.rbegin(), tasks.rend());
+		while (!inlineTasks.empty()) {
+			Task* task = inlineTasks.back();
+			inlineTasks.pop_back();
+			task->job = this;
+			ExecuteTask(*task);
+		}
+		OnEnd();
+		End();
+	}
 
-		std::thread thread{ &Worker::StartImpl, this };
-		execThread = std::move(thread);
+	void Job::Wait() {
+		std::unique_lock<std::mutex> lock{finishMutex};
+		finishCondition.wait(lock, [this]() { return finished.load(); });
 	}
-	void Worker::Stop()
-	{
-		this->running = false;
-		this->executing = false;
+
+	void Job::AddDependency(Job& dependency) {
+		std::lock_guard<std::mutex> lock{dependency.finishMutex};
+		if (dependency.dependentsReleased)
+			return;
+		dependency.dependents.push_back(this);
+		unfinishedDependencies++;
 	}
-	void Worker::Wait()
-	{
-		if (execThread.joinable())
-			execThread.join();
+
+	void Job::Spawn(Task* task) {
+		task->job = this;
+		if (!taskManager) {
+			inlineTasks.push_back(task);
+			return;
+		}
+		// The spawning task is still pending, so the job can't finish in between.
+		pendingTasks.fetch_add(1, std::memory_order_relaxed);
+		taskManager->Schedule(task);
 	}
-	void Worker::Detach()
-	{
-		if (execThread.joinable())
-			execThread.detach();
+	bool Job::HasIdleWorkers() const {
+		return taskManager && taskManager->parkedWorkers.load(std::memory_order_relaxed) > 0;
 	}
 
-	void Worker::SetJob(Job* job)
-	{
-		std::lock_guard<std::mutex> lock{ jobMutex };
-		this->job = job;
+	// Worker class
+
+	Worker::Worker(TaskManager& taskManager, uint32_t workerIdx)
+		: taskManager(taskManager), workerIdx(workerIdx) {
 	}
 
-	void Worker::RemoveJob()
-	{
-		std::lock_guard<std::mutex> lock{ jobMutex };
-		this->job = nullptr;
+	void Worker::Start() {
+		running = true;
+		execThread = std::thread{&Worker::StartImpl, this};
+	}
+	void Worker::Stop() {
+		running = false;
+	}
+	void Worker::Wait() {
+		if (execThread.joinable())
+			execThread.join();
 	}
 
-	bool Worker::Running() const
-	{
-		return running;
+	void Worker::Push(Task* task) {
+		tasks.Push(task);
+	}
+	bool Worker::Pop(Task*& task) {
+		return tasks.Pop(task);
 	}
-	bool Worker::Executing() const
-	{
-		return executing;
+	bool Worker::Steal(Task*& task) {
+		return tasks.Steal(task);
 	}
 
-	void Worker::StartImpl()
-	{
-		using namespace std::chrono_literals;
+	bool Worker::Running() const {
+		return running;
+	}
 
-		while (running)
-		{
-			bool workDone{ false };
-
-			// 1. 
-			/*
-			jobMutex.lock();
-			while (job && !job->Finished())
-			{
-				executing = true;
-				workDone = job->DoWork();
-				executing = false;
+	void Worker::StartImpl() {
+		currentWorker = this;
+		stealSeed = workerIdx + 1;
+		while (running) {
+			// Read before looking for work, see 'TaskManager::Park'.
+			uint64_t epoch = taskManager.workEpoch.load();
+			if (Task* task = taskManager.FindTask(this)) {
+				taskManager.ExecuteTask(task);
+				continue;
 			}
-			jobMutex.unlock();
-			*/
-
-			// 2. 
-			jobMutex.lock();
-			if (job)
-			{
-				executing = true;
-				workDone = job->DoWork();
-				executing = false;
-			}
-			jobMutex.unlock();
-
-			// The wait affects the start and finish times!
-			/*
-			if (!workDone)
-				std::this_thread::sleep_for(1000ms); // 1s.
-			*/
+			taskManager.Park(epoch);
 		}
+		currentWorker = nullptr;
 	}
 
 	// TaskManager class
 
+	TaskManager::~TaskManager() {
+		TerminateWorkers();
+	}
+
 	void TaskManager::InitializeWorkers(uint32_t threadCount) {
+		TerminateWorkers();
 		workers.resize(threadCount);
 		for (uint32_t i = 0; i < threadCount; i++) {
-			workers[i] = std::make_unique<Worker>();
+			workers[i] = std::make_unique<Worker>(*this, i);
 		}
-	}
-
-	void TaskManager::AddJob(std::shared_ptr<Job> job) {
-		jobs.push(job);
-	}
-
-	void TaskManager::ExecuteTopJob() {
-		if (jobs.empty())
-			return;
-		std::shared_ptr<Job> job = jobs.top();
-		job->Start();
-		job->OnStart();
+		// Every worker must exist before any of them starts stealing.
 		for (auto& worker : workers) {
 			worker->Start();
-			worker->SetJob(job.get());
 		}
+	}
+	void TaskManager::TerminateWorkers() {
+		if (workers.empty())
+			return;
 		for (auto& worker : workers) {
 			worker->Stop();
+		}
+		{
+			std::lock_guard<std::mutex> lock{parkMutex};
+			stopping = true;
+		}
+		parkCondition.notify_all();
+		for (auto& worker : workers) {
 			worker->Wait();
-			// worker->Detach();
 		}
-		job->OnEnd();
-		jobs.pop();
+		workers.clear();
+		stopping = false;
 	}
-	void TaskManager::ExecuteAllJobs()
-	{
-		if (jobs.empty())
-			return;
 
-		for (auto& worker : workers)
-		{
-			worker->Start();
+	void TaskManager::AddJob(std::shared_ptr<Job> job) {
+		jobs.push_back(job);
+	}
+
+	void TaskManager::ExecuteAllJobs() {
+		// The others are submitted by 'FinishJob' when their last dependency is done. The roots are found before
+		// anything is submitted, a job whose dependencies finish in the meantime must not be submitted twice.
+		std::vector<Job*> rootJobs;
+		for (auto& job : jobs) {
+			if (job->unfinishedDependencies == 0)
+				rootJobs.push_back(job.get());
+		}
+		for (Job* job : rootJobs) {
+			Submit(*job);
 		}
+		Worker* worker = GetCurrentWorker();
+		for (auto& job : jobs) {
+			if (workers.empty()) {
+				// Nobody else would run the tasks.
+				while (!job->Finished()) {
+					Task* task = FindTask(worker);
+					assert(task && "Job dependency cycle!");
+					ExecuteTask(task);
+				}
+			}
+			job->Wait();
+		}
+		jobs.clear();
+	}
+	void TaskManager::ExecuteJob(std::shared_ptr<Job> job) {
+		Submit(*job);
+		Worker* worker = GetCurrentWorker();
+		while (!job->Finished()) {
+			if (Task* task = FindTask(worker)) {
+				ExecuteTask(task);
+			} else {
+				// Whatever is left is already running on the workers.
+				job->Wait();
+			}
+		}
+	}
 
-		while (!jobs.empty())
+	void TaskManager::Submit(Job& job) {
+		job.taskManager = this;
+		job.Start();
+		job.OnStart();
+		std::vector<Task*> tasks;
+		job.CreateTasks(tasks);
+		if (tasks.empty()) {
+			FinishJob(job);
+			return;
+		}
+		job.pendingTasks = static_cast<uint32_t>(tasks.size());
 		{
-			std::shared_ptr<Job> job = jobs.top();
-			job->Start();
-			job->OnStart();
-
-			// 1. Send the job
-
-			for (auto& worker : workers)
-			{
-				worker->SetJob(job.get());
+			std::lock_guard<std::mutex> lock{submissionMutex};
+			for (Task* task : tasks) {
+				task->job = &job;
+				submittedTasks.push_back(task);
 			}
+			submittedTaskCount += static_cast<uint32_t>(tasks.size());
+		}
+		WakeWorkers(true);
+	}
 
-			// 2. Stall, periodically checking if the job's done
+	uint32_t TaskManager::GetWorkerCount() const {
+		return static_cast<uint32_t>(workers.size());
+	}
 
-			using namespace std::chrono_literals;
-			while (!job->Finished())
-			{
-				std::this_thread::sleep_for(1000ms); // 1s.
-			}
+	Worker* TaskManager::GetCurrentWorker() const {
+		return currentWorker && &currentWorker->taskManager == this ? currentWorker : nullptr;
+	}
 
-			// 3. Remove the job
+	void TaskManager::Schedule(Task* task) {
+		if (Worker* worker = GetCurrentWorker()) {
+			worker->Push(task);
+		} else {
+			std::lock_guard<std::mutex> lock{submissionMutex};
+			submittedTasks.push_back(task);
+			submittedTaskCount++;
+		}
+		WakeWorkers(false);
+	}
 
-			for (auto& worker : workers)
-			{
-				worker->RemoveJob();
+	Task* TaskManager::FindTask(Worker* worker) {
+		Task* task{nullptr};
+		// 1. Own work, newest first.
+		if (worker && worker->Pop(task))
+			return task;
+		// 2. Submitted work, oldest first.
+		if (submittedTaskCount.load(std::memory_order_acquire) > 0) {
+			std::lock_guard<std::mutex> lock{submissionMutex};
+			if (!submittedTasks.empty()) {
+				task = submittedTasks.front();
+				submittedTasks.pop_front();
+				submittedTaskCount--;
+				return task;
 			}
-
-			job->OnEnd();
-			jobs.pop();
 		}
+		// 3. Someone else's work, oldest first.
+		uint32_t workerCount = static_cast<uint32_t>(workers.size());
+		uint32_t start = stealSeed++;
+		for (uint32_t i = 0; i < workerCount; i++) {
+			Worker* victim = workers[(start + i) % workerCount].get();
+			if (victim != worker && victim->Steal(task))
+				return task;
+		}
+		return nullptr;
+	}
+
+	void TaskManager::ExecuteTask(Task* task) {
+		Job& job = *task->job;
+		job.ExecuteTask(*task);
+		if (job.pendingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			FinishJob(job);
+	}
 
-		for (auto& worker : workers)
+	void TaskManager::FinishJob(Job& job) {
+		job.OnEnd();
+		std::vector<Job*> dependents;
 		{
-			worker->Stop();
-			worker->Wait();
-			// worker->Detach();
+			std::lock_guard<std::mutex> lock{job.finishMutex};
+			dependents.swap(job.dependents);
+			job.dependentsReleased = true;
+		}
+		// Last access to the job, whoever waits on it may release it right after.
+		job.End();
+		for (Job* dependent : dependents) {
+			if (dependent->unfinishedDependencies.fetch_sub(1) == 1)
+				Submit(*dependent);
 		}
 	}
 
+	void TaskManager::WakeWorkers(bool all) {
+		workEpoch.fetch_add(1);
+		if (parkedWorkers.load() == 0)
+			return;
+		std::lock_guard<std::mutex> lock{parkMutex};
+		if (all) {
+			parkCondition.notify_all();
+		} else {
+			parkCondition.notify_one();
+		}
+	}
+
+	void TaskManager::Park(uint64_t seenEpoch) {
+		// 'WakeWorkers' bumps the epoch before reading 'parkedWorkers', and this reads the epoch after
+		// incrementing 'parkedWorkers', so at least one of the two sides sees the other.
+		std::unique_lock<std::mutex> lock{parkMutex};
+		parkedWorkers++;
+		parkCondition.wait(lock, [this, seenEpoch]() {
+			return workEpoch.load() != seenEpoch || stopping;
+		});
+		parkedWorkers--;
+	}
+
 }
\ No newline at end of file
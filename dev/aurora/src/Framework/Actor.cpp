@@ -1,6 +1,7 @@
 #include "Framework/Actor.h"
 
 #include "Framework/Components/Geometry.h"
+#include "Framework/Components/Transform.h"
 
 namespace aurora {
 
@@ -15,11 +16,24 @@ namespace aurora {
 			rayHit.hitActor = nullptr;
 			return false;
 		}
-		rayHit.hit = geometry->Intersect(ray, rayHit);
+		rayHit.hit = geometry->Intersect(ray, GetFrame(), rayHit);
 		if (rayHit.hit) {
 			rayHit.hitActor = this;
 		}
 		return rayHit.hit;
 	}
+	bool Actor::Occluded(const numa::Ray& ray, float tMin, float tMax) {
+		std::shared_ptr<Geometry> geometry = GetComponent<Geometry>();
+		if (!geometry)
+			return false;
+		return geometry->Occluded(ray, GetFrame(), tMin, tMax);
+	}
+
+	Frame Actor::GetFrame() const {
+		std::shared_ptr<Transform> transform = GetComponent<Transform>();
+		if (!transform)
+			return Frame{};
+		return transform->GetFrame();
+	}
 
 }
\ No newline at end of file
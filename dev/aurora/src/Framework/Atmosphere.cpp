@@ -2,7 +2,6 @@
 #include "Framework/Light.h"
 
 #include "Numa.h"
-#include "Random.h"
 
 #include <cassert>
 
@@ -38,7 +37,7 @@ namespace aurora {
 		// Sample the directional light retrieving all the necessary information we need about it.
 		// This includes light direction 'wi', radiance 'Li', and position 'p'.
 		LightSampleData lightSampleData{};
-		sun->Sample(p, numa::Vec3{0.0f} /* not used! */, lightSampleData);
+		sun->Sample(p, numa::Vec3{0.0f} /* not used! */, numa::Vec2{0.0f} /* not used! */, lightSampleData);
 		// Now we need to make sure that there's nothing in our way to reach the light.
 		// Again, the assumption for now is that there's nothing in the atmosphere blocking the light.
 		// [TODO]: think about relaxing this assumption.
@@ -82,7 +81,7 @@ namespace aurora {
 		numa::Vec3 Li = lightSampleData.Li * light_path_Tr;
 		return Li;
 	}
-	numa::Vec3 Atmosphere::ComputeSkyColor(const numa::Ray& ray, DirectionalLight* dirLight) const {
+	numa::Vec3 Atmosphere::ComputeSkyColor(const numa::Ray& ray, DirectionalLight* dirLight, Sampler& sampler) const {
 		// Common constants
 		static constexpr float atmosphereHitBias{bias};
 		static constexpr float trimPathLength{bias};
@@ -143,7 +142,7 @@ namespace aurora {
 		for (uint32_t segment = 0; segment < segments; segment++) {
 			// Move to the next segment and add some jitter within it.
 			// float t_prime_jitter = 0.5f * dt; // introdcues banding (can't be alleviated with more SPPs)
-			float t_prime_jitter = numa::RandomFloat() * dt; // introduces noise (can be alleviated with more SPPs)
+			float t_prime_jitter = sampler.Get1D() * dt; // introduces noise (can be alleviated with more SPPs)
 			float t_prime = segment * dt + t_prime_jitter; // or 'segment_t'
 			// Find the point corresponding to 't_prime'
 			numa::Vec3 p_prime = ray.GetPoint(t_prime); // 'segment_p'
@@ -161,7 +160,7 @@ namespace aurora {
 			// Sample the directional light retrieving all the necessary information we need about it.
 			// This includes light direction 'wi', radiance 'Li', and position 'p'.
 			LightSampleData lightSampleData{};
-			dirLight->Sample(p_prime, numa::Vec3{ 0.0f } /* not used! */, lightSampleData);
+			dirLight->Sample(p_prime, numa::Vec3{ 0.0f } /* not used! */, numa::Vec2{ 0.0f } /* not used! */, lightSampleData);
 			// Now we need to make sure that there's nothing in our way to reach the light.
 			// Again, the assumption for now is that there's nothing in the atmosphere blocking the light.
 			// [TODO]: think about relaxing this assumption.
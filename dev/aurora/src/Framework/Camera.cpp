@@ -5,7 +5,6 @@
 #include "Core/Utility.h"
 
 #include "Numa.h"
-#include "Random.h"
 
 namespace aurora {
 
@@ -20,6 +19,10 @@ namespace aurora {
 		ComputeCameraParameters();
 	}
 
+	void Camera::Commit() {
+		cameraFrame = GetFrame();
+	}
+
 	numa::Ray Camera::GenerateCameraRay(uint32_t x_coord, uint32_t y_coord) const {
 		float raster_coord_x = static_cast<float>(x_coord) + 0.5f;
 		float raster_coord_y = static_cast<float>(y_coord) + 0.5f;
@@ -50,21 +53,18 @@ namespace aurora {
 		return numa::Ray{ rayOrigin, rayDirection };
 		*/
 
-		std::shared_ptr<Transform> cameraTransform = GetComponent<Transform>();
-		if (cameraTransform) {
-			rayOrigin = cameraTransform->GetWorldPosition();
-			rayDirection = cameraTransform->GetRotationMatrix() * rayDirection;
-		}
+		rayOrigin = cameraFrame.position;
+		rayDirection = cameraFrame.ToWorldDirection(rayDirection);
 
 		numa::Ray cameraRay{rayOrigin, rayDirection};
 		return cameraRay;
 	}
-	numa::Ray Camera::GenerateCameraRayJittered(uint32_t x_coord, uint32_t y_coord) const {
+	numa::Ray Camera::GenerateCameraRayJittered(uint32_t x_coord, uint32_t y_coord, const numa::Vec2& u) const {
 		float raster_coord_x = static_cast<float>(x_coord) + 0.5f;
 		float raster_coord_y = static_cast<float>(y_coord) + 0.5f;
 
 		// 1.
-		numa::Vec2 shift{numa::RandomInSquare(0.5f)};
+		numa::Vec2 shift{u.x - 0.5f, u.y - 0.5f};
 		numa::Vec3 pixelPosition = GeneratePixelPosition(raster_coord_x + shift.x, raster_coord_y + shift.y);
 
 		// 2.
@@ -84,11 +84,8 @@ namespace aurora {
 		numa::Vec3 rayOrigin{0.0f};
 		numa::Vec3 rayDirection = numa::Normalize(pixelPosition);
 
-		std::shared_ptr<Transform> cameraTransform = GetComponent<Transform>();
-		if (cameraTransform) {
-			rayOrigin = cameraTransform->GetWorldPosition();
-			rayDirection = cameraTransform->GetRotationMatrix() * rayDirection;
-		}
+		rayOrigin = cameraFrame.position;
+		rayDirection = cameraFrame.ToWorldDirection(rayDirection);
 
 		numa::Ray jitteredCameraRay{rayOrigin, rayDirection};
 		return jitteredCameraRay;
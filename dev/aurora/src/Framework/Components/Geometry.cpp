@@ -3,14 +3,160 @@
 #include "Framework/Actor.h"
 #include "Framework/Components/Transform.h"
 
+#include "Numa.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
 namespace aurora {
 
 	Geometry::Geometry(GeometryType geometryType)
 		: Component(ComponentType::GEOMETRY), geometryType(geometryType) {
 	}
+
+	void Geometry::OnOwnerAttach(std::shared_ptr<Actor> ownerActor) {
+		// Unlike other components, geometries are shared between actors,
+		// so only the number of owners is tracked.
+		ownerCount++;
+	}
+	void Geometry::OnOwnerDetach() {
+		assert(ownerCount > 0 &&
+			"The geometry must have a valid owner actor!"
+			"Did you call 'OnOwnerAttach'?");
+		ownerCount--;
+	}
+
+	bool Geometry::Intersect(const numa::Ray& ray, const Frame& frame, float tMax, HitRecord& hit) const {
+		numa::Ray localRay{
+			frame.ToLocalPoint(ray.GetOrigin()),
+			frame.ToLocalDirection(ray.GetDirection())
+		};
+		// The frame is rigid, so distances are the same in both spaces.
+		return IntersectLocal(localRay, tMax, hit);
+	}
+	void Geometry::ComputeSurfaceInteraction(const numa::Ray& ray, const Frame& frame, const HitRecord& hit, GeometryRayHit& geometryHit) const {
+		numa::Ray localRay{
+			frame.ToLocalPoint(ray.GetOrigin()),
+			frame.ToLocalDirection(ray.GetDirection())
+		};
+		ComputeSurfaceInteractionLocal(localRay, hit, geometryHit);
+		geometryHit.hitRay = ray;
+		geometryHit.hitPoint = frame.ToWorldPoint(geometryHit.hitPoint);
+		geometryHit.hitNormal = frame.ToWorldDirection(geometryHit.hitNormal);
+	}
+	bool Geometry::Intersect(const numa::Ray& ray, const Frame& frame, GeometryRayHit& geometryHit) const {
+		geometryHit.hitRay = ray;
+		geometryHit.hit = false;
+		HitRecord hit{};
+		if (!Intersect(ray, frame, std::numeric_limits<float>::infinity(), hit))
+			return false;
+		ComputeSurfaceInteraction(ray, frame, hit, geometryHit);
+		return true;
+	}
+	bool Geometry::Occluded(const numa::Ray& ray, const Frame& frame, float tMin, float tMax) const {
+		numa::Ray localRay{
+			frame.ToLocalPoint(ray.GetOrigin()),
+			frame.ToLocalDirection(ray.GetDirection())
+		};
+		return OccludedLocal(localRay, tMin, tMax);
+	}
+	Aabb Geometry::ComputeWorldBounds(const Frame& frame) const {
+		Aabb worldBounds{};
+		Aabb localBounds = ComputeLocalBounds();
+		if (!localBounds.Valid())
+			return worldBounds;
+		for (int corner = 0; corner < 8; corner++) {
+			numa::Vec3 localCorner{
+				(corner & 1) ? localBounds.max.x : localBounds.min.x,
+				(corner & 2) ? localBounds.max.y : localBounds.min.y,
+				(corner & 4) ? localBounds.max.z : localBounds.min.z
+			};
+			worldBounds.Grow(frame.ToWorldPoint(localCorner));
+		}
+		return worldBounds;
+	}
+
+	void Geometry::BuildAccelerationStructure(const BvhBuildSettings& settings, TaskManager* taskManager) {
+		// Analytic shapes don't need one.
+	}
+
+	bool Geometry::IsBounded() const {
+		return true;
+	}
+
 	GeometryType Geometry::GetGeometryType() const {
 		return geometryType;
 	}
+	uint32_t Geometry::GetOwnerCount() const {
+		return ownerCount;
+	}
+
+	Circle::Circle()
+		: Geometry(GeometryType::CIRCLE) {
+	}
+	Circle::Circle(float radius)
+		: Geometry(GeometryType::CIRCLE), radius(radius) {
+	}
+
+	bool Circle::IntersectLocal(const numa::Ray& ray, float tMax, HitRecord& hit) const {
+		static constexpr float parallelThreshold{1e-8f};
+
+		float denom = ray.GetDirection().z;
+		if (std::abs(denom) < parallelThreshold)
+			return false;
+		float t = -ray.GetOrigin().z / denom;
+		if (t <= 0.0f || t >= tMax)
+			return false;
+		numa::Vec3 p = ray.GetPoint(t);
+		if (p.x * p.x + p.y * p.y > radius * radius)
+			return false;
+
+		hit.t = t;
+		hit.u = p.x;
+		hit.v = p.y;
+		hit.primIdx = 0;
+		return true;
+	}
+	void Circle::ComputeSurfaceInteractionLocal(const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const {
+		geometryHit.hitRay = ray;
+		geometryHit.hitPoint = numa::Vec3{hit.u, hit.v, 0.0f};
+		geometryHit.hitNormal = numa::Vec3{0.0f, 0.0f, 1.0f};
+		// Disk mapped onto [0, 1]^2.
+		geometryHit.hitUv = numa::Vec2{0.5f + 0.5f * hit.u / radius, 0.5f + 0.5f * hit.v / radius};
+		geometryHit.hitDistance = hit.t;
+		geometryHit.hitGeometryType = GeometryType::CIRCLE;
+		geometryHit.hit = true;
+		geometryHit.hitFrontFace = ray.GetDirection().z < 0.0f;
+	}
+
+	bool Circle::OccludedLocal(const numa::Ray& ray, float tMin, float tMax) const {
+		static constexpr float parallelThreshold{1e-8f};
+
+		float denom = ray.GetDirection().z;
+		if (std::abs(denom) < parallelThreshold)
+			return false;
+		float t = -ray.GetOrigin().z / denom;
+		if (t <= tMin || t >= tMax)
+			return false;
+		numa::Vec3 p = ray.GetPoint(t);
+		return p.x * p.x + p.y * p.y <= radius * radius;
+	}
+
+	Aabb Circle::ComputeLocalBounds() const {
+		static constexpr float thicknessPadding{0.0001f};
+
+		Aabb bounds{};
+		bounds.Grow(numa::Vec3{-radius, -radius, 0.0f});
+		bounds.Grow(numa::Vec3{radius, radius, 0.0f});
+		// The disk would otherwise end up with a flat box.
+		bounds.Pad(thicknessPadding);
+		return bounds;
+	}
+
+	float Circle::GetRadius() const {
+		return radius;
+	}
 
 	Plane::Plane()
 		: Geometry(GeometryType::PLANE) {
@@ -19,53 +165,75 @@ namespace aurora {
 		: Geometry(GeometryType::PLANE), dimensions(dimensions) {
 	}
 
-	bool Plane::Intersect(const numa::Ray& ray, GeometryRayHit& geometryHit) {
+	bool Plane::IntersectLocal(const numa::Ray& ray, float tMax, HitRecord& hit) const {
+		static constexpr float parallelThreshold{1e-8f};
+
+		float denom = ray.GetDirection().z;
+		if (std::abs(denom) < parallelThreshold)
+			return false;
+		float t = -ray.GetOrigin().z / denom;
+		if (t <= 0.0f || t >= tMax)
+			return false;
+
+		// We know that the ray intersects the plane, but we haven't checked the boundaries.
+		// If the dimensions of the plane are set to finite numbers, we'll have to make sure
+		// that the ray stays within them.
+		numa::Vec3 p = ray.GetPoint(t);
+		if (std::isfinite(dimensions.x) && std::abs(p.x) > dimensions.x / 2.0f)
+			return false;
+		if (std::isfinite(dimensions.y) && std::abs(p.y) > dimensions.y / 2.0f)
+			return false;
+
+		hit.t = t;
+		hit.u = p.x;
+		hit.v = p.y;
+		hit.primIdx = 0;
+		return true;
+	}
+	void Plane::ComputeSurfaceInteractionLocal(const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const {
 		geometryHit.hitRay = ray;
+		geometryHit.hitPoint = numa::Vec3{hit.u, hit.v, 0.0f};
+		geometryHit.hitNormal = numa::Vec3{0.0f, 0.0f, 1.0f};
+		geometryHit.hitUv = numa::Vec2{hit.u, hit.v};
+		geometryHit.hitDistance = hit.t;
+		geometryHit.hitGeometryType = GeometryType::PLANE;
+		geometryHit.hit = true;
+		geometryHit.hitFrontFace = ray.GetDirection().z < 0.0f;
+	}
+
+	bool Plane::OccludedLocal(const numa::Ray& ray, float tMin, float tMax) const {
+		static constexpr float parallelThreshold{1e-8f};
 
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return false;
-
-		const numa::Mat3 rotMat = transform->GetRotationMatrix();
-		const numa::Vec3& planeOrigin = transform->GetWorldPosition();
-		numa::Vec3 planeNormal = transform->GetForwardAxis();
-
-		numa::Plane plane{planeNormal, planeOrigin};
-		numa::RayPlaneHit rayPlaneHit{};
-		bool hit = IntersectPlane(plane, ray, rayPlaneHit);
-		geometryHit.hit = hit;
-		
-		if (rayPlaneHit.HitBehind()) {
-			geometryHit.hit = false;
-		} else /* if (rayPlaneHit.HitInFront()) */ {
-			// We know that the ray intersects the plane, but we haven't checked the boundaries.
-			// If the dimensions of the plane are set to finite numbers, we'll have to make sure
-			// that the ray stays within them.
-			bool widthCheck{true};
-			bool heightCheck{true};
-			numa::Vec3 dP = rayPlaneHit.hitPoint - planeOrigin;
-			if (std::isfinite(dimensions.x)) {
-				numa::Vec3 right = transform->GetRightAxis();
-				float x = numa::Dot(dP, right); // [-w/2; w/2]
-				float xNorm = x + dimensions.x / 2.0f; // [0; w]
-				widthCheck = xNorm >= 0.0f && xNorm <= dimensions.x;
-			}
-			if (std::isfinite(dimensions.y)) {
-				numa::Vec3 up = transform->GetUpAxis();
-				float y = numa::Dot(dP, up); // [-h/2, h/2]
-				float yNorm = y + dimensions.y / 2.0f; // [0; h]
-				heightCheck = yNorm >= 0.0f && yNorm <= dimensions.y;
-			}
-			geometryHit.hit = widthCheck && heightCheck;
-			if (geometryHit.hit) {
-				geometryHit.hitPoint = rayPlaneHit.hitPoint;
-				geometryHit.hitNormal = rayPlaneHit.hitNormal;
-				geometryHit.hitUv = rayPlaneHit.hitUv;
-				geometryHit.hitDistance = rayPlaneHit.hitDistance;
-				geometryHit.hitFrontFace = rayPlaneHit.hitFrontFace;
-				geometryHit.hitGeometryType = GeometryType::PLANE;
-			}
+		float denom = ray.GetDirection().z;
+		if (std::abs(denom) < parallelThreshold)
+			return false;
+		float t = -ray.GetOrigin().z / denom;
+		if (t <= tMin || t >= tMax)
+			return false;
+
+		numa::Vec3 p = ray.GetPoint(t);
+		if (std::isfinite(dimensions.x) && std::abs(p.x) > dimensions.x / 2.0f)
+			return false;
+		if (std::isfinite(dimensions.y) && std::abs(p.y) > dimensions.y / 2.0f)
+			return false;
+		return true;
+	}
+
+	bool Plane::IsBounded() const {
+		return std::isfinite(dimensions.x) && std::isfinite(dimensions.y);
+	}
+	Aabb Plane::ComputeLocalBounds() const {
+		static constexpr float thicknessPadding{0.0001f};
+
+		Aabb bounds{};
+		if (!IsBounded()) {
+			return bounds;
 		}
-		return geometryHit.hit;
+		bounds.Grow(numa::Vec3{-0.5f * dimensions.x, -0.5f * dimensions.y, 0.0f});
+		bounds.Grow(numa::Vec3{0.5f * dimensions.x, 0.5f * dimensions.y, 0.0f});
+		// The plane would otherwise end up with a flat box.
+		bounds.Pad(thicknessPadding);
+		return bounds;
 	}
 
 	const numa::Vec2& Plane::GetDimensions() const {
@@ -79,62 +247,78 @@ namespace aurora {
 		: Geometry(GeometryType::SPHERE), radius(radius) {
 	}
 
-	bool Sphere::Intersect(const numa::Ray& ray, GeometryRayHit& geometryHit) {
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return false;
-
-		numa::Sphere sphere{
-			transform->GetWorldPosition(), this->radius
-		};
-		numa::RaySphereHit rayHit{};
-		bool hit = numa::IntersectSphere(sphere, ray, rayHit);
+	bool Sphere::IntersectLocal(const numa::Ray& ray, float tMax, HitRecord& hit) const {
+		const numa::Vec3& oc = ray.GetOrigin();
+		const numa::Vec3& d = ray.GetDirection();
+		float a = numa::Dot(d, d);
+		float halfB = numa::Dot(oc, d);
+		float c = numa::Dot(oc, oc) - radius * radius;
+		float discriminant = halfB * halfB - a * c;
+		if (discriminant < 0.0f)
+			return false;
+		float sqrtDiscriminant = std::sqrt(discriminant);
+		// The closer root is in front of the ray unless the ray starts inside the sphere.
+		float t = (-halfB - sqrtDiscriminant) / a;
+		if (t <= 0.0f)
+			t = (-halfB + sqrtDiscriminant) / a;
+		if (t <= 0.0f || t >= tMax)
+			return false;
 
+		hit.t = t;
+		hit.primIdx = 0;
+		return true;
+	}
+	void Sphere::ComputeSurfaceInteractionLocal(const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const {
 		geometryHit.hitRay = ray;
+		geometryHit.hitPoint = ray.GetPoint(hit.t);
+		geometryHit.hitNormal = ComputeNormal(geometryHit.hitPoint);
+		geometryHit.hitUv = numa::Vec2{
+			0.5f + std::atan2(geometryHit.hitNormal.z, geometryHit.hitNormal.x) / (2.0f * numa::Pi<float>()),
+			std::acos(std::clamp(geometryHit.hitNormal.y, -1.0f, 1.0f)) / numa::Pi<float>()
+		};
+		geometryHit.hitDistance = hit.t;
 		geometryHit.hitGeometryType = GeometryType::SPHERE;
-		geometryHit.hit = hit;
-		// 'No hit' or the hit is behind
-		if (!geometryHit.hit || rayHit.HitBehind()) {
-			geometryHit.hit = false;
-			return geometryHit.hit;
-		}
-		// It's either a 'single' hit or a 'double' hit.
 		geometryHit.hit = true;
-		// One hit 'in front'
-		if (rayHit.SingleHit() && rayHit.HitInFront()) {
-			geometryHit.hitPoint = rayHit.hitPointT1;
-			geometryHit.hitNormal = rayHit.hitNormalT1;
-			geometryHit.hitUv = rayHit.hitUvT1;
-			geometryHit.hitDistance = rayHit.hitDistanceT1;
-			geometryHit.hitFrontFace = true;
-		} else /* if (rayHit.DoubleHit()) */ {
-			// The hit is either 'in front' or 'inside'
-			// Two hits 'in front'
-			if (rayHit.HitInFront()) {
-				geometryHit.hitPoint = rayHit.hitPointT2;
-				geometryHit.hitNormal = rayHit.hitNormalT2;
-				geometryHit.hitUv = rayHit.hitUvT2;
-				geometryHit.hitDistance = rayHit.hitDistanceT2;
-				geometryHit.hitFrontFace = true;
-			}  else if (rayHit.HitInside()) { // Two hits 'inside'
-				geometryHit.hitPoint = rayHit.hitPointT1;
-				geometryHit.hitNormal = rayHit.hitNormalT1;
-				geometryHit.hitUv = rayHit.hitUvT1;
-				geometryHit.hitDistance = rayHit.hitDistanceT1;
-				geometryHit.hitFrontFace = false;
-			}
-		}
-		return geometryHit.hit;
+		// The ray starts inside the sphere if it leaves through the hit point.
+		geometryHit.hitFrontFace = numa::Dot(ray.GetDirection(), geometryHit.hitNormal) < 0.0f;
+	}
+
+	bool Sphere::OccludedLocal(const numa::Ray& ray, float tMin, float tMax) const {
+		// Only the roots of the quadratic are needed, points, normals and UVs are skipped.
+		const numa::Vec3& oc = ray.GetOrigin();
+		const numa::Vec3& d = ray.GetDirection();
+		float a = numa::Dot(d, d);
+		float halfB = numa::Dot(oc, d);
+		float c = numa::Dot(oc, oc) - radius * radius;
+		float discriminant = halfB * halfB - a * c;
+		if (discriminant < 0.0f)
+			return false;
+		float sqrtDiscriminant = std::sqrt(discriminant);
+		float t1 = (-halfB - sqrtDiscriminant) / a;
+		if (t1 > tMin && t1 < tMax)
+			return true;
+		float t2 = (-halfB + sqrtDiscriminant) / a;
+		return t2 > tMin && t2 < tMax;
+	}
+
+	Aabb Sphere::ComputeWorldBounds(const Frame& frame) const {
+		Aabb bounds{};
+		bounds.Grow(frame.position - numa::Vec3{radius});
+		bounds.Grow(frame.position + numa::Vec3{radius});
+		return bounds;
+	}
+	Aabb Sphere::ComputeLocalBounds() const {
+		Aabb bounds{};
+		bounds.Grow(numa::Vec3{-radius});
+		bounds.Grow(numa::Vec3{radius});
+		return bounds;
 	}
 
 	float Sphere::DistanceFromEdge(const numa::Vec3& point) const {
 		return 0.0f;
 	}
 	float Sphere::DistanceFromEdgeNormalized(const numa::Vec3& point) const {
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return 0.0f;
-
-		const numa::Vec3& point_radius_vector = point - transform->GetWorldPosition();
-		float point_radius = numa::Length(point_radius_vector);
+		float point_radius = numa::Length(point);
 		float point_radius_normalized = point_radius / radius;
 		return point_radius_normalized;
 	}
@@ -144,10 +328,7 @@ namespace aurora {
 	}
 
 	numa::Vec3 Sphere::ComputeNormal(const numa::Vec3& pointOnSphere) const {
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return numa::Vec3{0.0f,1.0f,0.0f};
-
-		return numa::Normalize(pointOnSphere - transform->GetWorldPosition());
+		return numa::Normalize(pointOnSphere);
 	}
 
 }
\ No newline at end of file
@@ -10,5 +10,8 @@ namespace aurora {
 	MaterialType Material::GetMaterialType() const {
 		return materialType;
 	}
+	bool Material::IsSpecular() const {
+		return false;
+	}
 
 }
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "Framework/Components/Mesh.h"
+
+#include "Numa.h"
+
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace aurora {
+
+	// WatertightRay
+
+	WatertightRay::WatertightRay(const numa::Ray& ray)
+		: origin(ray.GetOrigin()) {
+		const numa::Vec3& d = ray.GetDirection();
+		// Calculate the dimension where the ray direction is maximal.
+		numa::Vec3 absD{std::abs(d.x), std::abs(d.y), std::abs(d.z)};
+		kz = 2;
+		if (absD.x > absD.y && absD.x > absD.z)
+			kz = 0;
+		else if (absD.y > absD.z)
+			kz = 1;
+		kx = (kz + 1) % 3;
+		ky = (kx + 1) % 3;
+		// Swap 'kx' and 'ky' to preserve the winding direction of triangles.
+		if (GetAxisValue(d, kz) < 0.0f)
+			std::swap(kx, ky);
+		float dz = GetAxisValue(d, kz);
+		Sx = GetAxisValue(d, kx) / dz;
+		Sy = GetAxisValue(d, ky) / dz;
+		Sz = 1.0f / dz;
+	}
+
+	// Mesh
+
+	Mesh::Mesh(std::vector<numa::Vec3> positions, std::vector<uint32_t> indices)
+		: Geometry(GeometryType::MESH),
+		positions(std::move(positions)), indices(std::move(indices)) {
+		ComputeBounds();
+	}
+	Mesh::Mesh(std::vector<numa::Vec3> positions,
+	           std::vector<numa::Vec3> normals,
+	           std::vector<numa::Vec2> uvs,
+	           std::vector<uint32_t> indices)
+		: Geometry(GeometryType::MESH),
+		positions(std::move(positions)), normals(std::move(normals)),
+		uvs(std::move(uvs)), indices(std::move(indices)) {
+		assert((this->normals.empty() || this->normals.size() == this->positions.size()) &&
+			"Every vertex must have a normal!");
+		assert((this->uvs.empty() || this->uvs.size() == this->positions.size()) &&
+			"Every vertex must have a UV coordinate!");
+		ComputeBounds();
+	}
+
+	bool Mesh::IntersectLocal(const numa::Ray& ray, float tMax, HitRecord& hit) const {
+		assert((!bvh.Empty() || indices.empty()) &&
+			"The mesh BVH hasn't been built! "
+			"Did you call 'BuildAccelerationStructure'?");
+		WatertightRay watertightRay{ray};
+
+		auto intersectTriangle = [&](uint32_t triangleIdx, float& triangleTMax) {
+			TriangleHit triangleHit{};
+			if (!IntersectTriangle(triangleIdx, watertightRay, 0.0f, triangleTMax, triangleHit))
+				return false;
+			triangleTMax = triangleHit.t;
+			hit.t = triangleHit.t;
+			hit.u = triangleHit.b1;
+			hit.v = triangleHit.b2;
+			hit.primIdx = triangleIdx;
+			return true;
+		};
+		return bvh.IntersectClosest(ray, 0.0f, tMax, intersectTriangle);
+	}
+	void Mesh::ComputeSurfaceInteractionLocal(const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const {
+		uint32_t i0 = indices[3 * hit.primIdx + 0];
+		uint32_t i1 = indices[3 * hit.primIdx + 1];
+		uint32_t i2 = indices[3 * hit.primIdx + 2];
+		float b0 = 1.0f - hit.u - hit.v;
+
+		numa::Vec3 geometricNormal = ComputeGeometricNormal(hit.primIdx);
+		numa::Vec3 shadingNormal = geometricNormal;
+		if (HasNormals()) {
+			shadingNormal = numa::Normalize(b0 * normals[i0] + hit.u * normals[i1] + hit.v * normals[i2]);
+		}
+		numa::Vec2 uv{hit.u, hit.v};
+		if (HasUvs()) {
+			uv = numa::Vec2{
+				b0 * uvs[i0].x + hit.u * uvs[i1].x + hit.v * uvs[i2].x,
+				b0 * uvs[i0].y + hit.u * uvs[i1].y + hit.v * uvs[i2].y
+			};
+		}
+
+		geometryHit.hitRay = ray;
+		geometryHit.hit = true;
+		geometryHit.hitDistance = hit.t;
+		geometryHit.hitPoint = ray.GetPoint(hit.t);
+		geometryHit.hitNormal = shadingNormal;
+		geometryHit.hitUv = uv;
+		// Normals are kept facing outward, the face flag tells the caller which side was hit.
+		geometryHit.hitFrontFace = numa::Dot(ray.GetDirection(), geometricNormal) < 0.0f;
+		geometryHit.hitGeometryType = GeometryType::MESH;
+	}
+	bool Mesh::OccludedLocal(const numa::Ray& ray, float tMin, float tMax) const {
+		WatertightRay watertightRay{ray};
+		auto occludedTriangle = [&](uint32_t triangleIdx) {
+			TriangleHit hit{};
+			return IntersectTriangle(triangleIdx, watertightRay, tMin, tMax, hit);
+		};
+		return bvh.Occluded(ray, tMin, tMax, occludedTriangle);
+	}
+
+	void Mesh::BuildAccelerationStructure(const BvhBuildSettings& settings, TaskManager* taskManager) {
+		assert(indices.size() % 3 == 0 && "Triangle meshes must have three indices per triangle!");
+
+		uint32_t triangleCount = GetTriangleCount();
+		std::vector<Aabb> triangleBounds(triangleCount);
+		for (uint32_t triangleIdx = 0; triangleIdx < triangleCount; triangleIdx++) {
+			Aabb& bounds = triangleBounds[triangleIdx];
+			bounds.Grow(positions[indices[3 * triangleIdx + 0]]);
+			bounds.Grow(positions[indices[3 * triangleIdx + 1]]);
+			bounds.Grow(positions[indices[3 * triangleIdx + 2]]);
+		}
+		BvhBuildSettings meshBuildSettings = settings;
+		meshBuildSettings.maxLeafSize = 4;
+		bvh.Build(triangleBounds, meshBuildSettings, taskManager);
+	}
+
+	Aabb Mesh::ComputeLocalBounds() const {
+		return localBounds;
+	}
+	const Aabb& Mesh::GetLocalBounds() const {
+		return localBounds;
+	}
+
+	uint32_t Mesh::GetTriangleCount() const {
+		return static_cast<uint32_t>(indices.size() / 3);
+	}
+	uint32_t Mesh::GetVertexCount() const {
+		return static_cast<uint32_t>(positions.size());
+	}
+
+	bool Mesh::HasNormals() const {
+		return !normals.empty();
+	}
+	bool Mesh::HasUvs() const {
+		return !uvs.empty();
+	}
+
+	void Mesh::ComputeBounds() {
+		for (const numa::Vec3& position : positions) {
+			localBounds.Grow(position);
+		}
+	}
+
+	bool Mesh::IntersectTriangle(uint32_t triangleIdx, const WatertightRay& ray, float tMin, float tMax, TriangleHit& hit) const {
+		// Vertices relative to the ray origin.
+		const numa::Vec3 A = positions[indices[3 * triangleIdx + 0]] - ray.origin;
+		const numa::Vec3 B = positions[indices[3 * triangleIdx + 1]] - ray.origin;
+		const numa::Vec3 C = positions[indices[3 * triangleIdx + 2]] - ray.origin;
+
+		// Shear and scale the vertices.
+		const float Az = GetAxisValue(A, ray.kz);
+		const float Bz = GetAxisValue(B, ray.kz);
+		const float Cz = GetAxisValue(C, ray.kz);
+		const float Ax = GetAxisValue(A, ray.kx) - ray.Sx * Az;
+		const float Ay = GetAxisValue(A, ray.ky) - ray.Sy * Az;
+		const float Bx = GetAxisValue(B, ray.kx) - ray.Sx * Bz;
+		const float By = GetAxisValue(B, ray.ky) - ray.Sy * Bz;
+		const float Cx = GetAxisValue(C, ray.kx) - ray.Sx * Cz;
+		const float Cy = GetAxisValue(C, ray.ky) - ray.Sy * Cz;
+
+		// Scaled barycentric coordinates.
+		float U = Cx * By - Cy * Bx;
+		float V = Ax * Cy - Ay * Cx;
+		float W = Bx * Ay - By * Ax;
+		// Fall back to double precision on the edges, this is what makes the test watertight.
+		if (U == 0.0f || V == 0.0f || W == 0.0f) {
+			U = static_cast<float>(static_cast<double>(Cx) * By - static_cast<double>(Cy) * Bx);
+			V = static_cast<float>(static_cast<double>(Ax) * Cy - static_cast<double>(Ay) * Cx);
+			W = static_cast<float>(static_cast<double>(Bx) * Ay - static_cast<double>(By) * Ax);
+		}
+		if ((U < 0.0f || V < 0.0f || W < 0.0f) && (U > 0.0f || V > 0.0f || W > 0.0f))
+			return false;
+		float det = U + V + W;
+		if (det == 0.0f)
+			return false;
+
+		// Scaled hit distance, compared against the interval before the division.
+		float T = U * ray.Sz * Az + V * ray.Sz * Bz + W * ray.Sz * Cz;
+		if (det > 0.0f) {
+			if (T <= tMin * det || T >= tMax * det)
+				return false;
+		} else {
+			if (T >= tMin * det || T <= tMax * det)
+				return false;
+		}
+
+		float invDet = 1.0f / det;
+		hit.t = T * invDet;
+		hit.b1 = V * invDet;
+		hit.b2 = W * invDet;
+		return true;
+	}
+	numa::Vec3 Mesh::ComputeGeometricNormal(uint32_t triangleIdx) const {
+		const numa::Vec3& p0 = positions[indices[3 * triangleIdx + 0]];
+		const numa::Vec3& p1 = positions[indices[3 * triangleIdx + 1]];
+		const numa::Vec3& p2 = positions[indices[3 * triangleIdx + 2]];
+		return numa::Normalize(numa::Cross(p1 - p0, p2 - p0));
+	}
+
+}
\ No newline at end of file
@@ -48,6 +48,10 @@ namespace aurora {
 		return this->world[2];
 	}
 
+	Frame Transform::GetFrame() const {
+		return Frame{GetRightAxis(), GetUpAxis(), GetForwardAxis(), position};
+	}
+
 	void Transform::UpdateWorldMatrix() {
 		this->world = numa::Mat4{
 			numa::RotateYawPitchRoll(
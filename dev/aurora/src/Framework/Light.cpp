@@ -5,194 +5,435 @@
 #include "Framework/Components/Transform.h"
 
 #include "Numa.h"
-#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace aurora {
 
 	// Light Sample
 
+	float ComputeShadowRayLength(const numa::Vec3& p, const LightSampleData& lightSample) {
+		if (lightSample.lightPtr && lightSample.lightPtr->GetLightType() == LightType::DIRECTIONAL)
+			return std::numeric_limits<float>::infinity();
+		return numa::Length(lightSample.pos - p);
+	}
+
 	void LightSampleBundle::AddLightSample(const LightSampleData& lightSample) {
 		bundle.push_back(lightSample);
 	}
 
-	// Light base class
+	// Area light sampling
 
-	Light::Light(LightType type)
-		: Component(ComponentType::LIGHT), type(type) {
+	// Below this solid angle the spherical rectangle loses too much precision, quads are sampled by area instead.
+	// Above it, the quad is so close that its spherical rectangle is nearly a hemisphere, same thing.
+	static constexpr float minSphericalRectangleSolidAngle{3e-4f};
+	static constexpr float maxSphericalRectangleSolidAngle{6.22f};
+
+	static float SafeAsin(float x) {
+		return std::asin(std::clamp(x, -1.0f, 1.0f));
 	}
 
-	LightType Light::GetLightType() const {
-		return type;
+	// Angle between unit vectors, more precise than the arc cosine of their dot product when they're almost (anti)parallel.
+	static float AngleBetween(const numa::Vec3& a, const numa::Vec3& b) {
+		if (numa::Dot(a, b) < 0.0f)
+			return numa::Pi<float>() - 2.0f * SafeAsin(numa::Length(a + b) / 2.0f);
+		return 2.0f * SafeAsin(numa::Length(b - a) / 2.0f);
 	}
 
-	// Directional light
+	// Tangent and bitangent of the unit vector 'n' (Duff et al., "Building an Orthonormal Basis, Revisited").
+	static void BuildOrthonormalBasis(const numa::Vec3& n, numa::Vec3& t, numa::Vec3& b) {
+		float sign = std::copysign(1.0f, n.z);
+		float a = -1.0f / (sign + n.z);
+		float c = n.x * n.y * a;
+		t = numa::Vec3{1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x};
+		b = numa::Vec3{c, sign + n.y * n.y * a, -n.y};
+	}
 
-	DirectionalLight::DirectionalLight(const numa::Vec3& lightColor, float lightStrength)
-		: Light(LightType::DIRECTIONAL), color(lightColor), strength(lightStrength) {
+	// Density per unit solid angle at 'p' of picking 'lightPoint' uniformly over an area, 0 behind the surface.
+	static float AreaToSolidAnglePdf(const numa::Vec3& p, const numa::Vec3& lightPoint, const numa::Vec3& lightNormal, float area) {
+		// r^2 / (cos(theta) * A), theta being the angle to the light's normal.
+		numa::Vec3 dP = lightPoint - p;
+		float r2 = numa::Dot(dP, dP);
+		float cosTheta = numa::Dot(-dP, lightNormal) / std::sqrt(r2);
+		if (cosTheta <= 0.0f || area <= 0.0f)
+			return 0.0f;
+		return r2 / (cosTheta * area);
 	}
 
-	void DirectionalLight::Sample(const numa::Vec3& p, const numa::Vec3& N, LightSampleData& data) {
-		data.wi = Wi();
-		data.pos = P();
-		data.Li = Li();
-		data.pdf = pdf();
-		data.lightPtr = this;
+	// Concentric mapping of the square onto the unit disk, it keeps the strata of the square's points.
+	static numa::Vec2 SampleDiskConcentric(const numa::Vec2& u) {
+		float ox = 2.0f * u.x - 1.0f;
+		float oy = 2.0f * u.y - 1.0f;
+		if (ox == 0.0f && oy == 0.0f)
+			return numa::Vec2{0.0f, 0.0f};
+		float r{0.0f};
+		float theta{0.0f};
+		if (std::abs(ox) > std::abs(oy)) {
+			r = ox;
+			theta = 0.25f * numa::Pi<float>() * (oy / ox);
+		} else {
+			r = oy;
+			theta = 0.5f * numa::Pi<float>() - 0.25f * numa::Pi<float>() * (ox / oy);
+		}
+		return numa::Vec2{r * std::cos(theta), r * std::sin(theta)};
 	}
 
-	numa::Vec3 DirectionalLight::P() const {
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return numa::Vec3{0.0f};
-		return transform->GetWorldPosition();
+	// 1 - cos(theta_max) of the cone of directions toward a sphere, a Taylor expansion keeps far away spheres precise.
+	static float OneMinusCosThetaMax(float sin2ThetaMax) {
+		// sin^2(1.5 degrees)
+		if (sin2ThetaMax < 0.00068523f)
+			return 0.5f * sin2ThetaMax;
+		return 1.0f - std::sqrt(1.0f - sin2ThetaMax);
+	}
+	static float SphereConePdf(float sin2ThetaMax) {
+		return 1.0f / (numa::TwoPi<float>() * OneMinusCosThetaMax(sin2ThetaMax));
+	}
+	// Uniform direction within the cone that a sphere subtends, returned as the normal of the point of the sphere
+	// it hits first. 'toCenter' goes from the shaded point to the sphere's center.
+	static numa::Vec3 SampleSphereCone(const numa::Vec3& toCenter, float sin2ThetaMax, const numa::Vec2& u) {
+		float oneMinusCosThetaMax = OneMinusCosThetaMax(sin2ThetaMax);
+		float cosTheta = 1.0f - u.x * oneMinusCosThetaMax;
+		float sin2Theta = 1.0f - cosTheta * cosTheta;
+		if (sin2ThetaMax < 0.00068523f) {
+			sin2Theta = sin2ThetaMax * u.x;
+			cosTheta = std::sqrt(1.0f - sin2Theta);
+		}
+		// Angle between the direction toward the center and the normal of the sampled point, seen from the center.
+		float sinThetaMax = std::sqrt(sin2ThetaMax);
+		float cosAlpha = sin2Theta / sinThetaMax + cosTheta * std::sqrt(std::max(1.0f - sin2Theta / sin2ThetaMax, 0.0f));
+		float sinAlpha = std::sqrt(std::max(1.0f - cosAlpha * cosAlpha, 0.0f));
+		float phi = numa::TwoPi<float>() * u.y;
+
+		numa::Vec3 z = numa::Normalize(toCenter);
+		numa::Vec3 x{0.0f};
+		numa::Vec3 y{0.0f};
+		BuildOrthonormalBasis(z, x, y);
+		return -(sinAlpha * std::cos(phi) * x + sinAlpha * std::sin(phi) * y + cosAlpha * z);
 	}
 
-	numa::Vec3 DirectionalLight::Wi() const {
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return numa::Vec3{0.0f};
-		numa::Mat4 world = transform->GetWorldMatrix();
-		// Lights are oriented in the same way as cameras are, i.e. along the negative z-axis.
-		// Light source shines in the direction '-world.forward', however 'wi' variable
-		// is the opposite of that, directed toward the light source.
-		// So we return world.forward, the direction toward the light source.
-		return numa::Vec3{world.forward};
+	// A quad seen from 'p', projected onto the unit sphere around it (Ureña et al., "An Area-Preserving Parametrization
+	// for Spherical Rectangles"). Picking a point of it uniformly gives every direction toward the quad the same density,
+	// so unlike sampling by area, the closest parts of big lights aren't undersampled.
+	struct SphericalRectangle {
+		SphericalRectangle(const numa::Vec3& p, const numa::Vec3& corner, const numa::Vec3& edgeX, const numa::Vec3& edgeY)
+			: origin(p) {
+			float edgeLengthX = numa::Length(edgeX);
+			float edgeLengthY = numa::Length(edgeY);
+			axisX = edgeX / edgeLengthX;
+			axisY = edgeY / edgeLengthY;
+			axisZ = numa::Cross(axisX, axisY);
+			// Local frame at 'p', its Z axis points away from the quad.
+			numa::Vec3 d = corner - p;
+			z0 = numa::Dot(d, axisZ);
+			if (z0 > 0.0f) {
+				axisZ = -axisZ;
+				z0 = -z0;
+			}
+			x0 = numa::Dot(d, axisX);
+			y0 = numa::Dot(d, axisY);
+			x1 = x0 + edgeLengthX;
+			y1 = y0 + edgeLengthY;
+
+			// Normals of the planes through 'p' and the edges, and the inner angles between them.
+			numa::Vec3 v00{x0, y0, z0};
+			numa::Vec3 v01{x0, y1, z0};
+			numa::Vec3 v10{x1, y0, z0};
+			numa::Vec3 v11{x1, y1, z0};
+			numa::Vec3 n0 = numa::Normalize(numa::Cross(v00, v10));
+			numa::Vec3 n1 = numa::Normalize(numa::Cross(v10, v11));
+			numa::Vec3 n2 = numa::Normalize(numa::Cross(v11, v01));
+			numa::Vec3 n3 = numa::Normalize(numa::Cross(v01, v00));
+			float g0 = AngleBetween(-n0, n1);
+			float g1 = AngleBetween(-n1, n2);
+			float g2 = AngleBetween(-n2, n3);
+			float g3 = AngleBetween(-n3, n0);
+			b0 = n0.z;
+			b1 = n2.z;
+			k = numa::TwoPi<float>() - g2 - g3;
+			solidAngle = g0 + g1 - k;
+		}
+
+		bool CanBeSampled() const {
+			return solidAngle > minSphericalRectangleSolidAngle && solidAngle < maxSphericalRectangleSolidAngle;
+		}
+
+		// Point of the quad, the direction toward it is uniform over the solid angle.
+		numa::Vec3 Sample(const numa::Vec2& u) const {
+			static constexpr float oneMinusEpsilon{0x1.fffffep-1f};
+
+			// Position along the X edge, from the area of the spherical rectangle left of it.
+			float au = u.x * solidAngle + k;
+			float fu = (std::cos(au) * b0 - b1) / std::sin(au);
+			float cu = std::copysign(1.0f / std::sqrt(fu * fu + b0 * b0), fu);
+			cu = std::clamp(cu, -oneMinusEpsilon, oneMinusEpsilon);
+			float xu = -(cu * z0) / std::sqrt(1.0f - cu * cu);
+			xu = std::clamp(xu, x0, x1);
+			// Position along the Y edge, uniform in the sine of the elevation.
+			float d = std::sqrt(xu * xu + z0 * z0);
+			float h0 = y0 / std::sqrt(d * d + y0 * y0);
+			float h1 = y1 / std::sqrt(d * d + y1 * y1);
+			float hv = h0 + u.y * (h1 - h0);
+			float yv = hv * hv < 1.0f - 1e-6f ? (hv * d) / std::sqrt(1.0f - hv * hv) : y1;
+			return origin + xu * axisX + yv * axisY + z0 * axisZ;
+		}
+
+		numa::Vec3 origin{0.0f};
+		numa::Vec3 axisX{0.0f};
+		numa::Vec3 axisY{0.0f};
+		numa::Vec3 axisZ{0.0f};
+		float x0{0.0f};
+		float y0{0.0f};
+		float z0{0.0f};
+		float x1{0.0f};
+		float y1{0.0f};
+		float b0{0.0f};
+		float b1{0.0f};
+		float k{0.0f};
+		float solidAngle{0.0f};
+	};
+
+	// Light record
+
+	void LightRecord::Sample(const numa::Vec3& p, const numa::Vec3&, const numa::Vec2& u, LightSampleData& data) const {
+		data.lightPtr = light;
+		switch (lightType) {
+			case LightType::DIRECTIONAL: {
+				// Light source shines in the direction '-frame.forward', however 'wi' variable
+				// is the opposite of that, directed toward the light source.
+				data.wi = frame.forward;
+				data.pos = frame.position;
+				data.Li = radiance;
+				// Directional light source is a "delta" light source, meaning it can't exist in the real world.
+				// Instead, it is defined with the help of the delta function $\sigma$. That delta function
+				// "cancels" the integral, so the Monte Carlo estimator is not needed. In other words,
+				// we directly evaluate the integrand. To be consistent with the interface we've created, we set pdf = 1.0f.
+				data.pdf = 1.0f;
+			} break;
+			case LightType::POINT: {
+				// To avoid division by zero!
+				static constexpr float bias{0.00001f};
+
+				data.pos = frame.position;
+				data.wi = numa::Normalize(data.pos - p);
+				float d = numa::Length(p - data.pos);
+				// 1) is it
+				// data.Li = radiance / (4.0f * numa::Pi<float>() * d + bias);
+
+				// 2) or
+				// data.Li = radiance / (d + bias);
+
+				// 3) or
+				data.Li = radiance / (d * d + bias);
+				// Point light is also a "delta" light source. We set pdf = 1.0f.
+				// See the explanation for the directional light above.
+				data.pdf = 1.0f;
+			} break;
+			case LightType::AREA: {
+				static constexpr float bias{0.00001f};
+
+				data.pos = frame.position;
+				data.Li = radiance;
+				data.pdf = 0.0f;
+				switch (shape) {
+					case GeometryType::CIRCLE: {
+						numa::Vec2 d = SampleDiskConcentric(u);
+						data.pos = frame.position + radius * (d.x * frame.right + d.y * frame.up);
+						data.pdf = AreaToSolidAnglePdf(p, data.pos, frame.forward, area);
+						data.pos += bias * frame.forward;
+					} break;
+					case GeometryType::PLANE: {
+						if (numa::Dot(p - corner, frame.forward) <= 0.0f)
+							break;
+						SphericalRectangle rectangle{p, corner, edgeX, edgeY};
+						if (rectangle.CanBeSampled()) {
+							data.pos = rectangle.Sample(u);
+							data.pdf = 1.0f / rectangle.solidAngle;
+						} else {
+							data.pos = corner + u.x * edgeX + u.y * edgeY;
+							data.pdf = AreaToSolidAnglePdf(p, data.pos, frame.forward, area);
+						}
+						data.pos += bias * frame.forward;
+					} break;
+					case GeometryType::SPHERE: {
+						numa::Vec3 toCenter = frame.position - p;
+						float sin2ThetaMax = radius * radius / numa::Dot(toCenter, toCenter);
+						numa::Vec3 n{0.0f};
+						if (sin2ThetaMax >= 1.0f) {
+							// Inside of the light, every direction sees it. Uniform over the area.
+							float z = 1.0f - 2.0f * u.x;
+							float r = std::sqrt(std::max(1.0f - z * z, 0.0f));
+							float phi = numa::TwoPi<float>() * u.y;
+							n = numa::Vec3{r * std::cos(phi), r * std::sin(phi), z};
+							data.pos = frame.position + radius * n;
+							data.pdf = AreaToSolidAnglePdf(p, data.pos, -n, area);
+						} else {
+							n = SampleSphereCone(toCenter, sin2ThetaMax, u);
+							data.pos = frame.position + radius * n;
+							data.pdf = SphereConePdf(sin2ThetaMax);
+						}
+						data.pos += bias * n;
+					} break;
+					default: {
+					} break;
+				}
+				data.wi = numa::Normalize(data.pos - p);
+				// Nothing to sample (e.g. the back of a quad), such samples don't contribute.
+				if (data.pdf <= 0.0f) {
+					data.Li = numa::Vec3{0.0f};
+					data.pdf = 1.0f;
+				}
+			} break;
+		}
 	}
-	numa::Vec3 DirectionalLight::Li() const {
-		return color * strength;
+
+	float LightRecord::Pdf(const numa::Vec3& p, const numa::Vec3& lightPoint) const {
+		if (lightType != LightType::AREA)
+			return 0.0f;
+		switch (shape) {
+			case GeometryType::CIRCLE: {
+				return AreaToSolidAnglePdf(p, lightPoint, frame.forward, area);
+			}
+			case GeometryType::PLANE: {
+				if (numa::Dot(p - corner, frame.forward) <= 0.0f)
+					return 0.0f;
+				SphericalRectangle rectangle{p, corner, edgeX, edgeY};
+				if (rectangle.CanBeSampled())
+					return 1.0f / rectangle.solidAngle;
+				return AreaToSolidAnglePdf(p, lightPoint, frame.forward, area);
+			}
+			case GeometryType::SPHERE: {
+				numa::Vec3 toCenter = frame.position - p;
+				float sin2ThetaMax = radius * radius / numa::Dot(toCenter, toCenter);
+				if (sin2ThetaMax >= 1.0f) {
+					numa::Vec3 n = numa::Normalize(lightPoint - frame.position);
+					return AreaToSolidAnglePdf(p, lightPoint, -n, area);
+				}
+				return SphereConePdf(sin2ThetaMax);
+			}
+			default: {
+			} break;
+		}
+		return 0.0f;
 	}
 
-	float DirectionalLight::pdf() const {
-		// Directional light source is a "delta" light source, meaning it can't exist in the real world.
-		// Instead, it is defined with the help of the delta function $\sigma$. That delta function
-		// "cancels" the integral, so the Monte Carlo estimator is not needed. In other words,
-		// we directly evaluate the integrand. To be consistent with the interface we've created, we set pdf = 1.0f.
-		return 1.0f;
+	numa::Vec3 LightRecord::EvaluatePerArea(const numa::Vec3& p, const numa::Vec3& lightPoint) const {
+		numa::Vec3 toPoint = p - lightPoint;
+		float distance2 = numa::Dot(toPoint, toPoint);
+		switch (lightType) {
+			case LightType::POINT: {
+				// Same as 'Sample'.
+				static constexpr float bias{0.00001f};
+
+				return radiance / (distance2 + bias);
+			}
+			case LightType::AREA: {
+				numa::Vec3 n = shape == GeometryType::SPHERE ? numa::Normalize(lightPoint - frame.position) : frame.forward;
+				float cosTheta = numa::Dot(toPoint, n) / std::sqrt(distance2);
+				if (cosTheta <= 0.0f)
+					return numa::Vec3{0.0f};
+				return radiance * (cosTheta / distance2);
+			}
+			default: {
+			} break;
+		}
+		return numa::Vec3{0.0f};
 	}
 
-	// Point light
+	// Light base class
 
-	PointLight::PointLight(const numa::Vec3& lightColor, float lightIntensity)
-		: Light(LightType::POINT), color(lightColor), intensity(lightIntensity) {
+	Light::Light(LightType type)
+		: Component(ComponentType::LIGHT), type(type) {
+		lightRecord.lightType = type;
+		lightRecord.light = this;
 	}
 
-	void PointLight::Sample(const numa::Vec3& p, const numa::Vec3& N, LightSampleData& data) {
-		data.wi = Wi(p);
-		data.pos = P();
-		data.Li = Li(numa::Length(p - data.pos));
-		data.pdf = pdf();
-		data.lightPtr = this;
+	void Light::Commit() {
+		std::shared_ptr<Actor> owner = ownerActor.lock();
+		lightRecord.frame = owner ? owner->GetFrame() : Frame{};
 	}
 
-	numa::Vec3 PointLight::P() const {
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return numa::Vec3{0.0f};
-		return transform->GetWorldPosition();
+	void Light::Sample(const numa::Vec3& p, const numa::Vec3& N, const numa::Vec2& u, LightSampleData& data) const {
+		lightRecord.Sample(p, N, u, data);
 	}
 
-	numa::Vec3 PointLight::Wi(const numa::Vec3& p) const {
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return numa::Vec3{0.0f, 1.0f, 0.0f};
-		const numa::Vec3& lightPos = transform->GetWorldPosition();
-		return numa::Normalize(lightPos - p);
+	LightType Light::GetLightType() const {
+		return type;
+	}
+	const LightRecord& Light::GetLightRecord() const {
+		return lightRecord;
 	}
-	numa::Vec3 PointLight::Li(float d) const {
-		// To avoid division by zero!
-		static constexpr float bias{0.00001f};
 
-		// 1) is it
-		// return (color * intensity) / (4.0f * numa::Pi<float>() * d + bias);
+	// Directional light
 
-		// 2) or
-		// return (color * intensity) / (d + bias);
+	DirectionalLight::DirectionalLight(const numa::Vec3& lightColor, float lightStrength)
+		: Light(LightType::DIRECTIONAL), color(lightColor), strength(lightStrength) {
+	}
 
-		// 3) or
-		return (color * intensity) / (d * d + bias);
+	void DirectionalLight::Commit() {
+		Light::Commit();
+		lightRecord.radiance = Li();
 	}
 
-	float PointLight::pdf() const {
-		// Point light is also a "delta" light source. We return pdf = 1.0f.
-		// See the explanation in DirectionLight's pdf() method.
-		return 1.0f;
+	numa::Vec3 DirectionalLight::Wi() const {
+		// The direction toward the light source, see 'LightRecord::Sample'.
+		return lightRecord.frame.forward;
+	}
+	numa::Vec3 DirectionalLight::Li() const {
+		return color * strength;
 	}
 
-	// Area light
+	// Point light
 
-	AreaLight::AreaLight(const numa::Vec3& lightColor, float lightIntensity)
-		: Light(LightType::AREA), color(lightColor), intensity(lightIntensity) {
+	PointLight::PointLight(const numa::Vec3& lightColor, float lightIntensity)
+		: Light(LightType::POINT), color(lightColor), intensity(lightIntensity) {
 	}
 
-	void AreaLight::Sample(const numa::Vec3& p, const numa::Vec3& N, LightSampleData& data) {
-		data.pos = P();
-		numa::Vec3 dP = data.pos - p; // Vector from the hit point to the area light sample
-		data.wi = numa::Normalize(dP);
-		data.Li = Li();
-		data.pdf = pdf(data.wi, N, numa::Length(dP));
-		data.lightPtr = this;
+	void PointLight::Commit() {
+		Light::Commit();
+		lightRecord.radiance = color * intensity;
 	}
 
-	numa::Vec3 AreaLight::P() const {
-		static constexpr float bias{0.00001f};
+	// Area light
 
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return numa::Vec3{0.0f};
-		numa::Vec3 right = transform->GetRightAxis();
-		numa::Vec3 up = transform->GetUpAxis();
-		numa::Vec3 forward = transform->GetForwardAxis();
+	AreaLight::AreaLight(const numa::Vec3& lightColor, float lightIntensity)
+		: Light(LightType::AREA), color(lightColor), intensity(lightIntensity) {
+	}
 
-		std::shared_ptr<Geometry> lightGeometry = ownerActor.lock()->GetComponent<Geometry>();
-		if (!lightGeometry) return numa::Vec3{0.0f};
-		numa::Vec3 sample{0.0f};
-		switch (lightGeometry->GetGeometryType()) {
+	void AreaLight::Commit() {
+		Light::Commit();
+		lightRecord.radiance = Li();
+		lightRecord.shape = GeometryType::COUNT;
+		std::shared_ptr<Actor> owner = ownerActor.lock();
+		std::shared_ptr<Geometry> lightGeometry = owner ? owner->GetComponent<Geometry>() : nullptr;
+		if (!lightGeometry)
+			return;
+		lightRecord.shape = lightGeometry->GetGeometryType();
+		const Frame& frame = lightRecord.frame;
+		switch (lightRecord.shape) {
 			case GeometryType::CIRCLE: {
-				// TODO
-				sample = transform->GetWorldPosition();
+				lightRecord.radius = static_cast<const Circle*>(lightGeometry.get())->GetRadius();
+				lightRecord.area = numa::Pi<float>() * lightRecord.radius * lightRecord.radius;
 			} break;
 			case GeometryType::PLANE: {
-				const Plane* planeGeometry = static_cast<const Plane*>(lightGeometry.get());
-				const numa::Vec2& planeDimensions = planeGeometry->GetDimensions();
-				float w = numa::RandomFloat(-planeDimensions.x / 2.0f, planeDimensions.x / 2.0f);
-				float h = numa::RandomFloat(-planeDimensions.y / 2.0f, planeDimensions.y / 2.0f);
-				sample = transform->GetWorldPosition() + w * right + h * up + bias * forward;
+				lightRecord.dimensions = static_cast<const Plane*>(lightGeometry.get())->GetDimensions();
+				lightRecord.edgeX = lightRecord.dimensions.x * frame.right;
+				lightRecord.edgeY = lightRecord.dimensions.y * frame.up;
+				lightRecord.corner = frame.position - 0.5f * lightRecord.edgeX - 0.5f * lightRecord.edgeY;
+				lightRecord.area = lightRecord.dimensions.x * lightRecord.dimensions.y;
 			} break;
 			case GeometryType::SPHERE: {
-				// TODO
-				sample = transform->GetWorldPosition();
+				lightRecord.radius = static_cast<const Sphere*>(lightGeometry.get())->GetRadius();
+				lightRecord.area = 2.0f * numa::TwoPi<float>() * lightRecord.radius * lightRecord.radius;
+			} break;
+			default: {
 			} break;
 		}
-		return sample;
 	}
 
 	numa::Vec3 AreaLight::Li() const {
 		return intensity * color;
 	}
 
-	float AreaLight::pdf(const numa::Vec3& wi, const numa::Vec3& N, float r) const {
-		// TODO: provide the formula and short description.
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return 1.0f;
-		std::shared_ptr<Geometry> lightGeometry = ownerActor.lock()->GetComponent<Geometry>();
-		switch (lightGeometry->GetGeometryType()) {
-			case GeometryType::CIRCLE: {
-				// TODO
-				return 1.0f;
-			}
-			case GeometryType::PLANE: {
-				numa::Vec3& planeNormal = transform->GetForwardAxis();
-				const Plane* planeGeometry = static_cast<const Plane*>(lightGeometry.get());
-
-				const numa::Vec2& planeDimensions = planeGeometry->GetDimensions();
-				float planeArea = planeDimensions.x * planeDimensions.y; // TODO: handle 'inf' properly!
-
-				float cosTheta = std::clamp(numa::Dot(-wi, planeNormal), 0.0f, 1.0f);
-				// float cosTheta = std::clamp(numa::Dot(wi, N), 0.0f, 1.0f);
-				return (r * r) / (cosTheta);
-			}
-			case GeometryType::SPHERE: {
-				// TODO
-				return 1.0f;
-			}
-			default: {
-				// TODO
-				return 1.0f;
-			}
-		}
-	}
 }
@@ -2,20 +2,38 @@
 
 #include "Numa.h"
 
+#include <cmath>
 #include <iostream>
 #include <utility>
 
 namespace aurora
 {
 	Dielectric::Dielectric(const numa::Vec3& attenuation, float ior)
-		: Material(MaterialType::DIELECTRIC), ior(ior)
+		: Material(MaterialType::DIELECTRIC), attenuation(attenuation), ior(ior)
 	{
 	}
 
-	numa::Vec3 Dielectric::Scatter(const numa::Vec3& wo, const numa::Vec3& N,
+	numa::Vec3 Dielectric::Scatter(const numa::Vec3& wo, const numa::Vec3& N, Sampler& sampler,
 			                       numa::Vec3& brdf, float& pdf) const {
-		// TODO
-		return numa::Vec3{0.0f, 1.0f, 0.0f};
+		// Only one of the reflected and refracted rays is followed, picked with the share of the light it carries.
+		// Weighted by that probability, the scattered ray's throughput reduces to the attenuation.
+		FresnelData fresnelData = RefractImpl1(-wo, N, 1.0f);
+		numa::Vec3 wi = fresnelData.reflected;
+		pdf = fresnelData.reflectedLightRatio;
+		if (sampler.Get1D() >= fresnelData.reflectedLightRatio) {
+			wi = fresnelData.refracted;
+			pdf = fresnelData.refractedLightRatio;
+		}
+		float cosTheta = std::abs(numa::Dot(wi, N));
+		brdf = cosTheta > 0.0f ? attenuation * (pdf / cosTheta) : numa::Vec3{0.0f};
+		return wi;
+	}
+	float Dielectric::Pdf(const numa::Vec3&, const numa::Vec3&, const numa::Vec3&) const {
+		// Only the two directions picked by 'Scatter' have any density.
+		return 0.0f;
+	}
+	bool Dielectric::IsSpecular() const {
+		return true;
 	}
 
 	FresnelData Dielectric::Fresnel(const numa::Vec3& incident, const numa::Vec3& normal, float ior) const
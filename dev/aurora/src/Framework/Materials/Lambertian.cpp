@@ -1,10 +1,6 @@
 #include "Framework/Materials/Lambertian.h"
 
-#include "Framework/Actor.h"
-#include "Framework/Components/Transform.h"
-
 #include "Numa.h"
-#include "Random.h"
 #include "Sample.h"
 
 #include <cmath>
@@ -18,12 +14,10 @@ namespace aurora {
 		: Material(MaterialType::LAMBERTIAN), albedo(albedo) {
 	}
 
-	numa::Vec3 Lambertian::Scatter(const numa::Vec3& wo, const numa::Vec3& N,
+	numa::Vec3 Lambertian::Scatter(const numa::Vec3& wo, const numa::Vec3& N, Sampler& sampler,
 		                           numa::Vec3& brdf, float& pdf) const {
-		std::shared_ptr<Transform> transform = ownerActor.lock()->GetComponent<Transform>();
-		if (!transform) return numa::Vec3{0.0f, 0.0f, 0.0f};
-		numa::Vec3 wiLocal = numa::SampleHemisphereCosWeight(numa::RandomVec2());
-		// numa::Vec3 wiLocal = numa::SampleHemisphereUniform(numa::RandomVec2());
+		numa::Vec3 wiLocal = numa::SampleHemisphereCosWeight(sampler.Get2D());
+		// numa::Vec3 wiLocal = numa::SampleHemisphereUniform(sampler.Get2D());
 		// Now we need to construct a TNB (or TBN) matrix to transform the local 'wi' direction into the world coordinates.
 		numa::Vec3 up = numa::Vec3{0.0f, 1.0f, 0.0f};
 		if (N.y > 0.995f)
@@ -40,6 +34,9 @@ namespace aurora {
 		pdf = Pdf(cosTheta);
 		return wiWorld;
 	}
+	float Lambertian::Pdf(const numa::Vec3&, const numa::Vec3& wi, const numa::Vec3& N) const {
+		return Pdf(std::max(numa::Dot(wi, N), 0.0f));
+	}
 
 	numa::Vec3 Lambertian::Brdf() const {
 		return albedo / numa::Pi<float>();
@@ -1,7 +1,6 @@
 #include "Framework/Materials/Metal.h"
 
 #include "Numa.h"
-#include "Random.h"
 
 namespace aurora {
 
@@ -12,13 +11,17 @@ namespace aurora {
 		: Material(MaterialType::METAL), attenuation(attenuation), fuzziness(fuzziness) {
 	}
 
-	numa::Vec3 Metal::Scatter(const numa::Vec3& wo, const numa::Vec3& N,
+	numa::Vec3 Metal::Scatter(const numa::Vec3& wo, const numa::Vec3& N, Sampler& sampler,
 			                  numa::Vec3& brdf, float& pdf) const {
 		// TODO
 		return numa::Vec3{0.0f, 1.0f, 0.0f};
 	}
+	float Metal::Pdf(const numa::Vec3&, const numa::Vec3&, const numa::Vec3&) const {
+		// Not sampled by 'Scatter' yet.
+		return 0.0f;
+	}
 
-	numa::Vec3 Metal::Reflect(const numa::Vec3& incidentDirection, const numa::Vec3& normal) const {
+	numa::Vec3 Metal::Reflect(const numa::Vec3& incidentDirection, const numa::Vec3& normal, Sampler& sampler) const {
 		numa::Vec3 reflectedDir =
 			incidentDirection -
 			2.0f * (numa::Dot(incidentDirection, normal)) * normal;
@@ -29,7 +32,10 @@ namespace aurora {
 
 		// Handle fuzziness
 
-		numa::Vec3 randomVec = numa::RandomVec3() * fuzziness;
+		float u0 = sampler.Get1D();
+		float u1 = sampler.Get1D();
+		float u2 = sampler.Get1D();
+		numa::Vec3 randomVec = numa::Vec3{u0, u1, u2} * fuzziness;
 		reflectedDir = numa::Normalize(reflectedDir + randomVec);
 
 		return reflectedDir;
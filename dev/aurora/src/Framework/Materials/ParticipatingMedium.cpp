@@ -13,11 +13,15 @@ namespace aurora {
 		sigma_a(sigma_a), sigma_s(sigma_s) {
 	}
 
-	numa::Vec3 ParticipatingMedium::Scatter(const numa::Vec3& wo, const numa::Vec3& N,
+	numa::Vec3 ParticipatingMedium::Scatter(const numa::Vec3& wo, const numa::Vec3& N, Sampler& sampler,
 			                                numa::Vec3& brdf, float& pdf) const {
 		// TODO
 		return numa::Vec3{0.0f, 1.0f, 0.0f};
 	}
+	float ParticipatingMedium::Pdf(const numa::Vec3&, const numa::Vec3&, const numa::Vec3&) const {
+		// Not sampled by 'Scatter' yet.
+		return 0.0f;
+	}
 
 	float ParticipatingMedium::EvaluateIsotropicPhaseFunction(float cosTheta) const {
 		// 1. Isotropic phase function
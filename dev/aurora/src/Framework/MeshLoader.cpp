@@ -0,0 +1,143 @@
+#include "Framework/MeshLoader.h"
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace aurora {
+
+	struct ObjVertexKey {
+		bool operator==(const ObjVertexKey& other) const {
+			return position == other.position && uv == other.uv && normal == other.normal;
+		}
+
+		// 0 means the attribute wasn't referenced.
+		uint32_t position{0};
+		uint32_t uv{0};
+		uint32_t normal{0};
+	};
+
+	struct ObjVertexKeyHash {
+		size_t operator()(const ObjVertexKey& key) const {
+			size_t hash = std::hash<uint32_t>{}(key.position);
+			hash ^= std::hash<uint32_t>{}(key.uv) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+			hash ^= std::hash<uint32_t>{}(key.normal) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+			return hash;
+		}
+	};
+
+	// OBJ indices are 1-based, negative values are relative to the end of the list.
+	static uint32_t ResolveObjIndex(long index, size_t attributeCount, size_t lineNumber) {
+		long resolved = index < 0 ? static_cast<long>(attributeCount) + index + 1 : index;
+		if (resolved <= 0 || resolved > static_cast<long>(attributeCount)) {
+			throw std::runtime_error{"OBJ index out of range on line " + std::to_string(lineNumber) + "!"};
+		}
+		return static_cast<uint32_t>(resolved);
+	}
+
+	static ObjVertexKey ParseObjFaceVertex(const std::string& token,
+	                                       size_t positionCount, size_t uvCount, size_t normalCount,
+	                                       size_t lineNumber) {
+		// Possible formats: 'v', 'v/vt', 'v//vn', 'v/vt/vn'.
+		ObjVertexKey key{};
+		size_t firstSlash = token.find('/');
+		key.position = ResolveObjIndex(std::stol(token.substr(0, firstSlash)), positionCount, lineNumber);
+		if (firstSlash == std::string::npos)
+			return key;
+		size_t secondSlash = token.find('/', firstSlash + 1);
+		std::string uvToken = token.substr(firstSlash + 1, secondSlash - firstSlash - 1);
+		if (!uvToken.empty())
+			key.uv = ResolveObjIndex(std::stol(uvToken), uvCount, lineNumber);
+		if (secondSlash != std::string::npos && secondSlash + 1 < token.size())
+			key.normal = ResolveObjIndex(std::stol(token.substr(secondSlash + 1)), normalCount, lineNumber);
+		return key;
+	}
+
+	std::shared_ptr<Mesh> LoadObjMesh(const std::filesystem::path& filePath) {
+		std::ifstream file{filePath};
+		if (!file.is_open()) {
+			throw std::runtime_error{"Couldn't open the OBJ file: " + filePath.generic_string()};
+		}
+
+		std::vector<numa::Vec3> objPositions;
+		std::vector<numa::Vec2> objUvs;
+		std::vector<numa::Vec3> objNormals;
+
+		std::vector<ObjVertexKey> vertexKeys;
+		std::unordered_map<ObjVertexKey, uint32_t, ObjVertexKeyHash> vertexLookup;
+		std::vector<uint32_t> indices;
+		// Attributes are only kept if every face vertex references them.
+		bool allVerticesHaveUvs{true};
+		bool allVerticesHaveNormals{true};
+
+		std::string line;
+		std::vector<uint32_t> faceVertices;
+		size_t lineNumber{0};
+		while (std::getline(file, line)) {
+			lineNumber++;
+			std::istringstream lineStream{line};
+			std::string keyword;
+			lineStream >> keyword;
+			if (keyword == "v") {
+				numa::Vec3 position{0.0f};
+				lineStream >> position.x >> position.y >> position.z;
+				objPositions.push_back(position);
+			} else if (keyword == "vt") {
+				numa::Vec2 uv{0.0f};
+				lineStream >> uv.x >> uv.y;
+				objUvs.push_back(uv);
+			} else if (keyword == "vn") {
+				numa::Vec3 normal{0.0f};
+				lineStream >> normal.x >> normal.y >> normal.z;
+				objNormals.push_back(normal);
+			} else if (keyword == "f") {
+				faceVertices.clear();
+				std::string token;
+				while (lineStream >> token) {
+					ObjVertexKey key = ParseObjFaceVertex(
+						token, objPositions.size(), objUvs.size(), objNormals.size(), lineNumber);
+					allVerticesHaveUvs = allVerticesHaveUvs && key.uv != 0;
+					allVerticesHaveNormals = allVerticesHaveNormals && key.normal != 0;
+					auto find = vertexLookup.find(key);
+					if (find == vertexLookup.end()) {
+						uint32_t vertexIdx = static_cast<uint32_t>(vertexKeys.size());
+						vertexKeys.push_back(key);
+						find = vertexLookup.emplace(key, vertexIdx).first;
+					}
+					faceVertices.push_back(find->second);
+				}
+				if (faceVertices.size() < 3) {
+					throw std::runtime_error{"OBJ face with less than 3 vertices on line " + std::to_string(lineNumber) + "!"};
+				}
+				for (size_t i = 1; i + 1 < faceVertices.size(); i++) {
+					indices.push_back(faceVertices[0]);
+					indices.push_back(faceVertices[i]);
+					indices.push_back(faceVertices[i + 1]);
+				}
+			}
+		}
+
+		std::vector<numa::Vec3> positions(vertexKeys.size());
+		std::vector<numa::Vec3> normals;
+		std::vector<numa::Vec2> uvs;
+		if (allVerticesHaveNormals)
+			normals.resize(vertexKeys.size());
+		if (allVerticesHaveUvs)
+			uvs.resize(vertexKeys.size());
+		for (size_t i = 0; i < vertexKeys.size(); i++) {
+			const ObjVertexKey& key = vertexKeys[i];
+			positions[i] = objPositions[key.position - 1];
+			if (allVerticesHaveNormals)
+				normals[i] = objNormals[key.normal - 1];
+			if (allVerticesHaveUvs)
+				uvs[i] = objUvs[key.uv - 1];
+		}
+
+		return std::make_shared<Mesh>(std::move(positions), std::move(normals), std::move(uvs), std::move(indices));
+	}
+
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Renderer/PathTracer.h"
+#include "Renderer/WavefrontPathTracer.h"
 
 #include "Framework/Actor.h"
 #include "Framework/Camera.h"
@@ -9,16 +10,35 @@
 #include "Framework/Gradient.h"
 
 #include "Numa.h"
-#include "Random.h"
 #include "Sample.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
+#include <limits>
 
 namespace aurora {
 
 	static constexpr float bias{0.00001f};
+	// Below this mean luminance, the adaptive sampler measures absolute instead of relative error, so that
+	// black pixels don't need an infinite number of samples to converge.
+	static constexpr float minAdaptiveLuminance{0.01f};
+
+	static float Luminance(const numa::Vec3& color) {
+		return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+	}
+
+	// Target of the resampled direct lighting: the unshadowed contribution of a light point at 'p', per unit area of the
+	// light, so that the picks of neighbouring pixels can be weighted at 'p' without a change of measure.
+	static float ReservoirTargetPdf(const LightRecord& lightRecord, const numa::Vec3& p, const numa::Vec3& n, const numa::Vec3& brdf,
+		const numa::Vec3& lightPoint) {
+		float cosTheta = numa::Dot(numa::Normalize(lightPoint - p), n);
+		if (cosTheta <= 0.0f)
+			return 0.0f;
+		return Luminance(brdf * lightRecord.EvaluatePerArea(p, lightPoint) * cosTheta);
+	}
 
 	void PathTracer::InitializePixelBuffer(uint32_t width, uint32_t height) {
 		pixelBuffer.reset();
@@ -58,102 +78,538 @@ namespace aurora {
 		uint32_t resolution_y = camera->GetCameraResolution_Y();
 
 		InitializePixelBuffer(resolution_x, resolution_y);
-		size_t pixelsToRender = static_cast<size_t>(resolution_x) * resolution_y;
-		for (uint32_t y = 0; y < resolution_y; y++) {
-			for (uint32_t x = 0; x < resolution_x; x++) {
-				RenderPixelLoop(x, y, *scene);
-			}
-			float progress = static_cast<float>(y + 1) / resolution_y;
+		uint32_t blockSize = GetLoopBlockSize();
+		for (uint32_t y = 0; y < resolution_y; y += blockSize) {
+			// A row of blocks at a time, see 'GetLoopBlockSize'.
+			ImageRegion rows{0, resolution_x, y, std::min(y + blockSize, resolution_y)};
+			RenderPixelsLoop(rows, *scene);
+			float progress = static_cast<float>(rows.raster_y_end) / resolution_y;
+			progress *= 100.0f;
+			std::clog << "\rProgress: " << progress << "%    " << std::flush;
+		}
+	}
+
+	void PathTracer::RenderSceneWavefront(std::shared_ptr<Scene> scene) {
+		// Bands of lines bound the size of the path queues.
+		static constexpr uint32_t bandHeight{16};
+
+		Camera* camera = scene->GetCamera();
+		uint32_t resolution_x = camera->GetCameraResolution_X();
+		uint32_t resolution_y = camera->GetCameraResolution_Y();
+
+		InitializePixelBuffer(resolution_x, resolution_y);
+		WavefrontPathTracer wavefront{sampleCount, rayDepthLimit, samplerType, russianRouletteDepth, misHeuristic};
+		for (uint32_t y = 0; y < resolution_y; y += bandHeight) {
+			ImageRegion band{};
+			band.raster_x_start = 0;
+			band.raster_x_end = resolution_x;
+			band.raster_y_start = y;
+			band.raster_y_end = std::min(y + bandHeight, resolution_y);
+			wavefront.Render(band, *scene, *pixelBuffer);
+			float progress = static_cast<float>(band.raster_y_end) / resolution_y;
 			progress *= 100.0f;
 			std::clog << "\rProgress: " << progress << "%    " << std::flush;
 		}
 	}
 
 	void PathTracer::RenderPixels(const ImageRegion& renderRegion, const Scene& scene) {
+		for (uint32_t y = renderRegion.raster_y_start; y < renderRegion.raster_y_end; y++) {
+			for (uint32_t x = renderRegion.raster_x_start; x < renderRegion.raster_x_end; x += RayPacket8::size) {
+				uint32_t pixelCount = std::min(RayPacket8::size, renderRegion.raster_x_end - x);
+				RenderPixelPacket(x, y, pixelCount, scene);
+			}
+		}
+	}
+	void PathTracer::RenderPixelsLoop(const ImageRegion& renderRegion, const Scene& scene) {
+		RenderPixelsLoop(renderRegion, scene, *pixelBuffer);
+	}
+	void PathTracer::RenderPixelsLoop(const ImageRegion& renderRegion, const Scene& scene, f32PixelBuffer& targetBuffer) const {
+		if (adaptiveSampling.enabled) {
+			RenderPixelsAdaptive(renderRegion, scene, targetBuffer);
+			return;
+		}
+		if (reservoirSampling.enabled) {
+			RenderPixelsReservoir(renderRegion, scene, targetBuffer);
+			return;
+		}
 		for (uint32_t y = renderRegion.raster_y_start; y < renderRegion.raster_y_end; y++) {
 			for (uint32_t x = renderRegion.raster_x_start; x < renderRegion.raster_x_end; x++) {
-				RenderPixel(x, y, scene);
+				targetBuffer.WritePixel(x, y, ComputePixelRadianceLoop(x, y, scene));
+			}
+		}
+	}
+	void PathTracer::ForEachLoopBlock(const ImageRegion& renderRegion, const std::function<void(const ImageRegion&)>& renderBlock) const {
+		uint32_t blockSize = GetLoopBlockSize();
+		auto nextBlockStart = [blockSize](uint32_t v) {
+			return (v / blockSize + 1) * blockSize;
+		};
+		ImageRegion blockRegion{};
+		for (uint32_t y = renderRegion.raster_y_start; y < renderRegion.raster_y_end; y = blockRegion.raster_y_end) {
+			blockRegion.raster_y_start = y;
+			blockRegion.raster_y_end = std::min(nextBlockStart(y), renderRegion.raster_y_end);
+			for (uint32_t x = renderRegion.raster_x_start; x < renderRegion.raster_x_end; x = blockRegion.raster_x_end) {
+				blockRegion.raster_x_start = x;
+				blockRegion.raster_x_end = std::min(nextBlockStart(x), renderRegion.raster_x_end);
+				renderBlock(blockRegion);
+			}
+		}
+	}
+	void PathTracer::RenderPixelsReservoir(const ImageRegion& renderRegion, const Scene& scene, f32PixelBuffer& targetBuffer) const {
+		ForEachLoopBlock(renderRegion, [&](const ImageRegion& blockRegion) {
+			RenderBlockReservoir(blockRegion, scene, targetBuffer);
+			});
+	}
+	void PathTracer::RenderBlockReservoir(const ImageRegion& blockRegion, const Scene& scene, f32PixelBuffer& targetBuffer) const {
+		// Neighbours within this cosine between normals and ratio between camera distances are similar enough to
+		// share their picks. It only depends on the geometry, so the estimate stays unbiased.
+		static constexpr float minNeighborNormalCos{0.9f};
+		static constexpr float maxNeighborDistanceRatio{0.1f};
+
+		// Camera vertex of a pixel, kept between the two passes.
+		struct CameraVertex {
+			Sampler sampler{};
+			numa::Vec3 p{0.0f};
+			numa::Vec3 n{0.0f};
+			numa::Vec3 wi{0.0f};
+			numa::Vec3 brdf{0.0f};
+			float pdf{1.0f};
+			float hitDistance{0.0f};
+			LightReservoir reservoir{};
+			bool valid{false};
+		};
+
+		Camera* sceneCamera = scene.GetCamera();
+		uint32_t regionWidth = blockRegion.raster_x_end - blockRegion.raster_x_start;
+		uint32_t regionHeight = blockRegion.raster_y_end - blockRegion.raster_y_start;
+		uint32_t pixelCount = regionWidth * regionHeight;
+		std::vector<CameraVertex> vertices(pixelCount);
+		std::vector<numa::Vec3> radiance(pixelCount, numa::Vec3{0.0f});
+		std::vector<uint32_t> neighbors;
+		neighbors.reserve(reservoirSampling.spatialNeighborCount);
+		LightSampleBundle lightBundle{};
+		for (int sample = 0; sample < sampleCount; sample++) {
+			// Camera vertices and their own reservoirs.
+			for (uint32_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
+				uint32_t x = blockRegion.raster_x_start + pixelIdx % regionWidth;
+				uint32_t y = blockRegion.raster_y_start + pixelIdx / regionWidth;
+				CameraVertex& vertex = vertices[pixelIdx];
+				vertex.valid = false;
+				vertex.sampler = Sampler{samplerType};
+				vertex.sampler.StartPixelSample(x, y, sample);
+				numa::Ray ray = sceneCamera->GenerateCameraRayJittered(x, y, vertex.sampler.Get2D());
+				ActorRayHit rayHit{};
+				if (!scene.IntersectClosest(ray, rayHit) || !rayHit.hitActor)
+					continue;
+				if (rayHit.hitLightIdx != invalidSceneIdx) {
+					// Lights are seen from both sides by the camera.
+					radiance[pixelIdx] += scene.GetLightRecord(rayHit.hitLightIdx).radiance;
+					continue;
+				}
+				const Material* material = scene.GetMaterial(rayHit.hitMaterialIdx);
+				if (!material)
+					continue;
+				if (material->IsSpecular()) {
+					// Nothing to resample on specular surfaces, their paths are followed right away.
+					radiance[pixelIdx] += TracePathLoop(ray, 0, numa::Vec3{1.0f}, 0.0f, numa::Vec3{0.0f}, scene, vertex.sampler, lightBundle);
+					continue;
+				}
+				vertex.n = rayHit.hitNormal;
+				vertex.p = rayHit.hitPoint + bias * rayHit.hitNormal;
+				vertex.hitDistance = rayHit.hitDistance;
+				vertex.wi = material->Scatter(-rayHit.hitRay.GetDirection(), vertex.n, vertex.sampler, vertex.brdf, vertex.pdf);
+				vertex.reservoir = SampleLightReservoir(vertex.p, vertex.n, vertex.brdf, scene, vertex.sampler);
+				vertex.valid = true;
+			}
+
+			// Spatial reuse, shadow rays and the rest of the paths.
+			for (uint32_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
+				CameraVertex& vertex = vertices[pixelIdx];
+				if (!vertex.valid)
+					continue;
+				Sampler& sampler = vertex.sampler;
+				int x = static_cast<int>(pixelIdx % regionWidth);
+				int y = static_cast<int>(pixelIdx / regionWidth);
+
+				// Neighbours are picked from the geometry only, before looking at their reservoirs.
+				neighbors.clear();
+				int radius = static_cast<int>(reservoirSampling.spatialRadius);
+				for (uint32_t i = 0; i < reservoirSampling.spatialNeighborCount; i++) {
+					numa::Vec2 u = sampler.Get2D();
+					int neighborX = std::clamp(x + static_cast<int>((2.0f * u.x - 1.0f) * (radius + 0.5f)), 0, static_cast<int>(regionWidth) - 1);
+					int neighborY = std::clamp(y + static_cast<int>((2.0f * u.y - 1.0f) * (radius + 0.5f)), 0, static_cast<int>(regionHeight) - 1);
+					uint32_t neighborIdx = static_cast<uint32_t>(neighborY) * regionWidth + static_cast<uint32_t>(neighborX);
+					const CameraVertex& neighbor = vertices[neighborIdx];
+					if (neighborIdx == pixelIdx || !neighbor.valid ||
+						numa::Dot(neighbor.n, vertex.n) < minNeighborNormalCos ||
+						std::abs(neighbor.hitDistance - vertex.hitDistance) > maxNeighborDistanceRatio * vertex.hitDistance)
+						continue;
+					if (std::find(neighbors.begin(), neighbors.end(), neighborIdx) == neighbors.end())
+						neighbors.push_back(neighborIdx);
+				}
+
+				// Every reservoir enters with its weight sum rescaled to this pixel's target.
+				LightReservoir reservoir{};
+				reservoir.Update(vertex.reservoir.lightSample, vertex.reservoir.targetPdf, vertex.reservoir.weightSum, sampler.Get1D());
+				reservoir.candidateCount = vertex.reservoir.candidateCount;
+				for (uint32_t neighborIdx : neighbors) {
+					const LightReservoir& neighborReservoir = vertices[neighborIdx].reservoir;
+					float weight{0.0f};
+					float targetPdf{0.0f};
+					if (neighborReservoir.targetPdf > 0.0f) {
+						const LightSampleData& lightSample = neighborReservoir.lightSample;
+						targetPdf = ReservoirTargetPdf(scene.GetLightRecord(lightSample.lightIdx), vertex.p, vertex.n, vertex.brdf, lightSample.pos);
+						weight = targetPdf * neighborReservoir.weightSum / neighborReservoir.targetPdf;
+					}
+					reservoir.Update(neighborReservoir.lightSample, targetPdf, weight, sampler.Get1D());
+					reservoir.candidateCount += neighborReservoir.candidateCount;
+				}
+				// Only the pixels for which the kept sample has a non-zero target could have produced it.
+				float normalization{0.0f};
+				if (reservoir.targetPdf > 0.0f) {
+					const LightSampleData& lightSample = reservoir.lightSample;
+					const LightRecord& lightRecord = scene.GetLightRecord(lightSample.lightIdx);
+					normalization = static_cast<float>(vertex.reservoir.candidateCount);
+					for (uint32_t neighborIdx : neighbors) {
+						const CameraVertex& neighbor = vertices[neighborIdx];
+						if (ReservoirTargetPdf(lightRecord, neighbor.p, neighbor.n, neighbor.brdf, lightSample.pos) > 0.0f)
+							normalization += static_cast<float>(neighbor.reservoir.candidateCount);
+					}
+				}
+				radiance[pixelIdx] += ShadeLightReservoir(reservoir, normalization, vertex.p, vertex.n, vertex.brdf, scene);
+				lightBundle.bundle.clear();
+				if (scene.IntersectUnboundedLights(vertex.p, vertex.n, sampler, lightBundle)) {
+					for (const LightSampleData& lightSample : lightBundle.bundle) {
+						float cosTheta = std::clamp(numa::Dot(lightSample.wi, vertex.n), 0.0f, 1.0f);
+						radiance[pixelIdx] += (vertex.brdf * lightSample.Li * cosTheta) / lightSample.pdf;
+					}
+				}
+
+				// Indirect lighting, the direct lighting above already covers the lights the scattered ray could hit.
+				float cosTheta = std::clamp(numa::Dot(vertex.n, vertex.wi), 0.0f, 1.0f);
+				numa::Vec3 throughput = (vertex.brdf * cosTheta) / vertex.pdf;
+				radiance[pixelIdx] += TracePathLoop(numa::Ray{vertex.p, vertex.wi}, 1, throughput, 0.0f, vertex.n, scene, sampler, lightBundle);
+			}
+		}
+
+		float scaleFactor = 1.0f / sampleCount;
+		for (uint32_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
+			uint32_t x = blockRegion.raster_x_start + pixelIdx % regionWidth;
+			uint32_t y = blockRegion.raster_y_start + pixelIdx / regionWidth;
+			targetBuffer.WritePixel(x, y, radiance[pixelIdx] * scaleFactor);
+		}
+	}
+	void PathTracer::RenderPixelsAdaptive(const ImageRegion& renderRegion, const Scene& scene, f32PixelBuffer& targetBuffer,
+		std::chrono::steady_clock::time_point deadline) const {
+		ForEachLoopBlock(renderRegion, [&](const ImageRegion& blockRegion) {
+			RenderBlockAdaptive(blockRegion, scene, targetBuffer, deadline);
+			});
+	}
+	void PathTracer::RenderBlockAdaptive(const ImageRegion& blockRegion, const Scene& scene, f32PixelBuffer& targetBuffer,
+		std::chrono::steady_clock::time_point deadline) const {
+		// Running estimate of one pixel. The error is measured on the luminance, its variance is
+		// updated with every sample (Welford's algorithm).
+		struct PixelEstimate {
+			numa::Vec3 radianceSum{0.0f};
+			float luminanceMean{0.0f};
+			float luminanceM2{0.0f};
+			float relativeError{0.0f};
+			int sampleCount{0};
+		};
+
+		uint32_t regionWidth = blockRegion.raster_x_end - blockRegion.raster_x_start;
+		uint32_t regionHeight = blockRegion.raster_y_end - blockRegion.raster_y_start;
+		size_t pixelCount = static_cast<size_t>(regionWidth) * regionHeight;
+		if (pixelCount == 0)
+			return;
+
+		// At least two samples, for a variance.
+		int minSamples = std::max(adaptiveSampling.minSampleCount, 2);
+		int maxSamples = std::max(adaptiveSampling.maxSampleCount, minSamples);
+		int batchSamples = std::max(adaptiveSampling.batchSampleCount, 1);
+		// Samples left for the rounds after the first one.
+		int64_t budgetLeft = std::numeric_limits<int64_t>::max();
+		if (adaptiveSampling.sampleBudget > 0.0f) {
+			budgetLeft = static_cast<int64_t>(adaptiveSampling.sampleBudget * pixelCount);
+			budgetLeft -= static_cast<int64_t>(minSamples) * pixelCount;
+		}
+
+		std::vector<PixelEstimate> estimates(pixelCount);
+		LightSampleBundle lightBundle{};
+		Sampler sampler{samplerType};
+		// Every pixel continues its own sequence, so the result doesn't depend on how the image was split.
+		auto addSamples = [&](size_t pixelIdx, int count) {
+			PixelEstimate& estimate = estimates[pixelIdx];
+			uint32_t x = blockRegion.raster_x_start + static_cast<uint32_t>(pixelIdx % regionWidth);
+			uint32_t y = blockRegion.raster_y_start + static_cast<uint32_t>(pixelIdx / regionWidth);
+			for (int sample = 0; sample < count; sample++) {
+				numa::Vec3 radiance = ComputeSampleRadianceLoop(x, y, estimate.sampleCount, scene, sampler, lightBundle);
+				estimate.radianceSum += radiance;
+				estimate.sampleCount++;
+				float luminance = Luminance(radiance);
+				float delta = luminance - estimate.luminanceMean;
+				estimate.luminanceMean += delta / estimate.sampleCount;
+				estimate.luminanceM2 += delta * (luminance - estimate.luminanceMean);
+			}
+			float variance = estimate.luminanceM2 / (estimate.sampleCount - 1);
+			float standardError = std::sqrt(variance / estimate.sampleCount);
+			estimate.relativeError = standardError / std::max(estimate.luminanceMean, minAdaptiveLuminance);
+		};
+
+		for (size_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
+			addSamples(pixelIdx, minSamples);
+		}
+
+		std::vector<size_t> noisyPixels;
+		noisyPixels.reserve(pixelCount);
+		while (budgetLeft >= batchSamples && std::chrono::steady_clock::now() < deadline) {
+			noisyPixels.clear();
+			for (size_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
+				const PixelEstimate& estimate = estimates[pixelIdx];
+				if (estimate.relativeError > adaptiveSampling.errorThreshold && estimate.sampleCount < maxSamples)
+					noisyPixels.push_back(pixelIdx);
+			}
+			if (noisyPixels.empty())
+				break;
+
+			// Not enough budget for all of them, the noisiest go first.
+			size_t affordablePixels = static_cast<size_t>(budgetLeft / batchSamples);
+			if (noisyPixels.size() > affordablePixels) {
+				auto noisier = [&estimates](size_t a, size_t b) {
+					if (estimates[a].relativeError != estimates[b].relativeError)
+						return estimates[a].relativeError > estimates[b].relativeError;
+					return a < b;
+				};
+				std::nth_element(noisyPixels.begin(), noisyPixels.begin() + affordablePixels, noisyPixels.end(), noisier);
+				noisyPixels.resize(affordablePixels);
+			}
+			for (size_t pixelIdx : noisyPixels) {
+				int count = std::min(batchSamples, maxSamples - estimates[pixelIdx].sampleCount);
+				addSamples(pixelIdx, count);
+				budgetLeft -= count;
+			}
+		}
+
+		for (size_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
+			const PixelEstimate& estimate = estimates[pixelIdx];
+			uint32_t x = blockRegion.raster_x_start + static_cast<uint32_t>(pixelIdx % regionWidth);
+			uint32_t y = blockRegion.raster_y_start + static_cast<uint32_t>(pixelIdx / regionWidth);
+			targetBuffer.WritePixel(x, y, estimate.radianceSum / static_cast<float>(estimate.sampleCount));
+		}
+	}
+	void PathTracer::RenderPixelPacket(uint32_t raster_coord_x, uint32_t raster_coord_y, uint32_t pixelCount, const Scene& scene) {
+		// Same estimator as 'RenderPixel', but the camera rays of neighbouring pixels are traced together.
+		Camera* sceneCamera = scene.GetCamera();
+		int samplesPerPixel = std::max(sampleCount, 1);
+		numa::Vec3 pixelColors[RayPacket8::size]{};
+		// Each lane's path draws from its own pixel's sequence.
+		Sampler samplers[RayPacket8::size]{};
+		for (Sampler& sampler : samplers) {
+			sampler = Sampler{samplerType};
+		}
+		for (int sample = 0; sample < samplesPerPixel; sample++) {
+			RayPacket8 packet{};
+			for (uint32_t lane = 0; lane < pixelCount; lane++) {
+				samplers[lane].StartPixelSample(raster_coord_x + lane, raster_coord_y, sample);
+				packet.SetRay(lane, sceneCamera->GenerateCameraRayJittered(raster_coord_x + lane, raster_coord_y, samplers[lane].Get2D()));
+			}
+			packet.Finalize();
+
+			HitRecord hits[RayPacket8::size]{};
+			uint32_t hitMask = scene.IntersectClosest8(packet, hits);
+			for (uint32_t lane = 0; lane < pixelCount; lane++) {
+				numa::Ray ray = packet.GetRay(lane);
+				ActorRayHit rayHit{};
+				if (hitMask & (1u << lane))
+					scene.ComputeSurfaceInteraction(ray, hits[lane], rayHit);
+				pixelColors[lane] += ShadeRayHit(ray, rayHit, scene, numa::Vec3{1.0f}, 0, samplers[lane]);
 			}
 		}
+		float scaleFactor = 1.0f / samplesPerPixel;
+		for (uint32_t lane = 0; lane < pixelCount; lane++) {
+			pixelBuffer->WritePixel(raster_coord_x + lane, raster_coord_y, pixelColors[lane] * scaleFactor);
+		}
 	}
 	void PathTracer::RenderPixel(uint32_t raster_coord_x, uint32_t raster_coord_y, const Scene& scene) {
 		Camera* sceneCamera = scene.GetCamera();
 		int rayDepth{0};
 		numa::Vec3 pixelColor{0.0f};
+		Sampler sampler{samplerType};
 		if (sampleCount > 1) {
 			for (int sample = 0; sample < sampleCount; sample++) {
-				numa::Ray ray = sceneCamera->GenerateCameraRayJittered(raster_coord_x, raster_coord_y);
-				pixelColor += ComputeColor(ray, scene, rayDepth);
+				sampler.StartPixelSample(raster_coord_x, raster_coord_y, sample);
+				numa::Ray ray = sceneCamera->GenerateCameraRayJittered(raster_coord_x, raster_coord_y, sampler.Get2D());
+				pixelColor += ComputeColor(ray, scene, numa::Vec3{1.0f}, rayDepth, sampler);
 			}
 			float scaleFactor = 1.0f / sampleCount;
 			pixelColor *= scaleFactor;
 		} else {
-			numa::Ray ray = sceneCamera->GenerateCameraRayJittered(raster_coord_x, raster_coord_y);
-			pixelColor = ComputeColor(ray, scene, rayDepth);
+			sampler.StartPixelSample(raster_coord_x, raster_coord_y, 0);
+			numa::Ray ray = sceneCamera->GenerateCameraRayJittered(raster_coord_x, raster_coord_y, sampler.Get2D());
+			pixelColor = ComputeColor(ray, scene, numa::Vec3{1.0f}, rayDepth, sampler);
 		}
 		pixelBuffer->WritePixel(raster_coord_x, raster_coord_y, pixelColor);
 	}
 
 	void PathTracer::RenderPixelLoop(uint32_t raster_coord_x, uint32_t raster_coord_y, const Scene& scene) {
-		Camera* sceneCamera = scene.GetCamera();
+		pixelBuffer->WritePixel(raster_coord_x, raster_coord_y, ComputePixelRadianceLoop(raster_coord_x, raster_coord_y, scene));
+	}
+	numa::Vec3 PathTracer::ComputePixelRadianceLoop(uint32_t raster_coord_x, uint32_t raster_coord_y, const Scene& scene) const {
 		numa::Vec3 radiance{0.0f};
+		// Reused by every sample and bounce, so that the workers don't contend on the heap for a new one each time.
+		LightSampleBundle lightBundle{};
+		Sampler sampler{samplerType};
 		for (int sample = 0; sample < sampleCount; sample++) {
-			numa::Ray ray = sceneCamera->GenerateCameraRayJittered(raster_coord_x, raster_coord_y);
-			numa::Vec3 throughput{1.0f};
-			for (int rayDepth = 0; rayDepth < rayDepthLimit; rayDepth++) {
-				ActorRayHit rayHit{};
-				if (scene.IntersectClosest(ray, rayHit) && rayHit.hitActor) {
-					// Check if we hit a light source.
-					if (rayHit.hitActor->GetComponent<Light>()) {
-						std::shared_ptr<Light> light = rayHit.hitActor->GetComponent<Light>();
-						// If 'rayDepth != 0' then we have already counted this contribution as part of the NEE.
-						if (rayDepth == 0) {
-							LightSampleData lightSampleData{};
-							light->Sample(rayHit.hitPoint, rayHit.hitNormal, lightSampleData);
-							radiance += lightSampleData.Li;
-							// radiance = numa::Vec3{1.0f, 0.0f, 0.0f} * 10.0f;
-						}
-						break;
+			radiance += ComputeSampleRadianceLoop(raster_coord_x, raster_coord_y, sample, scene, sampler, lightBundle);
+		}
+		float scaleFactor = 1.0f / sampleCount;
+		radiance *= scaleFactor;
+		return radiance;
+	}
+	numa::Vec3 PathTracer::ComputeSampleRadianceLoop(uint32_t raster_coord_x, uint32_t raster_coord_y, uint32_t sampleIdx, const Scene& scene,
+		Sampler& sampler, LightSampleBundle& lightBundle) const {
+		Camera* sceneCamera = scene.GetCamera();
+		sampler.StartPixelSample(raster_coord_x, raster_coord_y, sampleIdx);
+		numa::Ray ray = sceneCamera->GenerateCameraRayJittered(raster_coord_x, raster_coord_y, sampler.Get2D());
+		return TracePathLoop(ray, 0, numa::Vec3{1.0f}, 0.0f, numa::Vec3{0.0f}, scene, sampler, lightBundle);
+	}
+	numa::Vec3 PathTracer::TracePathLoop(numa::Ray ray, int firstRayDepth, numa::Vec3 throughput, float scatterPdf, numa::Vec3 scatterNormal,
+		const Scene& scene, Sampler& sampler, LightSampleBundle& lightBundle) const {
+		numa::Vec3 radiance{0.0f};
+		bool specularBounce{false};
+		for (int rayDepth = firstRayDepth; rayDepth < rayDepthLimit; rayDepth++) {
+			if (rayDepth >= russianRouletteDepth) {
+				float survival = RussianRouletteSurvival(throughput);
+				if (sampler.Get1D() >= survival)
+					break;
+				throughput /= survival;
+			}
+			ActorRayHit rayHit{};
+			if (scene.IntersectClosest(ray, rayHit) && rayHit.hitActor) {
+				// Check if we hit a light source.
+				if (rayHit.hitLightIdx != invalidSceneIdx) {
+					const LightRecord& lightRecord = scene.GetLightRecord(rayHit.hitLightIdx);
+					if (rayDepth == 0) {
+						// Lights are seen from both sides by the camera.
+						radiance += lightRecord.radiance;
+						// radiance = numa::Vec3{1.0f, 0.0f, 0.0f} * 10.0f;
+					} else if (specularBounce) {
+						// No light sample could have found this light, it's seen like by the camera.
+						radiance += throughput * lightRecord.radiance;
+					} else if (scatterPdf > 0.0f) {
+						// The NEE of the previous bounce could have picked this point too, both estimates are weighted.
+						// A pdf of 0 means NEE couldn't have picked the light from there, it's seen from behind.
+						float lightPdf = scene.LightPdf(ray.GetOrigin(), scatterNormal, rayHit.hitLightIdx, rayHit.hitPoint);
+						if (lightPdf > 0.0f)
+							radiance += throughput * lightRecord.radiance * MisWeight(misHeuristic, scatterPdf, lightPdf);
 					}
+					break;
+				}
 
-					// Extract hit data.
-					numa::Vec3 wo = -rayHit.hitRay.GetDirection();
-					numa::Vec3 n = rayHit.hitNormal;
-					numa::Vec3 hitPoint = rayHit.hitPoint + bias * rayHit.hitNormal;
-
-					std::shared_ptr<Material> material = rayHit.hitActor->GetComponent<Material>();
-					if (!material) break;
-					numa::Vec3 brdf{1.0f};
-					float pdf{1.0f};
-					numa::Vec3 wi = material->Scatter(wo, n, brdf, pdf);
-					
-					// Next Event Estimation (NEE)
-					LightSampleBundle lightBundle{};
-					if (scene.IntersectLights(hitPoint, n, lightBundle)) {
-						for (const LightSampleData& lightSample : lightBundle.bundle) {
-							float cosTheta = std::clamp(numa::Dot(lightSample.wi, n), 0.0f, 1.0f);
-							radiance += throughput * (brdf * lightSample.Li * cosTheta) / lightSample.pdf;
-						}
-					}
-					
-					// Indirect lighting.
-					float cosTheta = std::clamp(numa::Dot(n, wi), 0.0f, 1.0f);
-					throughput *= (brdf * cosTheta) / pdf;
-					ray = numa::Ray{hitPoint, wi};
-				} else {
-					// Missed, use the background color
-					// or the atmosphere color if the scene has one.
-					// radiance += throughput * BackgroundColor(ray);
-					// radiance += throughput * numa::Vec3{0.05f, 0.05f, 0.05f};
-					// radiance = numa::Vec3{0.0f};
-					// radiance = numa::Vec3{0.0,1.0f,0.0f} * 10.0f;
+				// Extract hit data.
+				numa::Vec3 wo = -rayHit.hitRay.GetDirection();
+				numa::Vec3 n = rayHit.hitNormal;
+				numa::Vec3 hitPoint = rayHit.hitPoint + bias * rayHit.hitNormal;
+
+				const Material* material = scene.GetMaterial(rayHit.hitMaterialIdx);
+				if (!material) break;
+				numa::Vec3 brdf{1.0f};
+				float pdf{1.0f};
+				numa::Vec3 wi = material->Scatter(wo, n, sampler, brdf, pdf);
+				specularBounce = material->IsSpecular();
+				
+				// Next Event Estimation (NEE)
+				if (!specularBounce)
+					radiance += throughput * EstimateDirectLighting(hitPoint, n, wo, brdf, *material, scene, sampler, lightBundle);
+				
+				// Indirect lighting.
+				if (pdf <= 0.0f)
 					break;
+				float cosTheta = specularBounce ? std::abs(numa::Dot(n, wi)) : std::clamp(numa::Dot(n, wi), 0.0f, 1.0f);
+				throughput *= (brdf * cosTheta) / pdf;
+				// Resampled direct lighting has no MIS, it already covers the lights the scattered ray could hit.
+				scatterPdf = reservoirSampling.enabled ? 0.0f : material->Pdf(wo, wi, n);
+				scatterNormal = n;
+				// Refracted rays continue from the other side of the surface.
+				if (numa::Dot(n, wi) < 0.0f)
+					hitPoint = rayHit.hitPoint - bias * n;
+				ray = numa::Ray{hitPoint, wi};
+			} else {
+				// Missed, use the background color
+				// or the atmosphere color if the scene has one.
+				// radiance += throughput * BackgroundColor(ray);
+				// radiance += throughput * numa::Vec3{0.05f, 0.05f, 0.05f};
+				// radiance = numa::Vec3{0.0f};
+				// radiance = numa::Vec3{0.0,1.0f,0.0f} * 10.0f;
+				break;
+			}
+		}
+		return radiance;
+	}
+
+	numa::Vec3 PathTracer::EstimateDirectLighting(const numa::Vec3& p, const numa::Vec3& n, const numa::Vec3& wo, const numa::Vec3& brdf,
+		const Material& material, const Scene& scene, Sampler& sampler, LightSampleBundle& lightBundle) const {
+		numa::Vec3 radiance{0.0f};
+		lightBundle.bundle.clear();
+		if (reservoirSampling.enabled) {
+			LightReservoir reservoir = SampleLightReservoir(p, n, brdf, scene, sampler);
+			radiance += ShadeLightReservoir(reservoir, static_cast<float>(reservoir.candidateCount), p, n, brdf, scene);
+			// Delta lights the BVH doesn't hold aren't resampled, they keep their own shadow rays.
+			if (scene.IntersectUnboundedLights(p, n, sampler, lightBundle)) {
+				for (const LightSampleData& lightSample : lightBundle.bundle) {
+					float cosTheta = std::clamp(numa::Dot(lightSample.wi, n), 0.0f, 1.0f);
+					radiance += (brdf * lightSample.Li * cosTheta) / lightSample.pdf;
 				}
 			}
+			return radiance;
 		}
-		float scaleFactor = 1.0f / sampleCount;
-		radiance *= scaleFactor;
-		pixelBuffer->WritePixel(raster_coord_x, raster_coord_y, radiance);
+		if (scene.IntersectLights(p, n, sampler, lightBundle)) {
+			for (const LightSampleData& lightSample : lightBundle.bundle) {
+				float cosTheta = std::clamp(numa::Dot(lightSample.wi, n), 0.0f, 1.0f);
+				// Delta lights can't be hit by scattered rays, their samples keep all of the weight.
+				float misWeight{1.0f};
+				if (lightSample.lightPtr && lightSample.lightPtr->GetLightType() == LightType::AREA) {
+					float materialPdf = material.Pdf(wo, lightSample.wi, n);
+					misWeight = MisWeight(misHeuristic, lightSample.pdf, materialPdf);
+				}
+				radiance += (brdf * lightSample.Li * cosTheta) * (misWeight / lightSample.pdf);
+			}
+		}
+		return radiance;
+	}
+	LightReservoir PathTracer::SampleLightReservoir(const numa::Vec3& p, const numa::Vec3& n, const numa::Vec3& brdf, const Scene& scene,
+		Sampler& sampler) const {
+		LightReservoir reservoir{};
+		for (uint32_t i = 0; i < reservoirSampling.candidateCount; i++) {
+			// Failed picks still count as candidates, they are part of the density the others were drawn with.
+			reservoir.candidateCount++;
+			LightSampleData lightSample{};
+			float u = sampler.Get1D();
+			if (!scene.SampleBoundedLight(p, n, sampler, lightSample))
+				continue;
+			float cosTheta = numa::Dot(lightSample.wi, n);
+			if (cosTheta <= 0.0f)
+				continue;
+			// The candidate's weight is its contribution over its density, the same ratio per unit solid angle
+			// (as sampled) as per unit area (as the target pdf).
+			float weight = Luminance(brdf * lightSample.Li * cosTheta) / lightSample.pdf;
+			float targetPdf = ReservoirTargetPdf(scene.GetLightRecord(lightSample.lightIdx), p, n, brdf, lightSample.pos);
+			reservoir.Update(lightSample, targetPdf, targetPdf > 0.0f ? weight : 0.0f, u);
+		}
+		return reservoir;
+	}
+	numa::Vec3 PathTracer::ShadeLightReservoir(const LightReservoir& reservoir, float normalization, const numa::Vec3& p, const numa::Vec3& n,
+		const numa::Vec3& brdf, const Scene& scene) const {
+		if (reservoir.targetPdf <= 0.0f || normalization <= 0.0f)
+			return numa::Vec3{0.0f};
+		const LightSampleData& lightSample = reservoir.lightSample;
+		numa::Vec3 toLight = lightSample.pos - p;
+		float distance = numa::Length(toLight);
+		numa::Vec3 wi = toLight / distance;
+		if (scene.Occluded(numa::Ray{p, wi}, 0.0f, distance))
+			return numa::Vec3{0.0f};
+		float cosTheta = std::clamp(numa::Dot(wi, n), 0.0f, 1.0f);
+		float weight = reservoir.weightSum / (normalization * reservoir.targetPdf);
+		return brdf * scene.GetLightRecord(lightSample.lightIdx).EvaluatePerArea(p, lightSample.pos) * cosTheta * weight;
 	}
 
 	void PathTracer::ToneMapReinhardtRGB() {
@@ -169,23 +625,25 @@ namespace aurora {
 	}
 	void PathTracer::ToneMapReinhardtLuminance()
 	{
-		uint32_t resolution_x = pixelBuffer->GetWidth();
-		uint32_t resolution_y = pixelBuffer->GetHeight();
-
+		ImageRegion wholeImage{0, pixelBuffer->GetWidth(), 0, pixelBuffer->GetHeight()};
+		ToneMapReinhardtLuminance(*pixelBuffer, wholeImage);
+	}
+	void PathTracer::ToneMapReinhardtLuminance(f32PixelBuffer& pixels, const ImageRegion& region)
+	{
 		// Normalize pixel values
 
-		for (uint32_t y = 0; y < resolution_y; y++)
+		for (uint32_t y = region.raster_y_start; y < region.raster_y_end; y++)
 		{
-			for (uint32_t x = 0; x < resolution_x; x++)
+			for (uint32_t x = region.raster_x_start; x < region.raster_x_end; x++)
 			{
-				numa::Vec3 Cin = pixelBuffer->GetPixelValue(x, y);
+				numa::Vec3 Cin = pixels.GetPixelValue(x, y);
 
 				float Lin = 0.2126f * Cin.r + 0.7152f * Cin.g + 0.0722f * Cin.b;
 				float Lout = Lin / (1.0f + Lin);
 
 				numa::Vec3 Cout = Cin * (Lout / Lin);
 
-				pixelBuffer->WritePixel(x, y, Cout);
+				pixels.WritePixel(x, y, Cout);
 			}
 		}
 	}
@@ -221,18 +679,32 @@ namespace aurora {
 	}
 
 	void PathTracer::GammaCorrectPower12() {
-		uint32_t resolution_x = pixelBuffer->GetWidth();
-		uint32_t resolution_y = pixelBuffer->GetHeight();
+		ImageRegion wholeImage{0, pixelBuffer->GetWidth(), 0, pixelBuffer->GetHeight()};
+		GammaCorrectPower12(*pixelBuffer, wholeImage);
+	}
+	void PathTracer::GammaCorrectPower12(f32PixelBuffer& pixels, const ImageRegion& region) {
 		// Normalize pixel values
-		for (uint32_t y = 0; y < resolution_y; y++) {
-			for (uint32_t x = 0; x < resolution_x; x++) {
-				numa::Vec3& radiance = pixelBuffer->GetPixelValue(x, y);
+		for (uint32_t y = region.raster_y_start; y < region.raster_y_end; y++) {
+			for (uint32_t x = region.raster_x_start; x < region.raster_x_end; x++) {
+				numa::Vec3& radiance = pixels.GetPixelValue(x, y);
 				// radiance = numa::Pow(radiance, 0.5f);
 				// radiance = numa::Pow(radiance, 1.0f / 2.2f);
 				radiance = numa::Sqrt(radiance);
 			}
 		}
 	}
+	void PathTracer::Quantize(const f32PixelBuffer& pixels, const ImageRegion& region, u8PixelBuffer& output) {
+		for (uint32_t y = region.raster_y_start; y < region.raster_y_end; y++) {
+			for (uint32_t x = region.raster_x_start; x < region.raster_x_end; x++) {
+				numa::Vec3 clampedPixel = numa::Clamp(pixels.GetPixelValue(x, y), numa::Vec3(0.0f), numa::Vec3(1.0f));
+				output.WritePixel(x, y, numa::u8Vec3{
+					static_cast<uint8_t>(clampedPixel.r * 255.0f),
+					static_cast<uint8_t>(clampedPixel.g * 255.0f),
+					static_cast<uint8_t>(clampedPixel.b * 255.0f)
+				});
+			}
+		}
+	}
 
 	numa::Vec3 PathTracer::BackgroundColor(const numa::Ray& ray) {
 		Gradient skyGradient{
@@ -244,23 +716,33 @@ namespace aurora {
 		return bgColor;
 	}
 
-	numa::Vec3 PathTracer::ComputeColor(const numa::Ray& ray, const Scene& scene, int rayDepth) {
-		numa::Vec3 pixelColor{0.0f, 0.0f, 0.0f};
+	numa::Vec3 PathTracer::ComputeColor(const numa::Ray& ray, const Scene& scene, const numa::Vec3& throughput, int rayDepth, Sampler& sampler) {
 		if (rayDepth > rayDepthLimit)
 			return numa::Vec3{0.0f, 0.0f, 0.0f};
+		float survival{1.0f};
+		if (rayDepth >= russianRouletteDepth) {
+			survival = RussianRouletteSurvival(throughput);
+			if (sampler.Get1D() >= survival)
+				return numa::Vec3{0.0f, 0.0f, 0.0f};
+		}
 		ActorRayHit rayHit{};
-		if (scene.IntersectClosest(ray, rayHit) && rayHit.hitActor) {
+		scene.IntersectClosest(ray, rayHit);
+		return ShadeRayHit(ray, rayHit, scene, throughput / survival, rayDepth, sampler) / survival;
+	}
+	numa::Vec3 PathTracer::ShadeRayHit(const numa::Ray& ray, const ActorRayHit& rayHit, const Scene& scene, const numa::Vec3& throughput, int rayDepth, Sampler& sampler) {
+		numa::Vec3 pixelColor{0.0f, 0.0f, 0.0f};
+		if (rayHit.hit && rayHit.hitActor) {
 			// Hit something, use this object's color
-			std::shared_ptr<Material> material = rayHit.hitActor->GetComponent<Material>();
+			const Material* material = scene.GetMaterial(rayHit.hitMaterialIdx);
 			if (!material) return numa::Vec3{0.0f, 0.0f, 0.0f};
-			pixelColor = ShadeMaterial(rayHit, scene, rayDepth);
+			pixelColor = ShadeMaterial(rayHit, scene, throughput, rayDepth, sampler);
 		} else {
 			// Missed, use the background color
 			// or the atmosphere color if the scene has one.
 			Atmosphere* atmosphere = scene.GetAtmosphere();
 			DirectionalLight* dirLight = scene.GetDirectionalLight();
 			if (atmosphere && dirLight) {
-				pixelColor = atmosphere->ComputeSkyColor(ray, dirLight);
+				pixelColor = atmosphere->ComputeSkyColor(ray, dirLight, sampler);
 			} else {
 				pixelColor = BackgroundColor(ray);
 			}
@@ -269,39 +751,39 @@ namespace aurora {
 		return pixelColor;
 	}
 
-	numa::Vec3 PathTracer::ShadeMaterial(const ActorRayHit& rayHit, const Scene& scene, int rayDepth) {
+	numa::Vec3 PathTracer::ShadeMaterial(const ActorRayHit& rayHit, const Scene& scene, const numa::Vec3& throughput, int rayDepth, Sampler& sampler) {
 		numa::Vec3 pixelColor{0.0f, 0.0f, 0.0f};
-		std::shared_ptr<Material> material = rayHit.hitActor->GetComponent<Material>();
+		const Material* material = scene.GetMaterial(rayHit.hitMaterialIdx);
 		if (!material) return numa::Vec3{0.0f, 0.0f, 0.0f};
 
 		switch (material->GetMaterialType()) {
 			case MaterialType::LAMBERTIAN: {
-				Lambertian* lambertianMat = static_cast<Lambertian*>(material.get());
-				pixelColor = ShadeLambertian(rayHit, scene, lambertianMat, rayDepth);
+				const Lambertian* lambertianMat = static_cast<const Lambertian*>(material);
+				pixelColor = ShadeLambertian(rayHit, scene, lambertianMat, throughput, rayDepth, sampler);
 			}
 			break;
 			case MaterialType::METAL: {
-				Metal* metalMat = static_cast<Metal*>(material.get());
-				pixelColor = ShadeMetal(rayHit, scene, metalMat, rayDepth);
+				const Metal* metalMat = static_cast<const Metal*>(material);
+				pixelColor = ShadeMetal(rayHit, scene, metalMat, throughput, rayDepth, sampler);
 			}
 			break;
 			case MaterialType::DIELECTRIC: {
-				Dielectric* dielectricMat = static_cast<Dielectric*>(material.get());
-				pixelColor = ShadeDielectric(rayHit, scene, dielectricMat, rayDepth);
+				const Dielectric* dielectricMat = static_cast<const Dielectric*>(material);
+				pixelColor = ShadeDielectric(rayHit, scene, dielectricMat, throughput, rayDepth, sampler);
 			}
 			break;
 			case MaterialType::PARTICIPATING_MEDIUM: {
-				ParticipatingMedium* medium = static_cast<ParticipatingMedium*>(material.get());
+				const ParticipatingMedium* medium = static_cast<const ParticipatingMedium*>(material);
 				if (!rayHit.hitFrontFace) {
 					// We're inside the volume
 					ActorRayHit insideMediumRayHit = rayHit;
 					insideMediumRayHit.hitPoint = rayHit.hitRay.GetOrigin();
 					insideMediumRayHit.hitNormal = numa::Vec3{ 0.0f };
-					pixelColor = ShadeParticipatingMedium(insideMediumRayHit, scene, medium, rayDepth);
+					pixelColor = ShadeParticipatingMedium(insideMediumRayHit, scene, medium, throughput, rayDepth, sampler);
 				}
 				else {
 					// We're outside the volume
-					pixelColor = ShadeParticipatingMedium(rayHit, scene, medium, rayDepth);
+					pixelColor = ShadeParticipatingMedium(rayHit, scene, medium, throughput, rayDepth, sampler);
 				}
 			}
 			break;
@@ -313,7 +795,7 @@ namespace aurora {
 
 		return pixelColor;
 	}
-	numa::Vec3 PathTracer::ShadeLambertian(const ActorRayHit& rayHit, const Scene& scene, const Lambertian* lambertian, int rayDepth) {
+	numa::Vec3 PathTracer::ShadeLambertian(const ActorRayHit& rayHit, const Scene& scene, const Lambertian* lambertian, const numa::Vec3& throughput, int rayDepth, Sampler& sampler) {
 		numa::Vec3 albedo = lambertian->GetMaterialAlbedo();
 		numa::Vec3 wo = -rayHit.hitRay.GetDirection();
 		numa::Vec3 n = rayHit.hitNormal;
@@ -364,14 +846,13 @@ namespace aurora {
 		if (atmosphere) {
 			DirectionalLight* dirLight = scene.GetDirectionalLight();
 			numa::Ray lightRay{hitPoint, dirLight->Wi()};
-			ActorRayHit anyHit{};
-			if (!scene.IntersectClosest(lightRay, anyHit)) {
+			if (!scene.Occluded(lightRay, 0.0f, std::numeric_limits<float>::infinity())) {
 				// The light is reachable.
 				Lo += brdf * atmosphere->GetSunlight(hitPoint, dirLight) * numa::Dot(dirLight->Wi(), n);
 			}
 		} else {
 			LightSampleBundle lightBundle{};
-			scene.IntersectLights(hitPoint, n, lightBundle);
+			scene.IntersectLights(hitPoint, n, sampler, lightBundle);
 			for (const LightSampleData& lightSample : lightBundle.bundle) {
 				// The equation is actually $Lo = (c_diff / pi) * pi * c_light * cos(theta)$, which
 				// simplifies to $Lo = c_diff * c_light * cos(theta)$
@@ -382,7 +863,11 @@ namespace aurora {
 
 		// 4.2 Indirect lighting
 
-		numa::Vec3 wi = rayHit.hitNormal + numa::RandomInUnitCube();
+		// Uniform in the [-1, 1]^3 cube.
+		float u0 = sampler.Get1D();
+		float u1 = sampler.Get1D();
+		float u2 = sampler.Get1D();
+		numa::Vec3 wi = rayHit.hitNormal + numa::Vec3{2.0f * u0 - 1.0f, 2.0f * u1 - 1.0f, 2.0f * u2 - 1.0f};
 		if (numa::Length2(wi) < 1e-10)
 			wi = rayHit.hitNormal;
 		else
@@ -390,79 +875,40 @@ namespace aurora {
 
 		numa::Ray scatteredRay{hitPoint, wi};
 		float cosTheta = numa::Dot(n, wi);
-		Lo += brdf * ComputeColor(scatteredRay, scene, ++rayDepth) * cosTheta;
+		Lo += brdf * ComputeColor(scatteredRay, scene, throughput * brdf * cosTheta, ++rayDepth, sampler) * cosTheta;
 		return Lo;
 	}
-	numa::Vec3 PathTracer::ShadeMetal(const ActorRayHit& rayHit, const Scene& scene, const Metal* metal, int rayDepth)
+	numa::Vec3 PathTracer::ShadeMetal(const ActorRayHit& rayHit, const Scene& scene, const Metal* metal, const numa::Vec3& throughput, int rayDepth, Sampler& sampler)
 	{
 		numa::Vec3 attenuation = metal->GetAttenuation();
 
 		numa::Vec3 hitPoint = rayHit.hitPoint + bias * rayHit.hitNormal;
 
-		numa::Vec3 reflectedDir = metal->Reflect(rayHit.hitRay.GetDirection(), rayHit.hitNormal);
+		numa::Vec3 reflectedDir = metal->Reflect(rayHit.hitRay.GetDirection(), rayHit.hitNormal, sampler);
 
 		numa::Ray reflectedRay{ hitPoint, reflectedDir };
-		numa::Vec3 color = attenuation * ComputeColor(reflectedRay, scene, ++rayDepth);
+		numa::Vec3 color = attenuation * ComputeColor(reflectedRay, scene, throughput * attenuation, ++rayDepth, sampler);
 		return color;
 	}
-	numa::Vec3 PathTracer::ShadeDielectric(const ActorRayHit& rayHit, const Scene& scene, const Dielectric* dielectric, int rayDepth)
+	numa::Vec3 PathTracer::ShadeDielectric(const ActorRayHit& rayHit, const Scene& scene, const Dielectric* dielectric, const numa::Vec3& throughput, int rayDepth, Sampler& sampler)
 	{
-		// Wait, what value for the ior parameter should I provide to the function?
-		FresnelData fresnelData = dielectric->Fresnel(rayHit.hitRay.GetDirection(), rayHit.hitNormal, 1.0f);
-		// Should we somehow remember this somewhere? 'RayHit' probably?
-
-		// numa::Vec3 pointToShade = rayHit.hitRay.GetPoint(rayHit.hitDistance);
-		numa::Vec3 pointToShade = rayHit.hitPoint;
-		numa::Vec3 pointToShadeR = numa::Vec3{ 0.0f };
-		numa::Vec3 pointToShadeT = numa::Vec3{ 0.0f };
-
-		// glm::vec3 pointToShadeR = rayHit.hitRay.GetPoint(rayHit.hitDistanceClose) + Ray::defaultBias * rayHit.hitNormal;
-		// glm::vec3 pointToShadeT = rayHit.hitRay.GetPoint(rayHit.hitDistanceClose) - Ray::defaultBias * rayHit.hitNormal;
-
-		// glm::vec3 pointToShadeR = rayHit.hitRay.GetPoint(rayHit.hitDistanceClose);
-		// glm::vec3 pointToShadeT = rayHit.hitRay.GetPoint(rayHit.hitDistanceClose);
-
-		numa::Vec3 attenuation = dielectric->GetAttenuation();
-		numa::Vec3 color{ 0.0f, 0.0f, 0.0f };
-
-		float rayDir_dot_hitNorm = numa::Dot(rayHit.hitRay.GetDirection(), rayHit.hitNormal);
-		if (rayDir_dot_hitNorm < 0.0f) // We're entering the object!
-		{
-			// Ray reflectedRay{ pointToShadeR, fresnelData.reflected };
-			// color += fresnelData.reflectedLightRatio * ComputeColor(reflectedRay, ++rayDepth, scene) * attenuation;
-
-			// That's what the Fresnel() method does internally
-			// Here we just have to avoid "waisting" rayDepth for computing reflected color.
-			// 
-			// fresnelData.reflectedLightRatio = 0.0f;
-			// fresnelData.refractedLightRatio = 1.0f;
-
-			pointToShadeR = pointToShade + bias * rayHit.hitNormal;
-			pointToShadeT = pointToShade - bias * rayHit.hitNormal;
-
-			// Ray reflectedRay{ pointToShadeR, fresnelData.reflected };
-			// color += fresnelData.reflectedLightRatio * ComputeColor(reflectedRay, ++rayDepth, scene) * attenuation;
-		}
-		else // We're leaving the object!
-		{
-			pointToShadeR = pointToShade - bias * rayHit.hitNormal;
-			pointToShadeT = pointToShade + bias * rayHit.hitNormal;
-		}
-
-		// Ray reflectedRay{ pointToShade, fresnelData.reflected };
-		numa::Ray reflectedRay{ pointToShadeR, fresnelData.reflected };
-		color += fresnelData.reflectedLightRatio * ComputeColor(reflectedRay, scene, rayDepth + 1) * attenuation;
-
-		// Ray refractedRay{ pointToShade, fresnelData.refracted };
-		numa::Ray refractedRay{ pointToShadeT, fresnelData.refracted };
-		color += fresnelData.refractedLightRatio * ComputeColor(refractedRay, scene, rayDepth + 1) * attenuation;
+		// Following both the reflected and the refracted rays doubles the work at every bounce inside the object,
+		// 'Scatter' picks one of them with the Fresnel ratios instead.
+		numa::Vec3 brdf{1.0f};
+		float pdf{1.0f};
+		numa::Vec3 wi = dielectric->Scatter(-rayHit.hitRay.GetDirection(), rayHit.hitNormal, sampler, brdf, pdf);
+		if (pdf <= 0.0f)
+			return numa::Vec3{0.0f, 0.0f, 0.0f};
 
-		// Less accurate (inaccurate) because we waste all the depth available for reflected rays.
-		// color += fresnelData.refractedLightRatio * ComputeColor(refractedRay, ++rayDepth, scene) * attenuation;
+		// The refracted ray leaves from the other side of the surface.
+		float cosTheta = numa::Dot(wi, rayHit.hitNormal);
+		numa::Vec3 pointToShade = rayHit.hitPoint + (cosTheta < 0.0f ? -bias : bias) * rayHit.hitNormal;
 
-		return color;
+		numa::Vec3 weight = brdf * std::abs(cosTheta) / pdf;
+		numa::Ray scatteredRay{ pointToShade, wi };
+		return weight * ComputeColor(scatteredRay, scene, throughput * weight, rayDepth + 1, sampler);
 	}
-	numa::Vec3 PathTracer::ShadeParticipatingMedium(const ActorRayHit& rayHit, const Scene& scene, const ParticipatingMedium* medium, int rayDepth) {
+	numa::Vec3 PathTracer::ShadeParticipatingMedium(const ActorRayHit& rayHit, const Scene& scene, const ParticipatingMedium* medium, const numa::Vec3& throughput, int rayDepth, Sampler& sampler) {
 		// Biases and other utilities.
 		// Try using values that are multiples of the 'bias' static variable, such as  1e2 * bias; 1e5 * bias;
 		// It's easier to alter just the single 'bias' variable to make sure that all the other biases are updated too.
@@ -496,7 +942,7 @@ namespace aurora {
 				numa::Vec3{camRayExitPointHit.hitPoint + volumeRayBias * camRayExitPointHit.hitNormal},
 				numa::Vec3{camRayExitPointHit.hitRay.GetDirection()}
 			};
-			return ComputeColor(behindVolumeRay, scene, rayDepth);
+			return ComputeColor(behindVolumeRay, scene, throughput, rayDepth, sampler);
 		}
 
 		// [TODO]: again, need to think about relaxing the assumption that there are no actors inside the volume.
@@ -538,11 +984,11 @@ namespace aurora {
 			Tr *= segment_Tr;
 			// Compute the in scattering contribution from all the scene's lights.
 			numa::Vec3 Ls{0.0f};
-			for (auto& light : scene.GetLights()) {
+			for (const LightRecord& lightRecord : scene.GetLightRecords()) {
 				// Sample the light, retrieving all the necessary information we need about it.
 				// This includes light direction 'wi', radiance 'Li', and light's position 'p'.
 				LightSampleData lightSampleData{};
-				light->Sample(p_prime, numa::Vec3{0.0f} /* not used! */, lightSampleData);
+				lightRecord.Sample(p_prime, numa::Vec3{0.0f} /* not used! */, sampler.Get2D(), lightSampleData);
 				// Now we need to make sure that there's nothing in our way to reach the light.
 				// Again, the assumption is that there's nothing inside the volume, thus
 				// the only objects obstructing the view can be outside the medium.
@@ -581,8 +1027,8 @@ namespace aurora {
 					lightEntryPoint, // the bias was applied earlier in case no intersection occurred
 					lightSampleData.wi
 				};
-				ActorRayHit occludingActorHit{};
-				if (scene.IntersectClosest(shadowRay, occludingActorHit))
+				float shadowRayLength = ComputeShadowRayLength(lightEntryPoint, lightSampleData);
+				if (scene.Occluded(shadowRay, 0.0f, shadowRayLength))
 					continue; // something is occluding the view from the light source, so we just move on to the next light
 
 				// Nothing is occluding the view from the light source,
@@ -657,7 +1103,7 @@ namespace aurora {
 			numa::Vec3{camRayExitPointHit.hitPoint + bias * camRayExitPointHit.hitNormal},
 			numa::Vec3{camRayExitPointHit.hitRay.GetDirection()}
 		};
-		numa::Vec3 L0 = ComputeColor(behindVolumeRay, scene, ++rayDepth);
+		numa::Vec3 L0 = ComputeColor(behindVolumeRay, scene, throughput * Tr, ++rayDepth, sampler);
 
 		// Lo = Tr * L0 + (1.0f - Tr) * medium->GetMediumColor();
 		// Lo *= dt; // but then don't forget to get rid of the 'dt' where the in scattering contribution is computed.
@@ -674,53 +1120,292 @@ namespace aurora {
 		return pixelBuffer.get();
 	}
 
+	void PathTracer::SetSamplerType(SamplerType samplerType) {
+		this->samplerType = samplerType;
+	}
+	SamplerType PathTracer::GetSamplerType() const {
+		return samplerType;
+	}
+
+	void PathTracer::SetRayDepthLimit(int rayDepthLimit) {
+		this->rayDepthLimit = rayDepthLimit;
+	}
+	int PathTracer::GetRayDepthLimit() const {
+		return rayDepthLimit;
+	}
+	void PathTracer::SetRussianRouletteDepth(int russianRouletteDepth) {
+		assert(russianRouletteDepth > 0 && "Camera rays can't be terminated by the Russian roulette!");
+		this->russianRouletteDepth = russianRouletteDepth;
+	}
+	int PathTracer::GetRussianRouletteDepth() const {
+		return russianRouletteDepth;
+	}
+
+	void PathTracer::SetMisHeuristic(MisHeuristic misHeuristic) {
+		this->misHeuristic = misHeuristic;
+	}
+	MisHeuristic PathTracer::GetMisHeuristic() const {
+		return misHeuristic;
+	}
+
+	void PathTracer::SetAdaptiveSampling(const AdaptiveSamplingSettings& adaptiveSampling) {
+		assert(adaptiveSampling.minSampleCount > 0 && adaptiveSampling.batchSampleCount > 0 && "Adaptive sample counts must be positive!");
+		this->adaptiveSampling = adaptiveSampling;
+	}
+	const AdaptiveSamplingSettings& PathTracer::GetAdaptiveSampling() const {
+		return adaptiveSampling;
+	}
+
+	void PathTracer::SetReservoirSampling(const ReservoirSamplingSettings& reservoirSampling) {
+		this->reservoirSampling = reservoirSampling;
+	}
+	const ReservoirSamplingSettings& PathTracer::GetReservoirSampling() const {
+		return reservoirSampling;
+	}
+	uint32_t PathTracer::GetLoopBlockSize() const {
+		// Adaptive sampling takes over from the spatial reuse when both are enabled, see 'RenderPixelsLoop'.
+		if (adaptiveSampling.enabled)
+			return std::max(adaptiveSampling.blockSize, 1u);
+		if (reservoirSampling.enabled)
+			return std::max(reservoirSampling.tileSize, 1u);
+		return 1;
+	}
+
 	// SceneRenderingJob class
 
-	SceneRenderingJob::SceneRenderingJob(PathTracer* pathTracer, Scene* scene)
-		: pathTracer(pathTracer), scene(scene) {
+	// RenderCostMap class
+
+	RenderCostMap::RenderCostMap(uint32_t width, uint32_t height)
+		: width(width), height(height), pixelCosts(static_cast<size_t>(width) * height, 0.0f) {
+	}
+
+	void RenderCostMap::Record(const ImageRegion& region, double seconds) {
+		size_t pixelCount = static_cast<size_t>(region.raster_x_end - region.raster_x_start) * (region.raster_y_end - region.raster_y_start);
+		if (pixelCount == 0)
+			return;
+		float pixelCost = static_cast<float>(seconds / pixelCount);
+		for (uint32_t y = region.raster_y_start; y < region.raster_y_end; y++) {
+			float* row = pixelCosts.data() + static_cast<size_t>(y) * width;
+			std::fill(row + region.raster_x_start, row + region.raster_x_end, pixelCost);
+		}
+		hasCosts.store(true, std::memory_order_relaxed);
+	}
+	double RenderCostMap::Estimate(const ImageRegion& region) const {
+		double cost{0.0};
+		for (uint32_t y = region.raster_y_start; y < region.raster_y_end; y++) {
+			const float* row = pixelCosts.data() + static_cast<size_t>(y) * width;
+			for (uint32_t x = region.raster_x_start; x < region.raster_x_end; x++) {
+				cost += row[x];
+			}
+		}
+		return cost;
+	}
+	double RenderCostMap::GetTotalCost() const {
+		return Estimate(ImageRegion{0, width, 0, height});
+	}
+	bool RenderCostMap::HasCosts() const {
+		return hasCosts.load(std::memory_order_relaxed);
+	}
+
+	uint32_t RenderCostMap::GetWidth() const {
+		return width;
+	}
+	uint32_t RenderCostMap::GetHeight() const {
+		return height;
+	}
+
+	// SceneRenderingJob class
+
+	// Pre-split tiles are never smaller than this on either side.
+	static constexpr uint32_t minCostSplitSize{8};
+	// Tiles expected to cost more than this many times the average tile are pre-split.
+	static constexpr double costSplitFactor{2.0};
+	// Tasks split while rendering keep at least this many rows.
+	static constexpr uint32_t minSplitRowCount{2};
+
+	// Moves a task bound back to the start of its block (see 'PathTracer::GetLoopBlockSize'), the image edge stays put.
+	// Every bound moves the same way, so the tasks still cover the image, some of them may end up empty.
+	static uint32_t SnapToBlock(uint32_t bound, uint32_t imageEdge, uint32_t blockSize) {
+		if (bound >= imageEdge)
+			return imageEdge;
+		return bound / blockSize * blockSize;
+	}
+
+	static ImageRegion GetTaskRegion(const SceneRenderingTask& renderingTask) {
+		ImageRegion region{};
+		region.raster_x_start = renderingTask.raster_x_start;
+		region.raster_x_end = renderingTask.raster_x_end;
+		region.raster_y_start = renderingTask.raster_y_start;
+		region.raster_y_end = renderingTask.raster_y_end;
+		return region;
+	}
+
+	SceneRenderingJob::SceneRenderingJob(PathTracer* pathTracer, Scene* scene, uint32_t tileSize, TileOrder tileOrder)
+		: pathTracer(pathTracer), scene(scene), tileSize(tileSize), tileOrder(tileOrder) {
+		assert(tileSize > 0 && "Tile size must be at least 1 pixel!");
 		InitializeRenderingTasks();
 	}
 
 	void SceneRenderingJob::OnStart() {
 		Job::OnStart();
 
-		Camera* camera = scene->GetCamera();
-		uint32_t imageWidth = camera->GetCameraResolution_X();
-		uint32_t imageHeight = camera->GetCameraResolution_Y();
-		pathTracer->InitializePixelBuffer(imageWidth, imageHeight);
+		pixelBuffer = std::make_shared<f32PixelBuffer>(imageWidth, imageHeight);
+		if (imageWriter) {
+			outputBuffer = std::make_shared<u8PixelBuffer>(imageWidth, imageHeight);
+			imageWriter->BeginImage(imageWidth, imageHeight);
+		}
+
+		renderDeadline = std::chrono::steady_clock::time_point::max();
+		const AdaptiveSamplingSettings& adaptiveSampling = pathTracer->GetAdaptiveSampling();
+		if (adaptiveSampling.enabled && adaptiveSampling.timeBudget > 0.0) {
+			auto timeBudget = std::chrono::duration<double>{adaptiveSampling.timeBudget};
+			renderDeadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeBudget);
+		}
 
 		std::clog << "Rendering scene '" << scene->GetSceneName() << "'...\n";
 	}
 	void SceneRenderingJob::OnEnd() {
 		Job::OnEnd();
-		std::clog << "\nDone rendering scene! Tasks finished: " << tasksDone << " out of " << tasksToDo << "\n";
+		if (imageWriter)
+			imageWriter->EndImage();
+		std::clog << "\nDone rendering scene '" << scene->GetSceneName() << "'! Tasks finished: " << tasksDone << " out of " << tasksToDo << "\n";
 	}
 
-	bool SceneRenderingJob::DoWork() {
-		// Acquire rendering task
-		SceneRenderingTask renderingTask{};
-		if (!AcquireRenderingTask(renderingTask)) {
-			return false;
+	void SceneRenderingJob::CreateTasks(std::vector<Task*>& tasks) {
+		// The tasks of the previous pass may have been split, start again from the tiles.
+		renderingTasks.clear();
+		splitTasks.clear();
+		if (costMap->HasCosts()) {
+			double maxCost = costSplitFactor * costMap->GetTotalCost() / tiles.size();
+			for (const SceneRenderingTask& tile : tiles) {
+				SplitCostlyRenderingTask(tile, maxCost);
+			}
+		} else {
+			renderingTasks = tiles;
+		}
+		// Whole blocks only, so that their pixels get the same samples however the image was split.
+		uint32_t blockSize = pathTracer->GetLoopBlockSize();
+		if (blockSize > 1) {
+			for (SceneRenderingTask& renderingTask : renderingTasks) {
+				renderingTask.raster_x_start = SnapToBlock(renderingTask.raster_x_start, imageWidth, blockSize);
+				renderingTask.raster_x_end = SnapToBlock(renderingTask.raster_x_end, imageWidth, blockSize);
+				renderingTask.raster_y_start = SnapToBlock(renderingTask.raster_y_start, imageHeight, blockSize);
+				renderingTask.raster_y_end = SnapToBlock(renderingTask.raster_y_end, imageHeight, blockSize);
+			}
+			auto isEmpty = [](const SceneRenderingTask& renderingTask) {
+				return renderingTask.raster_x_start == renderingTask.raster_x_end || renderingTask.raster_y_start == renderingTask.raster_y_end;
+				};
+			renderingTasks.erase(std::remove_if(renderingTasks.begin(), renderingTasks.end(), isEmpty), renderingTasks.end());
+		}
+
+		for (SceneRenderingTask& renderingTask : renderingTasks) {
+			renderingTask.stage = TileStage::RENDER;
+			tasks.push_back(&renderingTask);
+		}
+		tasksToDo = static_cast<uint32_t>(renderingTasks.size());
+		tasksDone = 0;
+		donePercentage = 0.0;
+	}
+	void SceneRenderingJob::ExecuteTask(Task& task) {
+		SceneRenderingTask& renderingTask = static_cast<SceneRenderingTask&>(task);
+
+		switch (renderingTask.stage) {
+		case TileStage::RENDER:
+			RenderTile(renderingTask);
+			NotifyRenderingTaskFinished(renderingTask);
+			if (!imageWriter)
+				return;
+			renderingTask.stage = TileStage::TONE_MAP;
+			break;
+		case TileStage::TONE_MAP:
+			PathTracer::ToneMapReinhardtLuminance(*pixelBuffer, GetTaskRegion(renderingTask));
+			PathTracer::GammaCorrectPower12(*pixelBuffer, GetTaskRegion(renderingTask));
+			renderingTask.stage = TileStage::QUANTIZE;
+			break;
+		case TileStage::QUANTIZE:
+			PathTracer::Quantize(*pixelBuffer, GetTaskRegion(renderingTask), *outputBuffer);
+			renderingTask.stage = TileStage::WRITE;
+			break;
+		case TileStage::WRITE:
+			imageWriter->WriteRegion(*outputBuffer,
+				renderingTask.raster_x_start, renderingTask.raster_x_end,
+				renderingTask.raster_y_start, renderingTask.raster_y_end);
+			return;
+		}
+		// Continuation, nothing of the task may be touched after this.
+		Spawn(&renderingTask);
+	}
+
+	void SceneRenderingJob::RenderTile(SceneRenderingTask& renderingTask) {
+		ImageRegion rowRegion{};
+		rowRegion.raster_x_start = renderingTask.raster_x_start;
+		rowRegion.raster_x_end = renderingTask.raster_x_end;
+		// A row of blocks at a time (see 'PathTracer::GetLoopBlockSize'), the task is only ever split between two of them.
+		uint32_t blockSize = pathTracer->GetLoopBlockSize();
+		uint32_t y = renderingTask.raster_y_start;
+		while (y < renderingTask.raster_y_end) {
+			uint32_t rowsLeft = renderingTask.raster_y_end - y;
+			uint32_t splitY = (y + rowsLeft / 2) / blockSize * blockSize;
+			if (rowsLeft >= 2 * minSplitRowCount && splitY > y && HasIdleWorkers()) {
+				SceneRenderingTask* splitTask{nullptr};
+				{
+					std::lock_guard<std::mutex> lock{splitTaskMutex};
+					splitTask = &splitTasks.emplace_back(renderingTask);
+				}
+				splitTask->raster_y_start = splitY;
+				renderingTask.raster_y_end = splitTask->raster_y_start;
+				tasksToDo++;
+				Spawn(splitTask);
+			}
+
+			rowRegion.raster_y_start = y;
+			rowRegion.raster_y_end = std::min((y / blockSize + 1) * blockSize, renderingTask.raster_y_end);
+			y = rowRegion.raster_y_end;
+			auto rowStart = std::chrono::steady_clock::now();
+			if (pathTracer->GetAdaptiveSampling().enabled) {
+				pathTracer->RenderPixelsAdaptive(rowRegion, *scene, *pixelBuffer, renderDeadline);
+			} else {
+				pathTracer->RenderPixelsLoop(rowRegion, *scene, *pixelBuffer);
+			}
+			std::chrono::duration<double> rowTime = std::chrono::steady_clock::now() - rowStart;
+			costMap->Record(rowRegion, rowTime.count());
+		}
+	}
+
+	void SceneRenderingJob::SplitCostlyRenderingTask(const SceneRenderingTask& tile, double maxCost) {
+		uint32_t tileWidth = tile.raster_x_end - tile.raster_x_start;
+		uint32_t tileHeight = tile.raster_y_end - tile.raster_y_start;
+		uint32_t longestSide = std::max(tileWidth, tileHeight);
+		if (longestSide < 2 * minCostSplitSize || costMap->Estimate(GetTaskRegion(tile)) <= maxCost) {
+			renderingTasks.push_back(tile);
+			return;
 		}
-		// Do the work
-		ImageRegion renderRegion{};
-		renderRegion.raster_x_start = renderingTask.raster_x_start;
-		renderRegion.raster_x_end = renderingTask.raster_x_end;
-		renderRegion.raster_y_start = renderingTask.raster_y_start;
-		renderRegion.raster_y_end = renderingTask.raster_y_end;
-		pathTracer->RenderPixels(renderRegion, *scene);
+		// Halves of the longest side, in the same order as the tiles, so that they stay next to each other.
+		SceneRenderingTask first = tile;
+		SceneRenderingTask second = tile;
+		if (tileWidth == longestSide) {
+			first.raster_x_end = second.raster_x_start = tile.raster_x_start + tileWidth / 2;
+		} else {
+			first.raster_y_end = second.raster_y_start = tile.raster_y_start + tileHeight / 2;
+		}
+		SplitCostlyRenderingTask(first, maxCost);
+		SplitCostlyRenderingTask(second, maxCost);
+	}
+
+	void SceneRenderingJob::SetImageWriter(std::shared_ptr<PpmImageWriter> imageWriter) {
+		this->imageWriter = imageWriter;
+	}
 
-		NotifyRenderingTaskFinished(renderingTask);
-		return true;
+	const f32PixelBuffer* SceneRenderingJob::GetPixelBuffer() const {
+		return pixelBuffer.get();
 	}
 
-	bool SceneRenderingJob::AcquireRenderingTask(SceneRenderingTask& renderingTask) {
-		std::lock_guard<std::mutex> lock{renderingTaskMutex};
-		if (renderingTasks.empty())
-			return false;
-		renderingTask = renderingTasks.top();
-		renderingTasks.pop();
-		return true;
+	std::shared_ptr<RenderCostMap> SceneRenderingJob::GetCostMap() const {
+		return costMap;
+	}
+	void SceneRenderingJob::SetCostMap(std::shared_ptr<RenderCostMap> costMap) {
+		assert(costMap && costMap->GetWidth() == imageWidth && costMap->GetHeight() == imageHeight && "Cost map doesn't match the image!");
+		this->costMap = costMap;
 	}
 
 	void SceneRenderingJob::NotifyRenderingTaskFinished(const SceneRenderingTask& renderingTask) {
@@ -734,28 +1419,29 @@ namespace aurora {
 		float taskPercentage = static_cast<float>(pixelsRendered) / renderingJobPixels;
 		donePercentage += taskPercentage;
 		std::clog << "\rProgress: " << std::setprecision(3) << donePercentage * 100.0f << "%   ";
-
-		std::lock_guard<std::mutex> lockTask{renderingTaskMutex};
-		// if (renderingTasks.empty())
-			// End();
+		// The task manager ends the job once its last task has returned.
 		tasksDone++;
-		if (tasksDone == tasksToDo)
-			End();
 	}
 
 	void SceneRenderingJob::InitializeRenderingTasks() {
-		std::lock_guard<std::mutex> lock{renderingTaskMutex};
-
 		Camera* camera = scene->GetCamera();
 		this->imageWidth = camera->GetCameraResolution_X();
 		this->imageHeight = camera->GetCameraResolution_Y();
 
+		// The split only depends on the image, not on the number of workers.
+
 		// 1. Line Rendering Tasks
-		this->lineCount = 10; // 108 tasks for 1080 lines
-		CreateLineRenderingTasks(imageWidth, imageHeight, lineCount);
+		// this->lineCount = 2; // 540 tasks for 1080 lines
+		// CreateLineRenderingTasks(imageWidth, imageHeight, lineCount);
 
+		// 2. Square Rendering Tasks
+		CreateSquareRenderingTasks(imageWidth, imageHeight, tileSize);
+
+		tiles = renderingTasks;
 		tasksToDo = static_cast<uint32_t>(renderingTasks.size());
 		tasksDone = 0;
+
+		costMap = std::make_shared<RenderCostMap>(imageWidth, imageHeight);
 	}
 
 	void SceneRenderingJob::CreateLineRenderingTasks(uint32_t width, uint32_t height, uint32_t lineCount)
@@ -771,7 +1457,7 @@ namespace aurora {
 			renderingTask.raster_y_start = taskIdx * lineCount;
 			renderingTask.raster_y_end = renderingTask.raster_y_start + lineCount;
 
-			renderingTasks.push(renderingTask);
+			renderingTasks.push_back(renderingTask);
 		}
 
 		// Everything left (if any)
@@ -786,16 +1472,104 @@ namespace aurora {
 				renderingTask.raster_y_start,
 				height);
 
-		renderingTasks.push(renderingTask);
+		renderingTasks.push_back(renderingTask);
 	}
 	void SceneRenderingJob::CreateLineRenderingTask(uint32_t taskIdx, uint32_t lineCount)
 	{
 		// TODO
 	}
 
+	// Spreads the lower 16 bits of 'v' so that there's a zero bit between each of them.
+	static uint32_t SpreadBits(uint32_t v) {
+		v &= 0x0000FFFFu;
+		v = (v | (v << 8)) & 0x00FF00FFu;
+		v = (v | (v << 4)) & 0x0F0F0F0Fu;
+		v = (v | (v << 2)) & 0x33333333u;
+		v = (v | (v << 1)) & 0x55555555u;
+		return v;
+	}
+	static uint32_t MortonIndex(uint32_t x, uint32_t y) {
+		return (SpreadBits(y) << 1) | SpreadBits(x);
+	}
+	// Distance of (x, y) along the Hilbert curve covering a 'gridSize' x 'gridSize' grid, 'gridSize' is a power of two.
+	static uint32_t HilbertIndex(uint32_t gridSize, uint32_t x, uint32_t y) {
+		uint32_t d{0};
+		for (uint32_t s = gridSize / 2; s > 0; s /= 2) {
+			uint32_t rx = (x & s) ? 1 : 0;
+			uint32_t ry = (y & s) ? 1 : 0;
+			d += s * s * ((3 * rx) ^ ry);
+			// Rotate the quadrant, so that the curve's pieces join up.
+			if (ry == 0) {
+				if (rx == 1) {
+					x = gridSize - 1 - x;
+					y = gridSize - 1 - y;
+				}
+				std::swap(x, y);
+			}
+		}
+		return d;
+	}
+
 	void SceneRenderingJob::CreateSquareRenderingTasks(uint32_t width, uint32_t height, uint32_t squareSideSize)
 	{
-		// TODO
+		// Tiles on the right and bottom edges are clipped to the image.
+		uint32_t tileCount_x = (width + squareSideSize - 1) / squareSideSize;
+		uint32_t tileCount_y = (height + squareSideSize - 1) / squareSideSize;
+		uint32_t gridSize{1};
+		while (gridSize < std::max(tileCount_x, tileCount_y)) {
+			gridSize *= 2;
+		}
+
+		auto makeTask = [width, height](uint32_t x, uint32_t y, uint32_t size) {
+			SceneRenderingTask renderingTask{};
+			renderingTask.raster_x_start = x;
+			renderingTask.raster_x_end = std::min(x + size, width);
+			renderingTask.raster_y_start = y;
+			renderingTask.raster_y_end = std::min(y + size, height);
+			return renderingTask;
+		};
+
+		std::vector<std::pair<uint32_t, SceneRenderingTask>> orderedTiles;
+		orderedTiles.reserve(static_cast<size_t>(tileCount_x) * tileCount_y);
+		for (uint32_t tile_y = 0; tile_y < tileCount_y; tile_y++) {
+			for (uint32_t tile_x = 0; tile_x < tileCount_x; tile_x++) {
+				uint32_t curveIdx = tileOrder == TileOrder::HILBERT ?
+					HilbertIndex(gridSize, tile_x, tile_y) :
+					MortonIndex(tile_x, tile_y);
+				orderedTiles.emplace_back(curveIdx, makeTask(tile_x * squareSideSize, tile_y * squareSideSize, squareSideSize));
+			}
+		}
+		std::sort(orderedTiles.begin(), orderedTiles.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+
+		// Tasks are taken in the order they're created. The last ones are split into quarters, so that
+		// the workers run out of work at about the same time instead of waiting for one last big tile.
+		static constexpr uint32_t minTileSize{8};
+		size_t tailTileCount = squareSideSize >= 2 * minTileSize ? orderedTiles.size() / 8 : 0;
+		size_t tailStart = orderedTiles.size() - tailTileCount;
+		uint32_t halfSize = squareSideSize / 2;
+		for (size_t i = 0; i < orderedTiles.size(); i++) {
+			const SceneRenderingTask& tile = orderedTiles[i].second;
+			if (i < tailStart) {
+				renderingTasks.push_back(tile);
+				continue;
+			}
+			// The second quarters take whatever is left of the tile, odd sizes included.
+			uint32_t bounds_x[3]{tile.raster_x_start, std::min(tile.raster_x_start + halfSize, tile.raster_x_end), tile.raster_x_end};
+			uint32_t bounds_y[3]{tile.raster_y_start, std::min(tile.raster_y_start + halfSize, tile.raster_y_end), tile.raster_y_end};
+			for (uint32_t quarter_y = 0; quarter_y < 2; quarter_y++) {
+				for (uint32_t quarter_x = 0; quarter_x < 2; quarter_x++) {
+					SceneRenderingTask quarter{};
+					quarter.raster_x_start = bounds_x[quarter_x];
+					quarter.raster_x_end = bounds_x[quarter_x + 1];
+					quarter.raster_y_start = bounds_y[quarter_y];
+					quarter.raster_y_end = bounds_y[quarter_y + 1];
+					// Clipped tiles may not have all four quarters.
+					if (quarter.raster_x_start < quarter.raster_x_end && quarter.raster_y_start < quarter.raster_y_end)
+						renderingTasks.push_back(quarter);
+				}
+			}
+		}
 	}
 
 }
\ No newline at end of file
@@ -38,6 +38,36 @@ namespace aurora {
 		this->fileName = fileName;
 	}
 
+	void PpmImageWriter::BeginImage(uint32_t imageWidth, uint32_t imageHeight) {
+		std::lock_guard<std::mutex> lock{imageMutex};
+		imageFile = CreateOpenImageFile();
+		WriteImageHeader(imageFile, imageWidth, imageHeight);
+		this->imageWidth = imageWidth;
+		rowPixelCounts.assign(imageHeight, 0);
+		nextRow = 0;
+	}
+	void PpmImageWriter::WriteRegion(const u8PixelBuffer& pixelBuffer, uint32_t x_start, uint32_t x_end, uint32_t y_start, uint32_t y_end) {
+		std::lock_guard<std::mutex> lock{imageMutex};
+		assert(imageFile.is_open() && "'BeginImage' must be called before writing regions!");
+		for (uint32_t y = y_start; y < y_end; y++) {
+			rowPixelCounts[y] += x_end - x_start;
+		}
+		uint32_t imageHeight = static_cast<uint32_t>(rowPixelCounts.size());
+		while (nextRow < imageHeight && rowPixelCounts[nextRow] == imageWidth) {
+			for (uint32_t x = 0; x < imageWidth; x++) {
+				const numa::u8Vec3& pixel = pixelBuffer.GetPixelValue(x, nextRow);
+				WriteIntegerPixel(imageFile, numa::u64Vec3{pixel.r, pixel.g, pixel.b});
+			}
+			nextRow++;
+		}
+	}
+	void PpmImageWriter::EndImage() {
+		std::lock_guard<std::mutex> lock{imageMutex};
+		assert(nextRow == rowPixelCounts.size() && "Some regions of the image were never written!");
+		imageFile.close();
+		rowPixelCounts.clear();
+	}
+
 	void PpmImageWriter::WriteImageHeader(std::ostream& os, uint32_t imageWidth, uint32_t imageHeight) const {
 		// Write the "PPM" header into the file named "ppmProps.fileName".
 		// Create the file first if it doesn't exist.
@@ -0,0 +1,354 @@
+#include "Renderer/WavefrontPathTracer.h"
+
+#include "Core/RayPacket.h"
+
+#include "Framework/Camera.h"
+#include "Framework/Light.h"
+
+#include "Framework/Components/Material.h"
+
+#include "Numa.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace aurora {
+
+	static constexpr float bias{0.00001f};
+
+	// PathQueue
+
+	void PathQueue::Resize(uint32_t capacity) {
+		originX.resize(capacity);
+		originY.resize(capacity);
+		originZ.resize(capacity);
+		directionX.resize(capacity);
+		directionY.resize(capacity);
+		directionZ.resize(capacity);
+		throughputR.resize(capacity);
+		throughputG.resize(capacity);
+		throughputB.resize(capacity);
+		scatterPdf.resize(capacity);
+		scatterNormal.resize(capacity);
+		specularBounce.resize(capacity);
+		pixelIndices.resize(capacity);
+		samplers.resize(capacity);
+		size = 0;
+	}
+	void PathQueue::SetRay(uint32_t pathIdx, const numa::Ray& ray) {
+		const numa::Vec3& o = ray.GetOrigin();
+		const numa::Vec3& d = ray.GetDirection();
+		originX[pathIdx] = o.x;
+		originY[pathIdx] = o.y;
+		originZ[pathIdx] = o.z;
+		directionX[pathIdx] = d.x;
+		directionY[pathIdx] = d.y;
+		directionZ[pathIdx] = d.z;
+	}
+	numa::Ray PathQueue::GetRay(uint32_t pathIdx) const {
+		return numa::Ray{
+			numa::Vec3{originX[pathIdx], originY[pathIdx], originZ[pathIdx]},
+			numa::Vec3{directionX[pathIdx], directionY[pathIdx], directionZ[pathIdx]}
+		};
+	}
+	void PathQueue::Move(uint32_t dstIdx, uint32_t srcIdx) {
+		originX[dstIdx] = originX[srcIdx];
+		originY[dstIdx] = originY[srcIdx];
+		originZ[dstIdx] = originZ[srcIdx];
+		directionX[dstIdx] = directionX[srcIdx];
+		directionY[dstIdx] = directionY[srcIdx];
+		directionZ[dstIdx] = directionZ[srcIdx];
+		throughputR[dstIdx] = throughputR[srcIdx];
+		throughputG[dstIdx] = throughputG[srcIdx];
+		throughputB[dstIdx] = throughputB[srcIdx];
+		scatterPdf[dstIdx] = scatterPdf[srcIdx];
+		scatterNormal[dstIdx] = scatterNormal[srcIdx];
+		specularBounce[dstIdx] = specularBounce[srcIdx];
+		pixelIndices[dstIdx] = pixelIndices[srcIdx];
+		samplers[dstIdx] = samplers[srcIdx];
+	}
+
+	// ShadowRayQueue
+
+	void ShadowRayQueue::Resize(uint32_t capacity) {
+		originX.resize(capacity);
+		originY.resize(capacity);
+		originZ.resize(capacity);
+		directionX.resize(capacity);
+		directionY.resize(capacity);
+		directionZ.resize(capacity);
+		tMax.resize(capacity);
+		contribution.resize(capacity);
+		Li.resize(capacity);
+		pixelIndices.resize(capacity);
+		lightIndices.resize(capacity);
+		samplers.resize(capacity);
+		size = 0;
+	}
+
+	// WavefrontPathTracer
+
+	WavefrontPathTracer::WavefrontPathTracer(int sampleCount, int rayDepthLimit, SamplerType samplerType, int russianRouletteDepth,
+		MisHeuristic misHeuristic)
+		: sampleCount(sampleCount), rayDepthLimit(rayDepthLimit), russianRouletteDepth(russianRouletteDepth),
+		samplerType(samplerType), misHeuristic(misHeuristic) {
+	}
+
+	void WavefrontPathTracer::Render(const ImageRegion& region, const Scene& scene, f32PixelBuffer& pixelBuffer) {
+		uint32_t regionWidth = region.raster_x_end - region.raster_x_start;
+		uint32_t regionHeight = region.raster_y_end - region.raster_y_start;
+		uint32_t pixelCount = regionWidth * regionHeight;
+		uint32_t lightCount = static_cast<uint32_t>(scene.GetLightRecords().size());
+
+		paths.Resize(pixelCount);
+		uint32_t lightSampleCount = std::max(scene.GetLightSamplingSettings().sampleCount, 1u);
+		shadowRays.Resize(pixelCount * std::max(lightCount, 1u) * lightSampleCount);
+		hits.resize(pixelCount);
+		hitPoints.resize(pixelCount);
+		hitNormals.resize(pixelCount);
+		hitMaterials.resize(pixelCount);
+		alive.resize(pixelCount);
+		shadeOrder.resize(pixelCount);
+		radianceR.assign(pixelCount, 0.0f);
+		radianceG.assign(pixelCount, 0.0f);
+		radianceB.assign(pixelCount, 0.0f);
+
+		// One pass per sample, each pass runs all the bounces of one path per pixel.
+		for (int sample = 0; sample < sampleCount; sample++) {
+			Generate(region, scene, sample);
+			for (int rayDepth = 0; rayDepth < rayDepthLimit && paths.size > 0; rayDepth++) {
+				Extend(scene);
+				Shade(scene, rayDepth);
+				Connect(scene);
+				Compact();
+			}
+		}
+
+		float scaleFactor = 1.0f / sampleCount;
+		for (uint32_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
+			numa::Vec3 radiance{radianceR[pixelIdx], radianceG[pixelIdx], radianceB[pixelIdx]};
+			pixelBuffer.WritePixel(
+				region.raster_x_start + pixelIdx % regionWidth,
+				region.raster_y_start + pixelIdx / regionWidth,
+				radiance * scaleFactor);
+		}
+	}
+
+	void WavefrontPathTracer::Generate(const ImageRegion& region, const Scene& scene, int sample) {
+		Camera* camera = scene.GetCamera();
+		uint32_t regionWidth = region.raster_x_end - region.raster_x_start;
+		uint32_t pathIdx{0};
+		for (uint32_t y = region.raster_y_start; y < region.raster_y_end; y++) {
+			for (uint32_t x = region.raster_x_start; x < region.raster_x_end; x++) {
+				Sampler& sampler = paths.samplers[pathIdx];
+				sampler = Sampler{samplerType};
+				sampler.StartPixelSample(x, y, sample);
+				paths.SetRay(pathIdx, camera->GenerateCameraRayJittered(x, y, sampler.Get2D()));
+				paths.throughputR[pathIdx] = 1.0f;
+				paths.throughputG[pathIdx] = 1.0f;
+				paths.throughputB[pathIdx] = 1.0f;
+				paths.scatterPdf[pathIdx] = 0.0f;
+				paths.specularBounce[pathIdx] = 0;
+				paths.pixelIndices[pathIdx] = (y - region.raster_y_start) * regionWidth + (x - region.raster_x_start);
+				pathIdx++;
+			}
+		}
+		paths.size = pathIdx;
+	}
+
+	void WavefrontPathTracer::Extend(const Scene& scene) {
+		// Neighbouring paths were generated by neighbouring pixels, so packets of consecutive paths stay coherent,
+		// at least for the first bounce. Compaction keeps the surviving paths in their original order.
+		for (uint32_t first = 0; first < paths.size; first += RayPacket8::size) {
+			uint32_t count = std::min(RayPacket8::size, paths.size - first);
+			RayPacket8 packet{};
+			for (uint32_t lane = 0; lane < count; lane++) {
+				packet.SetRay(lane, paths.GetRay(first + lane));
+				hits[first + lane] = HitRecord{};
+			}
+			packet.Finalize();
+			scene.IntersectClosest8(packet, &hits[first]);
+		}
+	}
+
+	void WavefrontPathTracer::Shade(const Scene& scene, int rayDepth) {
+		shadowRays.size = 0;
+
+		// Light hits and misses end their paths here, the rest are bucketed by material.
+		uint32_t materialCount = scene.GetMaterialCount();
+		materialOffsets.assign(materialCount + 1, 0);
+		for (uint32_t pathIdx = 0; pathIdx < paths.size; pathIdx++) {
+			alive[pathIdx] = 0;
+			const HitRecord& hit = hits[pathIdx];
+			if (hit.instanceIdx == invalidSceneIdx)
+				continue;
+			ActorRayHit rayHit{};
+			scene.ComputeSurfaceInteraction(paths.GetRay(pathIdx), hit, rayHit);
+			if (!rayHit.hitActor)
+				continue;
+			// Check if we hit a light source.
+			if (rayHit.hitLightIdx != invalidSceneIdx) {
+				const LightRecord& lightRecord = scene.GetLightRecord(rayHit.hitLightIdx);
+				if (rayDepth == 0) {
+					AddRadiance(paths.pixelIndices[pathIdx], lightRecord.radiance);
+				} else if (paths.specularBounce[pathIdx]) {
+					numa::Vec3 throughput{paths.throughputR[pathIdx], paths.throughputG[pathIdx], paths.throughputB[pathIdx]};
+					AddRadiance(paths.pixelIndices[pathIdx], throughput * lightRecord.radiance);
+				} else if (paths.scatterPdf[pathIdx] > 0.0f) {
+					// Weighted against the NEE of the previous bounce, see 'PathTracer::TracePathLoop'.
+					numa::Vec3 origin{paths.originX[pathIdx], paths.originY[pathIdx], paths.originZ[pathIdx]};
+					float lightPdf = scene.LightPdf(origin, paths.scatterNormal[pathIdx], rayHit.hitLightIdx, rayHit.hitPoint);
+					if (lightPdf > 0.0f) {
+						numa::Vec3 throughput{paths.throughputR[pathIdx], paths.throughputG[pathIdx], paths.throughputB[pathIdx]};
+						float misWeight = MisWeight(misHeuristic, paths.scatterPdf[pathIdx], lightPdf);
+						AddRadiance(paths.pixelIndices[pathIdx], throughput * lightRecord.radiance * misWeight);
+					}
+				}
+				continue;
+			}
+			if (rayHit.hitMaterialIdx == invalidSceneIdx)
+				continue;
+			hitPoints[pathIdx] = rayHit.hitPoint;
+			hitNormals[pathIdx] = rayHit.hitNormal;
+			hitMaterials[pathIdx] = rayHit.hitMaterialIdx;
+			materialOffsets[rayHit.hitMaterialIdx + 1]++;
+			alive[pathIdx] = 1;
+		}
+		for (uint32_t materialIdx = 0; materialIdx < materialCount; materialIdx++) {
+			materialOffsets[materialIdx + 1] += materialOffsets[materialIdx];
+		}
+		{
+			std::vector<uint32_t> insertIdx(materialOffsets.begin(), materialOffsets.end() - 1);
+			for (uint32_t pathIdx = 0; pathIdx < paths.size; pathIdx++) {
+				if (alive[pathIdx])
+					shadeOrder[insertIdx[hitMaterials[pathIdx]]++] = pathIdx;
+			}
+		}
+
+		const AlignedVector<LightRecord>& lightRecords = scene.GetLightRecords();
+		for (uint32_t materialIdx = 0; materialIdx < materialCount; materialIdx++) {
+			const Material* material = scene.GetMaterial(materialIdx);
+			for (uint32_t i = materialOffsets[materialIdx]; i < materialOffsets[materialIdx + 1]; i++) {
+				uint32_t pathIdx = shadeOrder[i];
+				numa::Vec3 wo = -numa::Vec3{paths.directionX[pathIdx], paths.directionY[pathIdx], paths.directionZ[pathIdx]};
+				const numa::Vec3& n = hitNormals[pathIdx];
+				numa::Vec3 hitPoint = hitPoints[pathIdx] + bias * n;
+				numa::Vec3 throughput{paths.throughputR[pathIdx], paths.throughputG[pathIdx], paths.throughputB[pathIdx]};
+				Sampler& sampler = paths.samplers[pathIdx];
+
+				numa::Vec3 brdf{1.0f};
+				float pdf{1.0f};
+				numa::Vec3 wi = material->Scatter(wo, n, sampler, brdf, pdf);
+				bool specular = material->IsSpecular();
+
+				// Next Event Estimation (NEE), the shadow rays are traced by the connect stage.
+				lightBundle.bundle.clear();
+				if (!specular)
+					scene.SampleLights(hitPoint, n, sampler, lightBundle);
+				for (const LightSampleData& lightSample : lightBundle.bundle) {
+					uint32_t lightIdx = lightSample.lightIdx;
+					float cosTheta = std::clamp(numa::Dot(lightSample.wi, n), 0.0f, 1.0f);
+					float misWeight{1.0f};
+					if (lightRecords[lightIdx].lightType == LightType::AREA)
+						misWeight = MisWeight(misHeuristic, lightSample.pdf, material->Pdf(wo, lightSample.wi, n));
+					uint32_t shadowIdx = shadowRays.size++;
+					shadowRays.originX[shadowIdx] = hitPoint.x;
+					shadowRays.originY[shadowIdx] = hitPoint.y;
+					shadowRays.originZ[shadowIdx] = hitPoint.z;
+					shadowRays.directionX[shadowIdx] = lightSample.wi.x;
+					shadowRays.directionY[shadowIdx] = lightSample.wi.y;
+					shadowRays.directionZ[shadowIdx] = lightSample.wi.z;
+					shadowRays.tMax[shadowIdx] = ComputeShadowRayLength(hitPoint, lightSample);
+					shadowRays.contribution[shadowIdx] = throughput * (brdf * cosTheta) * (misWeight / lightSample.pdf);
+					shadowRays.Li[shadowIdx] = lightSample.Li;
+					shadowRays.pixelIndices[shadowIdx] = paths.pixelIndices[pathIdx];
+					shadowRays.lightIndices[shadowIdx] = lightIdx;
+					if (lightRecords[lightIdx].lightType == LightType::DIRECTIONAL)
+						shadowRays.samplers[shadowIdx] = sampler.Fork();
+				}
+
+				// Indirect lighting.
+				if (pdf <= 0.0f) {
+					alive[pathIdx] = 0;
+					continue;
+				}
+				float cosTheta = specular ? std::abs(numa::Dot(n, wi)) : std::clamp(numa::Dot(n, wi), 0.0f, 1.0f);
+				throughput *= (brdf * cosTheta) / pdf;
+				paths.scatterPdf[pathIdx] = material->Pdf(wo, wi, n);
+				paths.scatterNormal[pathIdx] = n;
+				paths.specularBounce[pathIdx] = specular ? 1 : 0;
+				// Refracted rays continue from the other side of the surface.
+				if (numa::Dot(n, wi) < 0.0f)
+					hitPoint = hitPoints[pathIdx] - bias * n;
+				// Same place in the path's sequence as the loop integrator's roulette, at the start of the next bounce.
+				int nextRayDepth = rayDepth + 1;
+				if (nextRayDepth >= russianRouletteDepth && nextRayDepth < rayDepthLimit) {
+					float survival = RussianRouletteSurvival(throughput);
+					if (sampler.Get1D() >= survival) {
+						alive[pathIdx] = 0;
+						continue;
+					}
+					throughput /= survival;
+				}
+				paths.throughputR[pathIdx] = throughput.x;
+				paths.throughputG[pathIdx] = throughput.y;
+				paths.throughputB[pathIdx] = throughput.z;
+				paths.SetRay(pathIdx, numa::Ray{hitPoint, wi});
+			}
+		}
+	}
+
+	void WavefrontPathTracer::Connect(const Scene& scene) {
+		Atmosphere* atmosphere = scene.GetAtmosphere();
+		const AlignedVector<LightRecord>& lightRecords = scene.GetLightRecords();
+		// Shadow rays of neighbouring paths toward the same light are close to each other, so they are traced in packets too.
+		for (uint32_t first = 0; first < shadowRays.size; first += RayPacket8::size) {
+			uint32_t count = std::min(RayPacket8::size, shadowRays.size - first);
+			RayPacket8 packet{};
+			float tMax[RayPacket8::size]{};
+			for (uint32_t lane = 0; lane < count; lane++) {
+				uint32_t shadowIdx = first + lane;
+				packet.SetRay(lane, numa::Ray{
+					numa::Vec3{shadowRays.originX[shadowIdx], shadowRays.originY[shadowIdx], shadowRays.originZ[shadowIdx]},
+					numa::Vec3{shadowRays.directionX[shadowIdx], shadowRays.directionY[shadowIdx], shadowRays.directionZ[shadowIdx]}
+				});
+				tMax[lane] = shadowRays.tMax[shadowIdx];
+			}
+			packet.Finalize();
+			uint32_t occludedMask = scene.Occluded8(packet, 0.0f, tMax);
+			for (uint32_t lane = 0; lane < count; lane++) {
+				if (occludedMask & (1u << lane))
+					continue;
+				uint32_t shadowIdx = first + lane;
+				numa::Vec3 Li = shadowRays.Li[shadowIdx];
+				// Same as 'Scene::IntersectLights', distant lights are seen through the atmosphere.
+				const LightRecord& lightRecord = lightRecords[shadowRays.lightIndices[shadowIdx]];
+				if (lightRecord.lightType == LightType::DIRECTIONAL && atmosphere) {
+					Li = atmosphere->ComputeSkyColor(packet.GetRay(lane), static_cast<DirectionalLight*>(lightRecord.light), shadowRays.samplers[shadowIdx]);
+				}
+				AddRadiance(shadowRays.pixelIndices[shadowIdx], shadowRays.contribution[shadowIdx] * Li);
+			}
+		}
+	}
+
+	void WavefrontPathTracer::Compact() {
+		// Stable, so that the surviving paths keep their pixel order (and their packets their coherence).
+		uint32_t aliveCount{0};
+		for (uint32_t pathIdx = 0; pathIdx < paths.size; pathIdx++) {
+			if (!alive[pathIdx])
+				continue;
+			if (aliveCount != pathIdx)
+				paths.Move(aliveCount, pathIdx);
+			aliveCount++;
+		}
+		paths.size = aliveCount;
+	}
+
+	void WavefrontPathTracer::AddRadiance(uint32_t pixelIdx, const numa::Vec3& radiance) {
+		radianceR[pixelIdx] += radiance.x;
+		radianceG[pixelIdx] += radiance.y;
+		radianceB[pixelIdx] += radiance.z;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,354 @@
+#include "Scene/LightBvh.h"
+
+#include "Numa.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace aurora {
+
+	static constexpr uint64_t invalidBitTrail{std::numeric_limits<uint64_t>::max()};
+
+	static float SafeSqrt(float x) {
+		return std::sqrt(std::max(x, 0.0f));
+	}
+	static float SafeAcos(float x) {
+		return std::acos(std::clamp(x, -1.0f, 1.0f));
+	}
+
+	static float Luminance(const numa::Vec3& color) {
+		return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+	}
+
+	// cos(a - b) and sin(a - b) for angles in [0, pi], clamped so that the difference is never negative.
+	static float CosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+		if (cosA > cosB)
+			return 1.0f;
+		return cosA * cosB + sinA * sinB;
+	}
+	static float SinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+		if (cosA > cosB)
+			return 0.0f;
+		return sinA * cosB - cosA * sinB;
+	}
+
+	// Cosine of the cone of directions from 'p' that contains the box, -1 when 'p' is inside of it.
+	static float BoundSubtendedDirections(const Aabb& bounds, const numa::Vec3& p) {
+		// The box is approximated by its bounding sphere.
+		numa::Vec3 center = bounds.Centroid();
+		float radius2 = 0.25f * numa::Length2(bounds.Extent());
+		float distance2 = numa::Length2(p - center);
+		if (distance2 < radius2)
+			return -1.0f;
+		return SafeSqrt(1.0f - radius2 / distance2);
+	}
+
+	// Smallest cone containing both cones, the directions of the cones must be normalized.
+	static void UnionDirectionCones(const numa::Vec3& wA, float cosThetaA, const numa::Vec3& wB, float cosThetaB, numa::Vec3& w, float& cosTheta) {
+		float thetaA = SafeAcos(cosThetaA);
+		float thetaB = SafeAcos(cosThetaB);
+		float thetaD = SafeAcos(numa::Dot(wA, wB));
+		// One of the cones already contains the other one.
+		if (std::min(thetaD + thetaB, numa::Pi<float>()) <= thetaA) {
+			w = wA;
+			cosTheta = cosThetaA;
+			return;
+		}
+		if (std::min(thetaD + thetaA, numa::Pi<float>()) <= thetaB) {
+			w = wB;
+			cosTheta = cosThetaB;
+			return;
+		}
+		float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+		numa::Vec3 axis = numa::Cross(wA, wB);
+		if (thetaO >= numa::Pi<float>() || numa::Length2(axis) == 0.0f) {
+			w = wA;
+			cosTheta = -1.0f;
+			return;
+		}
+		// 'wA' rotated toward 'wB' around their common normal, so that the new cone touches both.
+		float thetaR = thetaO - thetaA;
+		axis = numa::Normalize(axis);
+		w = numa::Normalize(std::cos(thetaR) * wA + std::sin(thetaR) * numa::Cross(axis, wA));
+		cosTheta = std::cos(thetaO);
+	}
+
+	static LightBounds UnionLightBounds(const LightBounds& a, const LightBounds& b) {
+		if (a.phi == 0.0f)
+			return b;
+		if (b.phi == 0.0f)
+			return a;
+		LightBounds lightBounds{};
+		lightBounds.bounds = a.bounds;
+		lightBounds.bounds.Grow(b.bounds);
+		UnionDirectionCones(a.w, a.cosThetaO, b.w, b.cosThetaO, lightBounds.w, lightBounds.cosThetaO);
+		lightBounds.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+		lightBounds.phi = a.phi + b.phi;
+		lightBounds.twoSided = a.twoSided || b.twoSided;
+		return lightBounds;
+	}
+
+	// Returns 'false' for the lights that can't be bounded (directional lights) or that don't emit.
+	static bool ComputeLightBounds(const LightRecord& lightRecord, LightBounds& lightBounds) {
+		// Keeps flat lights from having boxes with no surface area.
+		static constexpr float thicknessPadding{0.0001f};
+
+		const Frame& frame = lightRecord.frame;
+		float luminance = Luminance(lightRecord.radiance);
+		switch (lightRecord.lightType) {
+			case LightType::POINT: {
+				lightBounds.bounds.Grow(frame.position);
+				lightBounds.bounds.Pad(thicknessPadding);
+				lightBounds.cosThetaO = -1.0f;
+				lightBounds.phi = 2.0f * numa::TwoPi<float>() * luminance;
+			} break;
+			case LightType::AREA: {
+				// Quads and circles light the side 'frame.forward' points to, see 'LightRecord::Sample'.
+				lightBounds.w = frame.forward;
+				lightBounds.phi = numa::Pi<float>() * lightRecord.area * luminance;
+				switch (lightRecord.shape) {
+					case GeometryType::CIRCLE: {
+						lightBounds.bounds.Grow(frame.position - numa::Vec3{lightRecord.radius});
+						lightBounds.bounds.Grow(frame.position + numa::Vec3{lightRecord.radius});
+					} break;
+					case GeometryType::PLANE: {
+						lightBounds.bounds.Grow(lightRecord.corner);
+						lightBounds.bounds.Grow(lightRecord.corner + lightRecord.edgeX);
+						lightBounds.bounds.Grow(lightRecord.corner + lightRecord.edgeY);
+						lightBounds.bounds.Grow(lightRecord.corner + lightRecord.edgeX + lightRecord.edgeY);
+						lightBounds.bounds.Pad(thicknessPadding);
+					} break;
+					case GeometryType::SPHERE: {
+						lightBounds.bounds.Grow(frame.position - numa::Vec3{lightRecord.radius});
+						lightBounds.bounds.Grow(frame.position + numa::Vec3{lightRecord.radius});
+						// Every direction is covered by some point of the sphere.
+						lightBounds.cosThetaO = -1.0f;
+					} break;
+					default: {
+						return false;
+					}
+				}
+			} break;
+			default: {
+				return false;
+			}
+		}
+		return lightBounds.phi > 0.0f;
+	}
+
+	// Cost of a group of lights for the split search, the surface area heuristic scaled by the solid
+	// angle the group emits into and by how elongated the parent box is along the split axis.
+	static float EvaluateSplitCost(const LightBounds& lightBounds, const Aabb& parentBounds, int axis) {
+		float thetaO = SafeAcos(lightBounds.cosThetaO);
+		float thetaE = SafeAcos(lightBounds.cosThetaE);
+		float thetaW = std::min(thetaO + thetaE, numa::Pi<float>());
+		float sinThetaO = SafeSqrt(1.0f - lightBounds.cosThetaO * lightBounds.cosThetaO);
+		float solidAngleMeasure = numa::TwoPi<float>() * (1.0f - lightBounds.cosThetaO) +
+			0.5f * numa::Pi<float>() * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + lightBounds.cosThetaO);
+		numa::Vec3 extent = parentBounds.Extent();
+		float aspect = std::max(extent.x, std::max(extent.y, extent.z)) / GetAxisValue(extent, axis);
+		return lightBounds.phi * solidAngleMeasure * aspect * lightBounds.bounds.SurfaceArea();
+	}
+
+	// LightBounds
+
+	float LightBounds::Importance(const numa::Vec3& p, const numa::Vec3& N) const {
+		numa::Vec3 center = bounds.Centroid();
+		numa::Vec3 toPoint = p - center;
+		// Points inside of the bounds don't get an infinite importance.
+		float distance2 = std::max(numa::Length2(toPoint), 0.5f * numa::Length(bounds.Extent()));
+		if (numa::Length2(toPoint) == 0.0f)
+			return phi / distance2;
+		numa::Vec3 wi = numa::Normalize(toPoint);
+
+		// Smallest angle between the emitting directions and the direction from the bounds to 'p',
+		// widened by the angle the bounds subtend from 'p'.
+		float cosThetaW = numa::Dot(w, wi);
+		if (twoSided)
+			cosThetaW = std::abs(cosThetaW);
+		float sinThetaW = SafeSqrt(1.0f - cosThetaW * cosThetaW);
+		float cosThetaB = BoundSubtendedDirections(bounds, p);
+		float sinThetaB = SafeSqrt(1.0f - cosThetaB * cosThetaB);
+		float sinThetaO = SafeSqrt(1.0f - cosThetaO * cosThetaO);
+		float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+		float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+		float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+		if (cosThetaP <= cosThetaE)
+			return 0.0f;
+
+		float importance = phi * cosThetaP / distance2;
+		// Same for the incident angle at 'p'. Either side of the surface, transmissive materials can use both.
+		float cosThetaI = std::abs(numa::Dot(wi, N));
+		float sinThetaI = SafeSqrt(1.0f - cosThetaI * cosThetaI);
+		importance *= CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+		return std::max(importance, 0.0f);
+	}
+
+	// LightBvh
+
+	void LightBvh::Build(const AlignedVector<LightRecord>& lightRecords) {
+		Clear();
+		bitTrails.assign(lightRecords.size(), invalidBitTrail);
+
+		std::vector<BuildLight> buildLights;
+		for (uint32_t lightIdx = 0; lightIdx < lightRecords.size(); lightIdx++) {
+			BuildLight buildLight{};
+			buildLight.lightIdx = lightIdx;
+			if (ComputeLightBounds(lightRecords[lightIdx], buildLight.lightBounds))
+				buildLights.push_back(buildLight);
+		}
+		if (buildLights.empty())
+			return;
+		nodes.reserve(2 * buildLights.size() - 1);
+		BuildNode(buildLights, 0, static_cast<uint32_t>(buildLights.size()), 0, 0);
+	}
+	void LightBvh::Clear() {
+		nodes.clear();
+		bitTrails.clear();
+	}
+
+	LightBounds LightBvh::BuildNode(std::vector<BuildLight>& buildLights, uint32_t begin, uint32_t end, uint64_t bitTrail, int depth) {
+		static constexpr int bucketCount{12};
+
+		assert(depth < 64 && "The light BVH is too deep for its bit trails!");
+
+		uint32_t nodeIdx = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+		if (end - begin == 1) {
+			LightBvhNode& node = nodes[nodeIdx];
+			node.lightBounds = buildLights[begin].lightBounds;
+			node.childOrLightIdx = buildLights[begin].lightIdx;
+			node.leaf = true;
+			bitTrails[buildLights[begin].lightIdx] = bitTrail;
+			return node.lightBounds;
+		}
+
+		Aabb bounds{};
+		Aabb centroidBounds{};
+		for (uint32_t i = begin; i < end; i++) {
+			bounds.Grow(buildLights[i].lightBounds.bounds);
+			centroidBounds.Grow(buildLights[i].lightBounds.bounds.Centroid());
+		}
+
+		// Bucketed search of the cheapest split, along every axis.
+		float minCost{std::numeric_limits<float>::infinity()};
+		int minCostAxis{-1};
+		int minCostBucket{-1};
+		auto bucketOf = [&centroidBounds](const LightBounds& lightBounds, int axis) {
+			float minValue = GetAxisValue(centroidBounds.min, axis);
+			float maxValue = GetAxisValue(centroidBounds.max, axis);
+			float offset = (GetAxisValue(lightBounds.bounds.Centroid(), axis) - minValue) / (maxValue - minValue);
+			return std::clamp(static_cast<int>(bucketCount * offset), 0, bucketCount - 1);
+		};
+		for (int axis = 0; axis < 3; axis++) {
+			if (GetAxisValue(centroidBounds.max, axis) == GetAxisValue(centroidBounds.min, axis))
+				continue;
+			LightBounds bucketBounds[bucketCount]{};
+			for (uint32_t i = begin; i < end; i++) {
+				int bucket = bucketOf(buildLights[i].lightBounds, axis);
+				bucketBounds[bucket] = UnionLightBounds(bucketBounds[bucket], buildLights[i].lightBounds);
+			}
+			for (int split = 0; split < bucketCount - 1; split++) {
+				LightBounds below{};
+				LightBounds above{};
+				for (int bucket = 0; bucket <= split; bucket++)
+					below = UnionLightBounds(below, bucketBounds[bucket]);
+				for (int bucket = split + 1; bucket < bucketCount; bucket++)
+					above = UnionLightBounds(above, bucketBounds[bucket]);
+				if (below.phi == 0.0f || above.phi == 0.0f)
+					continue;
+				float cost = EvaluateSplitCost(below, bounds, axis) + EvaluateSplitCost(above, bounds, axis);
+				if (cost < minCost) {
+					minCost = cost;
+					minCostAxis = axis;
+					minCostBucket = split;
+				}
+			}
+		}
+
+		uint32_t mid = (begin + end) / 2;
+		if (minCostAxis != -1) {
+			auto midIt = std::partition(buildLights.begin() + begin, buildLights.begin() + end,
+				[&bucketOf, minCostAxis, minCostBucket](const BuildLight& buildLight) {
+					return bucketOf(buildLight.lightBounds, minCostAxis) <= minCostBucket;
+				});
+			mid = static_cast<uint32_t>(midIt - buildLights.begin());
+			if (mid == begin || mid == end)
+				mid = (begin + end) / 2;
+		}
+
+		// The first child follows its parent, so only the second one is referenced.
+		LightBounds firstBounds = BuildNode(buildLights, begin, mid, bitTrail, depth + 1);
+		uint32_t secondIdx = static_cast<uint32_t>(nodes.size());
+		LightBounds secondBounds = BuildNode(buildLights, mid, end, bitTrail | (uint64_t{1} << depth), depth + 1);
+
+		LightBvhNode& node = nodes[nodeIdx];
+		node.lightBounds = UnionLightBounds(firstBounds, secondBounds);
+		node.childOrLightIdx = secondIdx;
+		return node.lightBounds;
+	}
+
+	bool LightBvh::Sample(const numa::Vec3& p, const numa::Vec3& N, float u, uint32_t& lightIdx, float& pmf) const {
+		static constexpr float oneMinusEpsilon{0x1.fffffep-1f};
+
+		if (nodes.empty())
+			return false;
+
+		pmf = 1.0f;
+		uint32_t nodeIdx{0};
+		while (!nodes[nodeIdx].leaf) {
+			// Children are picked in proportion to their importance, 'u' is rescaled to be reused below.
+			const LightBvhNode& node = nodes[nodeIdx];
+			float firstImportance = nodes[nodeIdx + 1].lightBounds.Importance(p, N);
+			float secondImportance = nodes[node.childOrLightIdx].lightBounds.Importance(p, N);
+			if (firstImportance == 0.0f && secondImportance == 0.0f)
+				return false;
+			float firstProbability = firstImportance / (firstImportance + secondImportance);
+			if (u < firstProbability) {
+				u = std::min(u / firstProbability, oneMinusEpsilon);
+				pmf *= firstProbability;
+				nodeIdx = nodeIdx + 1;
+			} else {
+				u = std::min((u - firstProbability) / (1.0f - firstProbability), oneMinusEpsilon);
+				pmf *= 1.0f - firstProbability;
+				nodeIdx = node.childOrLightIdx;
+			}
+		}
+		// A lone light is never rejected by its parent, it has to be checked on its own.
+		if (nodeIdx == 0 && nodes[0].lightBounds.Importance(p, N) == 0.0f)
+			return false;
+		lightIdx = nodes[nodeIdx].childOrLightIdx;
+		return true;
+	}
+
+	float LightBvh::Pmf(const numa::Vec3& p, const numa::Vec3& N, uint32_t lightIdx) const {
+		if (lightIdx >= bitTrails.size() || bitTrails[lightIdx] == invalidBitTrail)
+			return 0.0f;
+
+		// Same walk as 'Sample', along the light's bit trail.
+		uint64_t bitTrail = bitTrails[lightIdx];
+		float pmf{1.0f};
+		uint32_t nodeIdx{0};
+		while (!nodes[nodeIdx].leaf) {
+			const LightBvhNode& node = nodes[nodeIdx];
+			float firstImportance = nodes[nodeIdx + 1].lightBounds.Importance(p, N);
+			float secondImportance = nodes[node.childOrLightIdx].lightBounds.Importance(p, N);
+			if (firstImportance == 0.0f && secondImportance == 0.0f)
+				return 0.0f;
+			bool second = bitTrail & 1;
+			pmf *= (second ? secondImportance : firstImportance) / (firstImportance + secondImportance);
+			nodeIdx = second ? node.childOrLightIdx : nodeIdx + 1;
+			bitTrail >>= 1;
+		}
+		if (nodeIdx == 0 && nodes[0].lightBounds.Importance(p, N) == 0.0f)
+			return 0.0f;
+		return pmf;
+	}
+
+	bool LightBvh::Empty() const {
+		return nodes.empty();
+	}
+
+}
\ No newline at end of file
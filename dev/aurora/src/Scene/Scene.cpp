@@ -1,24 +1,218 @@
 #include "Scene/Scene.h"
 
+#include "Numa.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
 #include <limits>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace aurora {
 
+	// PlaneArrays
+
+	void PlaneArrays::Clear() {
+		frames.clear();
+		halfExtents.clear();
+		materialIndices.clear();
+	}
+	uint32_t PlaneArrays::Add(const Frame& frame, const numa::Vec2& dimensions, uint32_t materialIdx) {
+		frames.push_back(frame);
+		halfExtents.push_back(numa::Vec2{0.5f * dimensions.x, 0.5f * dimensions.y});
+		materialIndices.push_back(materialIdx);
+		return static_cast<uint32_t>(frames.size() - 1);
+	}
+
+	// Scene
+
 	Scene::Scene(std::string_view sceneName)
 		: sceneName(sceneName) {
 	}
 
-	bool Scene::IntersectClosest(const numa::Ray& ray, ActorRayHit& rayHit) const {
-		float closest_distance = std::numeric_limits<float>::max();
+	void Scene::Commit(TaskManager* taskManager) {
+		if (camera)
+			camera->Commit();
+
+		// Lights attached to the scene's actors are picked up even if they weren't added with 'AddLight'.
+		committedLights.clear();
+		std::unordered_map<const Light*, uint32_t> lightIndices;
+		auto commitLight = [this, &lightIndices](Light* light) {
+			auto insert = lightIndices.emplace(light, static_cast<uint32_t>(committedLights.size()));
+			if (insert.second)
+				committedLights.push_back(light);
+			return insert.first->second;
+		};
+		for (auto& light : lights) {
+			commitLight(light.get());
+		}
+
+		materials.clear();
+		std::unordered_map<const Material*, uint32_t> materialIndices;
+		auto commitMaterial = [this, &materialIndices](const Material* material) {
+			if (!material)
+				return invalidSceneIdx;
+			auto insert = materialIndices.emplace(material, static_cast<uint32_t>(materials.size()));
+			if (insert.second)
+				materials.push_back(material);
+			return insert.first->second;
+		};
+
+		instances.clear();
+		instanceBounds.clear();
+		spheres.Clear();
+		planes.Clear();
+		std::vector<GeometryInstance> unboundedInstances;
+		std::vector<GeometryInstance> sphereInstances;
 		for (auto& actor : actors) {
-			ActorRayHit hit{};
-			if (actor->Intersect(ray, hit)) {
-				if (hit.hitDistance < closest_distance) {
-					closest_distance = hit.hitDistance;
-					rayHit = hit;
-				}
+			std::shared_ptr<Geometry> geometry = actor->GetComponent<Geometry>();
+			if (!geometry)
+				continue;
+			GeometryInstance instance{};
+			instance.frame = actor->GetFrame();
+			instance.geometry = geometry.get();
+			instance.actor = actor.get();
+			instance.geometryType = geometry->GetGeometryType();
+			instance.materialIdx = commitMaterial(actor->GetComponent<Material>().get());
+			if (std::shared_ptr<Light> light = actor->GetComponent<Light>())
+				instance.lightIdx = commitLight(light.get());
+			if (instance.geometryType == GeometryType::SPHERE) {
+				sphereInstances.push_back(instance);
+				continue;
+			}
+			if (instance.geometryType == GeometryType::PLANE) {
+				const numa::Vec2& dimensions = static_cast<const Plane*>(geometry.get())->GetDimensions();
+				instance.shapeIdx = planes.Add(instance.frame, dimensions, instance.materialIdx);
+			}
+			if (geometry->IsBounded()) {
+				instance.worldBounds = geometry->ComputeWorldBounds(instance.frame);
+				instanceBounds.push_back(instance.worldBounds);
+				instances.push_back(instance);
+			} else {
+				unboundedInstances.push_back(instance);
 			}
 		}
+		boundedInstanceCount = static_cast<uint32_t>(instances.size());
+		unboundedInstanceCount = static_cast<uint32_t>(unboundedInstances.size());
+		instances.insert(instances.end(), unboundedInstances.begin(), unboundedInstances.end());
+		for (const GeometryInstance& instance : sphereInstances) {
+			// The sphere index is only known once the list is built.
+			float radius = static_cast<const Sphere*>(instance.geometry)->GetRadius();
+			spheres.Add(instance.frame.position, radius, static_cast<uint32_t>(instances.size()));
+			instances.push_back(instance);
+		}
+
+		lightRecords.clear();
+		for (Light* light : committedLights) {
+			light->Commit();
+			lightRecords.push_back(light->GetLightRecord());
+		}
+		BuildLightBvh();
+
+		BuildAccelerationStructure(taskManager);
+		dirty = false;
+	}
+	void Scene::CommitTransforms() {
+		assert(!dirty &&
+			"The scene has changed since the last commit! "
+			"Did you call 'Commit'?");
+
+		if (camera)
+			camera->Commit();
+		for (size_t i = 0; i < committedLights.size(); i++) {
+			committedLights[i]->Commit();
+			lightRecords[i] = committedLights[i]->GetLightRecord();
+		}
+		BuildLightBvh();
+
+		for (uint32_t instanceIdx = 0; instanceIdx < instances.size(); instanceIdx++) {
+			GeometryInstance& instance = instances[instanceIdx];
+			instance.frame = instance.actor->GetFrame();
+			if (instance.geometryType == GeometryType::SPHERE)
+				spheres.SetCenter(instance.shapeIdx, instance.frame.position);
+			else if (instance.geometryType == GeometryType::PLANE)
+				planes.frames[instance.shapeIdx] = instance.frame;
+			if (instanceIdx < boundedInstanceCount) {
+				instance.worldBounds = instance.geometry->ComputeWorldBounds(instance.frame);
+				instanceBounds[instanceIdx] = instance.worldBounds;
+			}
+		}
+		instanceBvh.Refit(instanceBounds);
+		spheres.Refit();
+	}
+
+	void Scene::BuildAccelerationStructure(TaskManager* taskManager) {
+		using Clock = std::chrono::steady_clock;
+
+		std::clog << "Building acceleration structure for scene '" << sceneName << "'...\n";
+
+		// Bottom level, shared geometries are only built once.
+		Clock::time_point bottomLevelStart = Clock::now();
+		std::unordered_set<Geometry*> builtGeometries;
+		for (auto& actor : actors) {
+			std::shared_ptr<Geometry> geometry = actor->GetComponent<Geometry>();
+			if (geometry && builtGeometries.insert(geometry.get()).second)
+				geometry->BuildAccelerationStructure(bvhBuildSettings, taskManager);
+		}
+		Clock::time_point bottomLevelEnd = Clock::now();
+
+		// Each instance is intersected through its own geometry, so single instance leaves are the cheapest to traverse.
+		BvhBuildSettings buildSettings = bvhBuildSettings;
+		buildSettings.maxLeafSize = 1;
+		instanceBvh.Build(instanceBounds, buildSettings, taskManager);
+		spheres.Build(bvhBuildSettings, taskManager);
+		for (uint32_t sphereIdx = 0; sphereIdx < spheres.GetSphereCount(); sphereIdx++) {
+			instances[spheres.GetUserIdx(sphereIdx)].shapeIdx = sphereIdx;
+		}
+		Clock::time_point topLevelEnd = Clock::now();
+
+		using Milliseconds = std::chrono::duration<double, std::milli>;
+		std::clog << "Bottom level: " << builtGeometries.size() << " geometries built in "
+			<< Milliseconds(bottomLevelEnd - bottomLevelStart).count() << " ms\n";
+		std::clog << "Top level: " << instances.size() << " instances ("
+			<< spheres.GetSphereCount() << " spheres in batches of " << SphereList::batchWidth << ") built in "
+			<< Milliseconds(topLevelEnd - bottomLevelEnd).count() << " ms\n";
+	}
+
+	void Scene::BuildLightBvh() {
+		lightBvh.Build(lightRecords);
+		unboundedLightIndices.clear();
+		for (uint32_t lightIdx = 0; lightIdx < lightRecords.size(); lightIdx++) {
+			if (lightRecords[lightIdx].lightType == LightType::DIRECTIONAL)
+				unboundedLightIndices.push_back(lightIdx);
+		}
+	}
+
+	bool Scene::IntersectClosest(const numa::Ray& ray, HitRecord& hit) const {
+		assert(!dirty &&
+			"The scene has changed since the last commit! "
+			"Did you call 'Commit'?");
+
+		float closestDistance = std::numeric_limits<float>::max();
+		hit.instanceIdx = invalidSceneIdx;
+		uint32_t sphereIdx{0};
+		if (spheres.IntersectClosest(ray, 0.0f, closestDistance, sphereIdx)) {
+			hit.t = closestDistance;
+			hit.primIdx = sphereIdx;
+			hit.instanceIdx = spheres.GetUserIdx(sphereIdx);
+		}
+
+		auto intersectInstance = [this, &ray, &hit](uint32_t instanceIdx, float& tMax) {
+			HitRecord instanceHit{};
+			if (!IntersectInstance(instances[instanceIdx], ray, tMax, instanceHit))
+				return false;
+			tMax = instanceHit.t;
+			hit = instanceHit;
+			hit.instanceIdx = instanceIdx;
+			return true;
+		};
+		instanceBvh.IntersectClosest(ray, 0.0f, closestDistance, intersectInstance);
+		for (uint32_t instanceIdx = boundedInstanceCount; instanceIdx < boundedInstanceCount + unboundedInstanceCount; instanceIdx++) {
+			intersectInstance(instanceIdx, closestDistance);
+		}
 		/*
 		if (atmosphere) {
 			RayHit hit{};
@@ -30,65 +224,251 @@ namespace aurora {
 			}
 		}
 		*/
-		return closest_distance != std::numeric_limits<float>::max();
+		return hit.instanceIdx != invalidSceneIdx;
 	}
-	bool Scene::IntersectLights(const numa::Vec3& p, const numa::Vec3& N, LightSampleBundle& lightBundle) const {
-		bool anyLightInView{false};
-		for (auto& light : lights) {
-			// Sample the light source
+	void Scene::ComputeSurfaceInteraction(const numa::Ray& ray, const HitRecord& hit, ActorRayHit& rayHit) const {
+		const GeometryInstance& instance = instances[hit.instanceIdx];
+		switch (instance.geometryType) {
+			case GeometryType::SPHERE:
+				ComputeSphereHit(instance, ray, hit, rayHit);
+				break;
+			case GeometryType::PLANE:
+				ComputePlaneHit(instance, ray, hit, rayHit);
+				break;
+			default:
+				instance.geometry->ComputeSurfaceInteraction(ray, instance.frame, hit, rayHit);
+				break;
+		}
+		rayHit.hitActor = instance.actor;
+		rayHit.hitMaterialIdx = instance.materialIdx;
+		rayHit.hitLightIdx = instance.lightIdx;
+	}
+	bool Scene::IntersectClosest(const numa::Ray& ray, ActorRayHit& rayHit) const {
+		HitRecord hit{};
+		if (!IntersectClosest(ray, hit))
+			return false;
+		ComputeSurfaceInteraction(ray, hit, rayHit);
+		return true;
+	}
+	bool Scene::Occluded(const numa::Ray& ray, float tMin, float tMax) const {
+		assert(!dirty &&
+			"The scene has changed since the last commit! "
+			"Did you call 'Commit'?");
+
+		if (spheres.Occluded(ray, tMin, tMax))
+			return true;
+		auto occludedInstance = [this, &ray, tMin, tMax](uint32_t instanceIdx) {
+			return OccludedInstance(instances[instanceIdx], ray, tMin, tMax);
+		};
+		if (instanceBvh.Occluded(ray, tMin, tMax, occludedInstance))
+			return true;
+		for (uint32_t instanceIdx = boundedInstanceCount; instanceIdx < boundedInstanceCount + unboundedInstanceCount; instanceIdx++) {
+			if (occludedInstance(instanceIdx))
+				return true;
+		}
+		return false;
+	}
+	uint32_t Scene::IntersectClosest8(const RayPacket8& packet, HitRecord* hits) const {
+		assert(!dirty &&
+			"The scene has changed since the last commit! "
+			"Did you call 'Commit'?");
+
+		float closestDistance[RayPacket8::size];
+		for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+			closestDistance[lane] = std::numeric_limits<float>::max();
+		}
+
+		uint32_t sphereIndices[RayPacket8::size]{};
+		uint32_t hitMask = spheres.IntersectClosest8(packet, 0.0f, closestDistance, sphereIndices);
+		for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+			if (!(hitMask & (1u << lane)))
+				continue;
+			hits[lane].t = closestDistance[lane];
+			hits[lane].primIdx = sphereIndices[lane];
+			hits[lane].instanceIdx = spheres.GetUserIdx(sphereIndices[lane]);
+		}
+
+		// Instances are still tested one ray at a time.
+		auto intersectInstance = [this, &packet, hits](uint32_t instanceIdx, uint32_t lane, float& tMax) {
+			HitRecord instanceHit{};
+			if (!IntersectInstance(instances[instanceIdx], packet.GetRay(lane), tMax, instanceHit))
+				return false;
+			tMax = instanceHit.t;
+			hits[lane] = instanceHit;
+			hits[lane].instanceIdx = instanceIdx;
+			return true;
+		};
+		hitMask |= instanceBvh.IntersectClosest8(packet, 0.0f, closestDistance, intersectInstance);
+		for (uint32_t instanceIdx = boundedInstanceCount; instanceIdx < boundedInstanceCount + unboundedInstanceCount; instanceIdx++) {
+			for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+				if (packet.IsActive(lane) && intersectInstance(instanceIdx, lane, closestDistance[lane]))
+					hitMask |= 1u << lane;
+			}
+		}
+		return hitMask;
+	}
+	uint32_t Scene::Occluded8(const RayPacket8& packet, float tMin, const float* tMax) const {
+		assert(!dirty &&
+			"The scene has changed since the last commit! "
+			"Did you call 'Commit'?");
+
+		uint32_t occludedMask = spheres.Occluded8(packet, tMin, tMax);
+		if (occludedMask == packet.activeMask)
+			return occludedMask;
+		// Lanes that are already blocked get an empty interval, so traversal skips them.
+		float laneTMax[RayPacket8::size];
+		for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+			laneTMax[lane] = (occludedMask & (1u << lane)) ? -std::numeric_limits<float>::infinity() : tMax[lane];
+		}
+		auto occludedLane = [this, &packet, tMin, &laneTMax](uint32_t instanceIdx, uint32_t lane) {
+			return OccludedInstance(instances[instanceIdx], packet.GetRay(lane), tMin, laneTMax[lane]);
+		};
+		occludedMask |= instanceBvh.OccludedLeaves8(packet, tMin, laneTMax,
+			[this, &occludedLane](uint32_t first, uint32_t count, uint32_t laneMask) {
+				uint32_t leafMask{0};
+				for (uint32_t i = 0; i < count; i++) {
+					uint32_t instanceIdx = instanceBvh.GetPrimIndices()[first + i];
+					for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+						if ((laneMask & ~leafMask & (1u << lane)) && occludedLane(instanceIdx, lane))
+							leafMask |= 1u << lane;
+					}
+				}
+				return leafMask;
+			});
+		for (uint32_t instanceIdx = boundedInstanceCount; instanceIdx < boundedInstanceCount + unboundedInstanceCount; instanceIdx++) {
+			for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+				if (packet.IsActive(lane) && !(occludedMask & (1u << lane)) && occludedLane(instanceIdx, lane))
+					occludedMask |= 1u << lane;
+			}
+		}
+		return occludedMask;
+	}
+	void Scene::SampleLights(const numa::Vec3& p, const numa::Vec3& N, Sampler& sampler, LightSampleBundle& lightBundle) const {
+		uint32_t sampleCount = std::max(lightSamplingSettings.sampleCount, 1u);
+		auto addLightSample = [this, &p, &N, &sampler, &lightBundle, sampleCount](uint32_t lightIdx, float pmf) {
+			LightSampleData lightSample{};
+			lightRecords[lightIdx].Sample(p, N, sampler.Get2D(), lightSample);
+			lightSample.lightIdx = lightIdx;
+			lightSample.pdf *= pmf * static_cast<float>(sampleCount);
+			lightBundle.AddLightSample(lightSample);
+		};
+		if (lightSamplingSettings.selection == LightSelection::ALL) {
+			for (uint32_t lightIdx = 0; lightIdx < lightRecords.size(); lightIdx++) {
+				for (uint32_t sampleIdx = 0; sampleIdx < sampleCount; sampleIdx++)
+					addLightSample(lightIdx, 1.0f);
+			}
+			return;
+		}
+		for (uint32_t lightIdx : unboundedLightIndices) {
+			for (uint32_t sampleIdx = 0; sampleIdx < sampleCount; sampleIdx++)
+				addLightSample(lightIdx, 1.0f);
+		}
+		for (uint32_t sampleIdx = 0; sampleIdx < sampleCount; sampleIdx++) {
 			LightSampleData lightSample{};
-			light->Sample(p, N, lightSample);
+			if (SampleBoundedLight(p, N, sampler, lightSample)) {
+				lightSample.pdf *= static_cast<float>(sampleCount);
+				lightBundle.AddLightSample(lightSample);
+			}
+		}
+	}
+
+	bool Scene::SampleBoundedLight(const numa::Vec3& p, const numa::Vec3& N, Sampler& sampler, LightSampleData& lightSample) const {
+		// The dimensions are drawn even when nothing is picked, so that the rest of the path doesn't depend on it.
+		float u = sampler.Get1D();
+		uint32_t lightIdx{0};
+		float pmf{0.0f};
+		if (!lightBvh.Sample(p, N, u, lightIdx, pmf)) {
+			sampler.Get2D();
+			return false;
+		}
+		lightRecords[lightIdx].Sample(p, N, sampler.Get2D(), lightSample);
+		lightSample.lightIdx = lightIdx;
+		lightSample.pdf *= pmf;
+		return true;
+	}
+
+	bool Scene::IntersectLights(const numa::Vec3& p, const numa::Vec3& N, Sampler& sampler, LightSampleBundle& lightBundle) const {
+		size_t firstSample = lightBundle.bundle.size();
+		SampleLights(p, N, sampler, lightBundle);
+		return RemoveOccludedLightSamples(p, sampler, lightBundle, firstSample);
+	}
+	bool Scene::IntersectUnboundedLights(const numa::Vec3& p, const numa::Vec3& N, Sampler& sampler, LightSampleBundle& lightBundle) const {
+		size_t firstSample = lightBundle.bundle.size();
+		for (uint32_t lightIdx : unboundedLightIndices) {
+			LightSampleData lightSample{};
+			lightRecords[lightIdx].Sample(p, N, sampler.Get2D(), lightSample);
+			lightSample.lightIdx = lightIdx;
+			lightBundle.AddLightSample(lightSample);
+		}
+		return RemoveOccludedLightSamples(p, sampler, lightBundle, firstSample);
+	}
+
+	bool Scene::RemoveOccludedLightSamples(const numa::Vec3& p, Sampler& sampler, LightSampleBundle& lightBundle, size_t firstSample) const {
+		size_t keptCount{firstSample};
+		for (size_t sampleIdx = firstSample; sampleIdx < lightBundle.bundle.size(); sampleIdx++) {
+			LightSampleData lightSample = lightBundle.bundle[sampleIdx];
 			// Create a ray toward the light source
 			numa::Ray lightRay{
 				p, // 'bias' should be handled elsewhere!
 				lightSample.wi
 			};
 			// Find if there's anything blocking the the path
-			float distanceToLight = numa::Length(lightSample.pos - p);
-			bool blocking{false};
-			for (auto& actor : actors) {
-				ActorRayHit hit{};
-				if (actor->Intersect(lightRay, hit)) {
-					if (hit.hitDistance < distanceToLight) {
-						blocking = true;
-						break;
-					}
-				}
-			}
-			if (!blocking) {
+			float distanceToLight = ComputeShadowRayLength(p, lightSample);
+			if (!Occluded(lightRay, 0.0f, distanceToLight)) {
 				// Check to see if an atmosphere is present.
 				// It should be taken into account for distant light sources only.
 				// This is because all the other types of light sources will have a 'faloff' affecting them, so
 				// presumably they'll be quite close to the objects in the scene. Over comparatively small distances,
 				// the atmosphering scattering shouldn't affect them much as opposed to distant lights where
 				// distances are huge (they are modeled as being outside of the atmosphere).
-				if (light->GetLightType() == LightType::DIRECTIONAL && atmosphere) {
-					lightSample.Li = atmosphere->ComputeSkyColor(lightRay, static_cast<DirectionalLight*>(light.get()));
+				const LightRecord& lightRecord = lightRecords[lightSample.lightIdx];
+				if (lightRecord.lightType == LightType::DIRECTIONAL && atmosphere) {
+					lightSample.Li = atmosphere->ComputeSkyColor(lightRay, static_cast<DirectionalLight*>(lightRecord.light), sampler);
 				}
-				lightBundle.AddLightSample(lightSample);
-				anyLightInView = true;
+				lightBundle.bundle[keptCount++] = lightSample;
 			}
 		}
-		return anyLightInView;
+		lightBundle.bundle.resize(keptCount);
+		return keptCount > firstSample;
+	}
+
+	float Scene::LightPdf(const numa::Vec3& p, const numa::Vec3& N, uint32_t lightIdx, const numa::Vec3& lightPoint) const {
+		float pmf{1.0f};
+		if (lightSamplingSettings.selection == LightSelection::BVH)
+			pmf = lightBvh.Pmf(p, N, lightIdx);
+		if (pmf == 0.0f)
+			return 0.0f;
+		uint32_t sampleCount = std::max(lightSamplingSettings.sampleCount, 1u);
+		return pmf * static_cast<float>(sampleCount) * lightRecords[lightIdx].Pdf(p, lightPoint);
 	}
 
 	void Scene::AddActor(std::shared_ptr<Actor> actor) {
 		actors.push_back(actor);
+		dirty = true;
 	}
 	void Scene::AddLight(std::shared_ptr<DirectionalLight> light) {
 		dirLight = light.get();
 		lights.push_back(light);
+		dirty = true;
 	}
 	void Scene::AddLight(std::shared_ptr<AreaLight> light) {
-		quadLight = light.get();
 		lights.push_back(light);
+		dirty = true;
 	}
 
 	void Scene::SetAtmosphere(std::shared_ptr<Atmosphere> atmosphere) {
 		this->atmosphere = atmosphere;
 	}
+	void Scene::SetBvhBuildSettings(const BvhBuildSettings& buildSettings) {
+		bvhBuildSettings = buildSettings;
+		dirty = true;
+	}
 	void Scene::SetCamera(std::shared_ptr<Camera> camera) {
 		this->camera = camera;
+		dirty = true;
+	}
+	void Scene::SetLightSamplingSettings(const LightSamplingSettings& samplingSettings) {
+		lightSamplingSettings = samplingSettings;
 	}
 
 	const std::vector<std::shared_ptr<Actor>>& Scene::GetActors() const {
@@ -97,6 +477,24 @@ namespace aurora {
 	const std::vector<std::shared_ptr<Light>>& Scene::GetLights() const {
 		return lights;
 	}
+	const LightSamplingSettings& Scene::GetLightSamplingSettings() const {
+		return lightSamplingSettings;
+	}
+
+	const AlignedVector<LightRecord>& Scene::GetLightRecords() const {
+		return lightRecords;
+	}
+	const LightRecord& Scene::GetLightRecord(uint32_t lightIdx) const {
+		return lightRecords[lightIdx];
+	}
+	const Material* Scene::GetMaterial(uint32_t materialIdx) const {
+		if (materialIdx == invalidSceneIdx)
+			return nullptr;
+		return materials[materialIdx];
+	}
+	uint32_t Scene::GetMaterialCount() const {
+		return static_cast<uint32_t>(materials.size());
+	}
 
 	Atmosphere* Scene::GetAtmosphere() const {
 		return atmosphere.get();
@@ -113,4 +511,105 @@ namespace aurora {
 		return sceneName;
 	}
 
+	bool Scene::IntersectInstance(const GeometryInstance& instance, const numa::Ray& ray, float tMax, HitRecord& hit) const {
+		switch (instance.geometryType) {
+			case GeometryType::PLANE:
+				return IntersectPlane(instance.shapeIdx, ray, tMax, hit);
+			default:
+				return instance.geometry->Intersect(ray, instance.frame, tMax, hit);
+		}
+	}
+	bool Scene::OccludedInstance(const GeometryInstance& instance, const numa::Ray& ray, float tMin, float tMax) const {
+		switch (instance.geometryType) {
+			case GeometryType::PLANE:
+				return OccludedPlane(instance.shapeIdx, ray, tMin, tMax);
+			default:
+				return instance.geometry->Occluded(ray, instance.frame, tMin, tMax);
+		}
+	}
+
+	bool Scene::IntersectPlane(uint32_t planeIdx, const numa::Ray& ray, float tMax, HitRecord& hit) const {
+		static constexpr float parallelThreshold{1e-8f};
+
+		const Frame& frame = planes.frames[planeIdx];
+		const numa::Vec2& halfExtent = planes.halfExtents[planeIdx];
+		float denom = numa::Dot(ray.GetDirection(), frame.forward);
+		if (std::abs(denom) < parallelThreshold)
+			return false;
+		float t = numa::Dot(frame.position - ray.GetOrigin(), frame.forward) / denom;
+		if (t <= 0.0f || t >= tMax)
+			return false;
+
+		// Infinite extents always pass the test.
+		numa::Vec3 localP = frame.ToLocalPoint(ray.GetPoint(t));
+		if (std::abs(localP.x) > halfExtent.x || std::abs(localP.y) > halfExtent.y)
+			return false;
+
+		hit.t = t;
+		hit.u = localP.x;
+		hit.v = localP.y;
+		hit.primIdx = 0;
+		return true;
+	}
+	bool Scene::OccludedPlane(uint32_t planeIdx, const numa::Ray& ray, float tMin, float tMax) const {
+		static constexpr float parallelThreshold{1e-8f};
+
+		const Frame& frame = planes.frames[planeIdx];
+		const numa::Vec2& halfExtent = planes.halfExtents[planeIdx];
+		float denom = numa::Dot(ray.GetDirection(), frame.forward);
+		if (std::abs(denom) < parallelThreshold)
+			return false;
+		float t = numa::Dot(frame.position - ray.GetOrigin(), frame.forward) / denom;
+		if (t <= tMin || t >= tMax)
+			return false;
+
+		numa::Vec3 localP = frame.ToLocalPoint(ray.GetPoint(t));
+		return std::abs(localP.x) <= halfExtent.x && std::abs(localP.y) <= halfExtent.y;
+	}
+
+	void Scene::ComputeSphereHit(const GeometryInstance& instance, const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const {
+		numa::Vec3 center = spheres.GetCenter(hit.primIdx);
+		float radius = spheres.GetRadius(hit.primIdx);
+
+		geometryHit.hitRay = ray;
+		geometryHit.hitPoint = ray.GetPoint(hit.t);
+		geometryHit.hitNormal = (geometryHit.hitPoint - center) / radius;
+		// Texture coordinates are kept in object space, so they follow the actor's rotation.
+		numa::Vec3 localNormal = instance.frame.ToLocalDirection(geometryHit.hitNormal);
+		geometryHit.hitUv = numa::Vec2{
+			0.5f + std::atan2(localNormal.z, localNormal.x) / (2.0f * numa::Pi<float>()),
+			std::acos(std::clamp(localNormal.y, -1.0f, 1.0f)) / numa::Pi<float>()
+		};
+		geometryHit.hitDistance = hit.t;
+		geometryHit.hitGeometryType = GeometryType::SPHERE;
+		geometryHit.hit = true;
+		// The ray starts inside the sphere if it leaves through the hit point.
+		geometryHit.hitFrontFace = numa::Dot(ray.GetDirection(), geometryHit.hitNormal) < 0.0f;
+	}
+	void Scene::ComputePlaneHit(const GeometryInstance& instance, const numa::Ray& ray, const HitRecord& hit, GeometryRayHit& geometryHit) const {
+		const Frame& frame = planes.frames[instance.shapeIdx];
+
+		geometryHit.hitRay = ray;
+		geometryHit.hitPoint = ray.GetPoint(hit.t);
+		geometryHit.hitNormal = frame.forward;
+		geometryHit.hitUv = numa::Vec2{hit.u, hit.v};
+		geometryHit.hitDistance = hit.t;
+		geometryHit.hitGeometryType = GeometryType::PLANE;
+		geometryHit.hit = true;
+		geometryHit.hitFrontFace = numa::Dot(ray.GetDirection(), frame.forward) < 0.0f;
+	}
+
+	// SceneCommitJob
+
+	SceneCommitJob::SceneCommitJob(Scene* scene, TaskManager* taskManager)
+		: scene(scene), taskManager(taskManager) {
+	}
+
+	void SceneCommitJob::CreateTasks(std::vector<Task*>& tasks) {
+		tasks.push_back(&commitTask);
+	}
+	void SceneCommitJob::ExecuteTask(Task&) {
+		scene->Commit(taskManager);
+	}
+
 }
\ No newline at end of file
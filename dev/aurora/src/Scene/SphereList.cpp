@@ -0,0 +1,311 @@
+#include "Scene/SphereList.h"
+
+#include "Numa.h"
+
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace aurora {
+
+	void SphereList::Clear() {
+		centerX.clear();
+		centerY.clear();
+		centerZ.clear();
+		radius.clear();
+		userIndices.clear();
+		sphereCount = 0;
+		bvh.Clear();
+	}
+	void SphereList::Add(const numa::Vec3& center, float sphereRadius, uint32_t userIdx) {
+		assert(centerX.size() == sphereCount &&
+			"The spheres have already been built! "
+			"Did you call 'Clear'?");
+		centerX.push_back(center.x);
+		centerY.push_back(center.y);
+		centerZ.push_back(center.z);
+		radius.push_back(sphereRadius);
+		userIndices.push_back(userIdx);
+		sphereCount++;
+	}
+	void SphereList::SetCenter(uint32_t sphereIdx, const numa::Vec3& center) {
+		centerX[sphereIdx] = center.x;
+		centerY[sphereIdx] = center.y;
+		centerZ[sphereIdx] = center.z;
+	}
+
+	void SphereList::Build(const BvhBuildSettings& settings, TaskManager* taskManager) {
+		std::vector<Aabb> sphereBounds(sphereCount);
+		for (uint32_t i = 0; i < sphereCount; i++) {
+			sphereBounds[i] = ComputeSphereBounds(i);
+		}
+		// A whole leaf costs a single kernel call.
+		BvhBuildSettings buildSettings = settings;
+		buildSettings.maxLeafSize = batchWidth;
+		bvh.Build(sphereBounds, buildSettings, taskManager);
+
+		// Store the spheres in the order the BVH leaves reference them.
+		const std::vector<uint32_t>& order = bvh.GetPrimIndices();
+		auto reorder = [this, &order](auto& values) {
+			std::remove_reference_t<decltype(values)> reordered(sphereCount + batchWidth);
+			for (uint32_t i = 0; i < sphereCount; i++) {
+				reordered[i] = values[order[i]];
+			}
+			values.swap(reordered);
+		};
+		reorder(centerX);
+		reorder(centerY);
+		reorder(centerZ);
+		reorder(radius);
+		reorder(userIndices);
+	}
+	void SphereList::Refit() {
+		// The BVH was built over the original order.
+		const std::vector<uint32_t>& order = bvh.GetPrimIndices();
+		std::vector<Aabb> sphereBounds(sphereCount);
+		for (uint32_t i = 0; i < sphereCount; i++) {
+			sphereBounds[order[i]] = ComputeSphereBounds(i);
+		}
+		bvh.Refit(sphereBounds);
+	}
+
+	bool SphereList::IntersectClosest(const numa::Ray& ray, float tMin, float& tMax, uint32_t& sphereIdx) const {
+		return bvh.IntersectClosestLeaves(ray, tMin, tMax, [this, &ray, tMin, &sphereIdx](uint32_t first, uint32_t count, float& leafTMax) {
+			return IntersectBatch(ray, first, count, tMin, leafTMax, sphereIdx);
+			});
+	}
+	bool SphereList::Occluded(const numa::Ray& ray, float tMin, float tMax) const {
+		return bvh.OccludedLeaves(ray, tMin, tMax, [this, &ray, tMin, tMax](uint32_t first, uint32_t count) {
+			return OccludedBatch(ray, first, count, tMin, tMax);
+			});
+	}
+
+	uint32_t SphereList::IntersectClosest8(const RayPacket8& packet, float tMin, float* tMax, uint32_t* sphereIndices) const {
+		return bvh.IntersectClosestLeaves8(packet, tMin, tMax, [this, &packet, tMin, sphereIndices](uint32_t first, uint32_t count, uint32_t laneMask, float* leafTMax) {
+			uint32_t hitMask{0};
+			for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+				if ((laneMask & (1u << lane)) && IntersectBatch(packet.GetRay(lane), first, count, tMin, leafTMax[lane], sphereIndices[lane]))
+					hitMask |= 1u << lane;
+			}
+			return hitMask;
+			});
+	}
+	uint32_t SphereList::Occluded8(const RayPacket8& packet, float tMin, const float* tMax) const {
+		return bvh.OccludedLeaves8(packet, tMin, tMax, [this, &packet, tMin, tMax](uint32_t first, uint32_t count, uint32_t laneMask) {
+			uint32_t occludedMask{0};
+			for (uint32_t lane = 0; lane < RayPacket8::size; lane++) {
+				if ((laneMask & (1u << lane)) && OccludedBatch(packet.GetRay(lane), first, count, tMin, tMax[lane]))
+					occludedMask |= 1u << lane;
+			}
+			return occludedMask;
+			});
+	}
+
+	bool SphereList::IntersectBatch(const numa::Ray& ray, uint32_t first, uint32_t count, float tMin, float& tMax, uint32_t& sphereIdx) const {
+		assert(count <= batchWidth && "Too many spheres for a single batch!");
+
+		const numa::Vec3& o = ray.GetOrigin();
+		const numa::Vec3& d = ray.GetDirection();
+		// Per lane: the closer root if it's in front of 'tMin', the farther one otherwise (the ray starts inside).
+		// Lanes that miss get an infinite distance, so the closest hit is a horizontal minimum.
+		float t[batchWidth];
+#if defined(__AVX__)
+		const __m256 ox = _mm256_set1_ps(o.x);
+		const __m256 oy = _mm256_set1_ps(o.y);
+		const __m256 oz = _mm256_set1_ps(o.z);
+		const __m256 dx = _mm256_set1_ps(d.x);
+		const __m256 dy = _mm256_set1_ps(d.y);
+		const __m256 dz = _mm256_set1_ps(d.z);
+		const __m256 a = _mm256_set1_ps(numa::Dot(d, d));
+		const __m256 invA = _mm256_set1_ps(1.0f / numa::Dot(d, d));
+		const __m256 tMinV = _mm256_set1_ps(tMin);
+		const __m256 tMaxV = _mm256_set1_ps(tMax);
+		__m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(&centerX[first]));
+		__m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(&centerY[first]));
+		__m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(&centerZ[first]));
+		__m256 r = _mm256_loadu_ps(&radius[first]);
+		__m256 halfB = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+		__m256 c = _mm256_sub_ps(
+			_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz)),
+			_mm256_mul_ps(r, r));
+		__m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(halfB, halfB), _mm256_mul_ps(a, c));
+		__m256 valid = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ);
+		__m256 sqrtDiscriminant = _mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps()));
+		__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_setzero_ps(), halfB), sqrtDiscriminant), invA);
+		__m256 t2 = _mm256_mul_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_setzero_ps(), halfB), sqrtDiscriminant), invA);
+		__m256 tHit = _mm256_blendv_ps(t2, t1, _mm256_cmp_ps(t1, tMinV, _CMP_GT_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(tHit, tMinV, _CMP_GT_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(tHit, tMaxV, _CMP_LT_OQ));
+		uint32_t hitMask = static_cast<uint32_t>(_mm256_movemask_ps(valid)) & ((1u << count) - 1u);
+		if (hitMask == 0)
+			return false;
+		_mm256_storeu_ps(t, _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), tHit, valid));
+#elif defined(__SSE__) || defined(_M_X64)
+		const __m128 ox = _mm_set1_ps(o.x);
+		const __m128 oy = _mm_set1_ps(o.y);
+		const __m128 oz = _mm_set1_ps(o.z);
+		const __m128 dx = _mm_set1_ps(d.x);
+		const __m128 dy = _mm_set1_ps(d.y);
+		const __m128 dz = _mm_set1_ps(d.z);
+		const __m128 a = _mm_set1_ps(numa::Dot(d, d));
+		const __m128 invA = _mm_set1_ps(1.0f / numa::Dot(d, d));
+		const __m128 tMinV = _mm_set1_ps(tMin);
+		const __m128 tMaxV = _mm_set1_ps(tMax);
+		__m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(&centerX[first]));
+		__m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(&centerY[first]));
+		__m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(&centerZ[first]));
+		__m128 r = _mm_loadu_ps(&radius[first]);
+		__m128 halfB = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+		__m128 c = _mm_sub_ps(
+			_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)),
+			_mm_mul_ps(r, r));
+		__m128 discriminant = _mm_sub_ps(_mm_mul_ps(halfB, halfB), _mm_mul_ps(a, c));
+		__m128 valid = _mm_cmpge_ps(discriminant, _mm_setzero_ps());
+		__m128 sqrtDiscriminant = _mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps()));
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), halfB), sqrtDiscriminant), invA);
+		__m128 t2 = _mm_mul_ps(_mm_add_ps(_mm_sub_ps(_mm_setzero_ps(), halfB), sqrtDiscriminant), invA);
+		// SSE2 has no blend, select with and/andnot/or.
+		__m128 t1InFront = _mm_cmpgt_ps(t1, tMinV);
+		__m128 tHit = _mm_or_ps(_mm_and_ps(t1InFront, t1), _mm_andnot_ps(t1InFront, t2));
+		valid = _mm_and_ps(valid, _mm_cmpgt_ps(tHit, tMinV));
+		valid = _mm_and_ps(valid, _mm_cmplt_ps(tHit, tMaxV));
+		uint32_t hitMask = static_cast<uint32_t>(_mm_movemask_ps(valid)) & ((1u << count) - 1u);
+		if (hitMask == 0)
+			return false;
+		__m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		_mm_storeu_ps(t, _mm_or_ps(_mm_and_ps(valid, tHit), _mm_andnot_ps(valid, inf)));
+#else
+		// Scalar fallback, used when no suitable instruction set is available.
+		uint32_t hitMask{0};
+		float a = numa::Dot(d, d);
+		for (uint32_t i = 0; i < count; i++) {
+			t[i] = std::numeric_limits<float>::infinity();
+			numa::Vec3 oc = o - numa::Vec3{centerX[first + i], centerY[first + i], centerZ[first + i]};
+			float halfB = numa::Dot(oc, d);
+			float c = numa::Dot(oc, oc) - radius[first + i] * radius[first + i];
+			float discriminant = halfB * halfB - a * c;
+			if (discriminant < 0.0f)
+				continue;
+			float sqrtDiscriminant = std::sqrt(discriminant);
+			float tHit = (-halfB - sqrtDiscriminant) / a;
+			if (tHit <= tMin)
+				tHit = (-halfB + sqrtDiscriminant) / a;
+			if (tHit > tMin && tHit < tMax) {
+				t[i] = tHit;
+				hitMask |= 1u << i;
+			}
+		}
+		if (hitMask == 0)
+			return false;
+#endif
+		uint32_t closestLane{0};
+		float closestT = std::numeric_limits<float>::infinity();
+		for (uint32_t i = 0; i < count; i++) {
+			if ((hitMask & (1u << i)) && t[i] < closestT) {
+				closestT = t[i];
+				closestLane = i;
+			}
+		}
+		tMax = closestT;
+		sphereIdx = first + closestLane;
+		return true;
+	}
+	bool SphereList::OccludedBatch(const numa::Ray& ray, uint32_t first, uint32_t count, float tMin, float tMax) const {
+		assert(count <= batchWidth && "Too many spheres for a single batch!");
+
+		const numa::Vec3& o = ray.GetOrigin();
+		const numa::Vec3& d = ray.GetDirection();
+		// Any root within (tMin, tMax) blocks the ray.
+#if defined(__AVX__)
+		const __m256 a = _mm256_set1_ps(numa::Dot(d, d));
+		const __m256 invA = _mm256_set1_ps(1.0f / numa::Dot(d, d));
+		const __m256 tMinV = _mm256_set1_ps(tMin);
+		const __m256 tMaxV = _mm256_set1_ps(tMax);
+		__m256 ocx = _mm256_sub_ps(_mm256_set1_ps(o.x), _mm256_loadu_ps(&centerX[first]));
+		__m256 ocy = _mm256_sub_ps(_mm256_set1_ps(o.y), _mm256_loadu_ps(&centerY[first]));
+		__m256 ocz = _mm256_sub_ps(_mm256_set1_ps(o.z), _mm256_loadu_ps(&centerZ[first]));
+		__m256 r = _mm256_loadu_ps(&radius[first]);
+		__m256 halfB = _mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(ocx, _mm256_set1_ps(d.x)), _mm256_mul_ps(ocy, _mm256_set1_ps(d.y))),
+			_mm256_mul_ps(ocz, _mm256_set1_ps(d.z)));
+		__m256 c = _mm256_sub_ps(
+			_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz)),
+			_mm256_mul_ps(r, r));
+		__m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(halfB, halfB), _mm256_mul_ps(a, c));
+		__m256 valid = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ);
+		__m256 sqrtDiscriminant = _mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps()));
+		__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_setzero_ps(), halfB), sqrtDiscriminant), invA);
+		__m256 t2 = _mm256_mul_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_setzero_ps(), halfB), sqrtDiscriminant), invA);
+		__m256 t1Inside = _mm256_and_ps(_mm256_cmp_ps(t1, tMinV, _CMP_GT_OQ), _mm256_cmp_ps(t1, tMaxV, _CMP_LT_OQ));
+		__m256 t2Inside = _mm256_and_ps(_mm256_cmp_ps(t2, tMinV, _CMP_GT_OQ), _mm256_cmp_ps(t2, tMaxV, _CMP_LT_OQ));
+		valid = _mm256_and_ps(valid, _mm256_or_ps(t1Inside, t2Inside));
+		return (static_cast<uint32_t>(_mm256_movemask_ps(valid)) & ((1u << count) - 1u)) != 0;
+#elif defined(__SSE__) || defined(_M_X64)
+		const __m128 a = _mm_set1_ps(numa::Dot(d, d));
+		const __m128 invA = _mm_set1_ps(1.0f / numa::Dot(d, d));
+		const __m128 tMinV = _mm_set1_ps(tMin);
+		const __m128 tMaxV = _mm_set1_ps(tMax);
+		__m128 ocx = _mm_sub_ps(_mm_set1_ps(o.x), _mm_loadu_ps(&centerX[first]));
+		__m128 ocy = _mm_sub_ps(_mm_set1_ps(o.y), _mm_loadu_ps(&centerY[first]));
+		__m128 ocz = _mm_sub_ps(_mm_set1_ps(o.z), _mm_loadu_ps(&centerZ[first]));
+		__m128 r = _mm_loadu_ps(&radius[first]);
+		__m128 halfB = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(ocx, _mm_set1_ps(d.x)), _mm_mul_ps(ocy, _mm_set1_ps(d.y))),
+			_mm_mul_ps(ocz, _mm_set1_ps(d.z)));
+		__m128 c = _mm_sub_ps(
+			_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)),
+			_mm_mul_ps(r, r));
+		__m128 discriminant = _mm_sub_ps(_mm_mul_ps(halfB, halfB), _mm_mul_ps(a, c));
+		__m128 valid = _mm_cmpge_ps(discriminant, _mm_setzero_ps());
+		__m128 sqrtDiscriminant = _mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps()));
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), halfB), sqrtDiscriminant), invA);
+		__m128 t2 = _mm_mul_ps(_mm_add_ps(_mm_sub_ps(_mm_setzero_ps(), halfB), sqrtDiscriminant), invA);
+		__m128 t1Inside = _mm_and_ps(_mm_cmpgt_ps(t1, tMinV), _mm_cmplt_ps(t1, tMaxV));
+		__m128 t2Inside = _mm_and_ps(_mm_cmpgt_ps(t2, tMinV), _mm_cmplt_ps(t2, tMaxV));
+		valid = _mm_and_ps(valid, _mm_or_ps(t1Inside, t2Inside));
+		return (static_cast<uint32_t>(_mm_movemask_ps(valid)) & ((1u << count) - 1u)) != 0;
+#else
+		float a = numa::Dot(d, d);
+		for (uint32_t i = 0; i < count; i++) {
+			numa::Vec3 oc = o - numa::Vec3{centerX[first + i], centerY[first + i], centerZ[first + i]};
+			float halfB = numa::Dot(oc, d);
+			float c = numa::Dot(oc, oc) - radius[first + i] * radius[first + i];
+			float discriminant = halfB * halfB - a * c;
+			if (discriminant < 0.0f)
+				continue;
+			float sqrtDiscriminant = std::sqrt(discriminant);
+			float t1 = (-halfB - sqrtDiscriminant) / a;
+			float t2 = (-halfB + sqrtDiscriminant) / a;
+			if ((t1 > tMin && t1 < tMax) || (t2 > tMin && t2 < tMax))
+				return true;
+		}
+		return false;
+#endif
+	}
+
+	numa::Vec3 SphereList::GetCenter(uint32_t sphereIdx) const {
+		return numa::Vec3{centerX[sphereIdx], centerY[sphereIdx], centerZ[sphereIdx]};
+	}
+	float SphereList::GetRadius(uint32_t sphereIdx) const {
+		return radius[sphereIdx];
+	}
+	uint32_t SphereList::GetUserIdx(uint32_t sphereIdx) const {
+		return userIndices[sphereIdx];
+	}
+	uint32_t SphereList::GetSphereCount() const {
+		return sphereCount;
+	}
+
+	Aabb SphereList::ComputeSphereBounds(uint32_t sphereIdx) const {
+		Aabb bounds{};
+		bounds.Grow(GetCenter(sphereIdx) - numa::Vec3{radius[sphereIdx]});
+		bounds.Grow(GetCenter(sphereIdx) + numa::Vec3{radius[sphereIdx]});
+		return bounds;
+	}
+
+}
\ No newline at end of file
@@ -10,6 +10,23 @@ local aurora_src_path = dev_path .. "/aurora/src"
 local numa_include_path = dependency_path .. "/numa/dev/numa/include"
 local numa_src_path = dependency_path .. "/numa/dev/numa/src"
 
+newoption {
+   trigger = "bvh-width",
+   value = "WIDTH",
+   description = "Branching factor of the BVHs used for ray traversal",
+   default = "2",
+   allowed = {
+      { "2", "Binary BVH, scalar traversal" },
+      { "4", "4-wide BVH, SSE traversal" },
+      { "8", "8-wide BVH, AVX traversal" }
+   }
+}
+
+newoption {
+   trigger = "avx2",
+   description = "Build with AVX2, sphere batches are then tested 8 at a time instead of 4"
+}
+
 workspace ( "aurora" )
    configurations ( { "Debug", "Release" } )
    platforms ( { "x64" } )
@@ -77,6 +94,13 @@ project ( "aurora" )
       "numa",
    }
 
+   defines ( { "AURORA_BVH_WIDTH=" .. _OPTIONS["bvh-width"] } )
+
+   filter ( "options:bvh-width=8 or options:avx2" )
+      vectorextensions ( "AVX2" )
+
+   filter ( {} )
+
    files {
       aurora_include_path .. "/**.h",
       aurora_include_path .. "/**.hpp",